@@ -34,6 +34,7 @@
 #define _ApiIF_hpp_
 
 #include <string>
+#include <vector>
 
 #include <common.h>
 #include <Channel.hpp>
@@ -49,9 +50,29 @@ namespace vz {
 /** 
  * @brief send measurement values to middleware
  * to be implemented specific API.
+ * @return false if sending failed and should be retried later
  **/
-		virtual void send() = 0;
+		virtual bool send() = 0;
 		virtual	void register_device()  = 0;
+
+/**
+ * @brief key of the request batch this api belongs to
+ * apis returning the same non-empty key may be sent together by send_batch()
+ **/
+		virtual std::string batch_key() const { return std::string(); }
+
+/**
+ * @brief send the measurement values of several apis with the same batch_key()
+ * called on one of them, apis includes this one
+ * @return false if sending failed and should be retried later
+ **/
+		virtual bool send_batch(const std::vector<ApiIF *> &apis) {
+			bool ok = true;
+			for (std::vector<ApiIF *>::const_iterator it = apis.begin(); it != apis.end(); it++) {
+				ok = (*it)->send() && ok;
+			}
+			return ok;
+		}
 		
 	protected:
 		Channel::Ptr channel() { return _ch; }
@@ -1,5 +1,5 @@
 /**
- * Circular buffer (double linked, threadsafe)
+ * Circular buffer (contiguous ring, threadsafe)
  *
  * Used to store recent readings and buffer in case of net inconnectivity
  *
@@ -30,24 +30,28 @@
 
 #include <pthread.h>
 #include <sys/time.h>
-#include <list>
+#include <atomic>
 
 #include <Reading.hpp>
+#include <RingBuffer.hpp>
+#include <P2Quantile.hpp>
+#include <Compressor.hpp>
 
 class Buffer {
 
 	public:
 	typedef vz::shared_ptr<Buffer> Ptr;
-	typedef std::list<Reading>::iterator iterator;
-	typedef std::list<Reading>::const_iterator const_iterator;
+	typedef RingBuffer<Reading>::iterator iterator;
+	typedef RingBuffer<Reading>::const_iterator const_iterator;
 
-	enum aggmode { NONE, MAX, AVG, SUM };
+	enum aggmode { NONE, MAX, AVG, SUM, MIN, COUNT, STDDEV, INTEGRAL, P50, P95, P99 };
 
 	Buffer();
 	virtual ~Buffer();
 
 	void aggregate(int aggtime, bool aggFixedInterval);
 	void push(const Reading &rd);
+	void take(RingBuffer<Reading> &batch);
 	void clean(bool deleted_only = true);
 	void undelete();
 	void shrink(/*size_t keep = 0*/);
@@ -56,24 +60,44 @@ class Buffer {
 	inline iterator begin() { return _sent.begin(); }
 	inline iterator end()   { return _sent.end(); }
 	inline size_t size() { return _sent.size(); }
+	inline size_t capacity() { return _sent.capacity(); }
 
 	inline bool newValues() const { return _newValues; }
 	inline void clear_newValues() { _newValues = false; }
+	inline bool take_newValues() { return _newValues.exchange(false); } // test and clear
 
 	inline void lock()   { pthread_mutex_lock(&_mutex); }
 	inline void unlock() { pthread_mutex_unlock(&_mutex); }
-	inline void wait(pthread_cond_t *condition) { pthread_cond_wait(condition, &_mutex); }
 
 	inline void have_newValues() { _newValues =  true; }
 
-	inline void set_aggmode(Buffer::aggmode m) {_aggmode=m;}
+	void set_aggmode(Buffer::aggmode m);
+	inline void set_compression(Compressor::compmode m, double dev, double devrel, int maxtime) {
+		_compressor.configure(m, dev, devrel, maxtime);
+	}
+	bool flush(); // store the reading held back by the compressor, @return true if there was one
+
+	/**
+	 * Called with each reading stored for the consumers, after aggregation and
+	 * compression, with the buffer locked. E.g. to keep it for the local interface.
+	 */
+	typedef void (*Listener)(int id, const Reading &rd);
+	inline void listener(Listener l, int id) { _listener = l; _listener_id = id; }
 
 	private:
+	void store(const Reading &rd);
+	void append(const Reading &rd);
+	void agg_reset();
+	void agg_add(const Reading &rd);
+
 	Buffer(const Buffer &); // don't allow copy constructor
 	Buffer & operator=(const Buffer &); // and no assignment op.
 
-	std::list<Reading> _sent;
-	bool _newValues;
+	RingBuffer<Reading> _sent;
+	Compressor _compressor;		/**< applied to readings before they are stored in _sent */
+	std::atomic<bool> _newValues;
+	Listener _listener;
+	int _listener_id;			/**< passed to _listener */
 
 	Buffer::aggmode _aggmode;
 
@@ -81,7 +105,15 @@ class Buffer {
 
 	pthread_mutex_t _mutex;
 
-	Reading *_last_avg; // keeps value and time from last reading from aggregate call for aggmode AVG
+	/* running accumulators of the current aggregation period, updated by push() */
+	Reading _agg_latest;		/**< most recent reading of the period */
+	double _agg_value;			/**< MAX/MIN: extreme, SUM: sum, AVG/INTEGRAL: sum of time weighted values, STDDEV: mean */
+	double _agg_timespan;		/**< AVG: sum of the weights in seconds */
+	double _agg_m2;				/**< STDDEV: sum of squared differences from the mean (Welford) */
+	unsigned int _agg_count;	/**< number of readings in the period */
+	Reading _agg_prev;			/**< AVG/INTEGRAL: previous reading, kept across periods as starting point */
+	bool _agg_have_prev;
+	P2Quantile _agg_quantile;	/**< P50/P95/P99 */
 };
 
 #endif /* _BUFFER_H_ */
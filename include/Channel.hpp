@@ -27,46 +27,61 @@
 #define _CHANNEL_H_
 
 #include <iostream>
-#include <pthread.h>
+#include <atomic>
+#include <list>
+#include <vector>
 
 #include "Reading.hpp"
 #include "Buffer.hpp"
-#include <threads.h>
+#include "Journal.hpp"
 #include <Options.hpp>
 #include <VZException.hpp>
 
-class Channel {
+class Channel : public vz::enable_shared_from_this<Channel> {
 
 	public:
 	typedef vz::shared_ptr<Channel> Ptr;
 
+	/**
+	 * Api the readings are sent to, with its options
+	 */
+	struct Sink {
+		std::string api;
+		std::list<Option> options;
+	};
+
 	Channel(const std::list<Option> &pOptions, const std::string api, const std::string pUuid, ReadingIdentifier::Ptr pIdentifier);
 	virtual ~Channel();
 
-	void start() {
-		pthread_create(&_thread, NULL, &logging_thread, (void *) this);
-		_thread_running = true;
-	}
-
-	void join() {
-		pthread_join(_thread, NULL);
-		_thread_running = false;
-	}
+	/**
+	 * Start logging: hand the channel over to the upload pool
+	 */
+	void start();
+	void cancel();
+	void join();
 
-	void cancel() { if (running()) pthread_cancel(_thread); }
-
-	bool running() const { return _thread_running; }
+	bool running() const { return _running; }
 
 	const char* name()                  { return _name.c_str(); }
 	std::list<Option> &options()        { return _options; }
 
 	ReadingIdentifier::Ptr identifier() {
 		if (_identifier.use_count() < 1) throw vz::VZException("Not identifier defined.") ; return _identifier; }
+	uint32_t identifier_key() const { return _identifier_key; }
 	int64_t time_ms() const { return _last == NULL ? 0 : _last->time_ms(); }
 
 	const char* uuid() const            { return _uuid.c_str(); }
 	const std::string apiProtocol()     { return _apiProtocol; }
 
+	/**
+	 * By default a channel has a single sink: its api and options.
+	 * The readings of several sinks are stored once in the journal.
+	 */
+	size_t sinks() const                { return _sinks.size(); }
+	const Sink &sink(size_t i) const    { return _sinks[i]; }
+	void sinks(const std::vector<Sink> &sinks) { if (!sinks.empty()) std::vector<Sink>(sinks).swap(_sinks); }
+	Journal::Ptr journal()              { return _journal; }
+
 	void last(Reading *rd)              { _last = rd;}
 	void push(const Reading &rd)        { _buffer->push(rd); }
 	char *dump(char *dump, size_t len)  { return _buffer->dump(dump, len); }
@@ -74,41 +89,45 @@ class Channel {
 
 	size_t size() const { return _buffer->size(); }
 
-	inline void notify() {
-		_buffer->lock();
-		pthread_cond_broadcast(&condition);
-		_buffer->unlock();
-	}
-	inline void wait() {
-		_buffer->lock();
-		while(!_buffer->newValues() ) {
-			_buffer->wait(&condition); 	// sleep until new data has been read
-		}
-		_buffer->clear_newValues();
-		_buffer->unlock();
-	}
+	void notify();
+
+	/**
+	 * Called by notify() of all channels with their new readings, e.g. to stream them
+	 */
+	typedef void (*Listener)(Channel &ch);
+	static void listener(Listener l) { _listener = l; }
 
 	int duplicates() const { return _duplicates; }
 
+	int push_id() const { return _push_id; }
+	void push_id(int id) { _push_id = id; }
+
+	int local_id() const { return _local_id; }
+	void local_id(int id) { _local_id = id; }
+
 	private:
 	static int instances;
-	bool _thread_running;   	// flag if thread is started
+	static Listener _listener;
+	std::atomic<bool> _running;	// flag if attached to the upload pool
 
 	int id;		 				// only for internal usage & debugging
 	std::string _name;    		// name of the channel
 	std::list<Option> _options;
 
 	Buffer::Ptr _buffer;		// circular queue to buffer readings
+	Journal::Ptr _journal;		// readings taken from _buffer until all sinks sent them
+	std::vector<Sink> _sinks;
 
 	ReadingIdentifier::Ptr _identifier;	// channel identifier (OBIS, string)
+	uint32_t _identifier_key;	// interned _identifier for matching readings
 	Reading *_last;			 	// most recent reading
 
-	pthread_cond_t condition;	// pthread syncronization to notify logging thread and local webserver
-	pthread_t _thread;			// pthread for asynchronus logging
 
 	std::string _uuid;			// unique identifier for middleware
 	std::string _apiProtocol;	// protocol of api to use for logging
 	int _duplicates;			// how to handle duplicate values (see conf)
+	int _push_id;				// interned _uuid in the pushDataList, -1 until first used
+	int _local_id;				// interned _uuid of the local interface buffer, -1 if none
 };
 
 #endif /* _CHANNEL_H_ */
@@ -0,0 +1,89 @@
+/**
+ * Lossy compression of a channel's readings
+ *
+ * Drops readings which can be reconstructed within a given error bound
+ * before they are stored for upload.
+ *
+ * @package vzlogger
+ * @copyright Copyright (c) 2011, The volkszaehler.org project
+ * @license http://www.gnu.org/licenses/gpl.txt GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _COMPRESSOR_H_
+#define _COMPRESSOR_H_
+
+#include <Reading.hpp>
+
+class Compressor {
+
+	public:
+	/**
+	 * DEADBAND:     keep a reading only if it differs from the last kept one by more than the deviation
+	 * SWINGINGDOOR: keep only the readings needed to reconstruct the curve by linear interpolation
+	 *               within the deviation (swinging door trending). Readings are kept delayed:
+	 *               a reading is only known to be needed once a later one doesn't fit the door.
+	 *               Kept values may be moved by up to the deviation to keep the error bound.
+	 */
+	enum compmode { NONE, DEADBAND, SWINGINGDOOR };
+
+	/**
+	 * Default of maxtime for SWINGINGDOOR in seconds. Without it the held reading of
+	 * a flat signal would never be sent, as the door doesn't close.
+	 */
+	enum { SWINGINGDOOR_MAXTIME = 300 };
+
+	Compressor();
+
+	/**
+	 * @param dev absolute deviation allowed
+	 * @param devrel deviation allowed relative to the last kept value (e.g. 0.01 for 1%)
+	 * @param maxtime keep a reading at least each <maxtime> seconds, 0 disables
+	 */
+	void configure(compmode mode, double dev, double devrel, int maxtime);
+	bool enabled() const { return _mode != NONE; }
+
+	/**
+	 * Feed the next reading (sorted by time)
+	 * @return true if a reading has to be kept, it is returned in out
+	 */
+	bool add(const Reading &rd, Reading &out);
+
+	/**
+	 * SWINGINGDOOR: keep the held reading, e.g. when the meter stops
+	 * @return true if there was a held reading, it is returned in out
+	 */
+	bool flush(Reading &out);
+
+	private:
+	double deviation(double value) const;
+
+	compmode _mode;
+	double _dev;
+	double _devrel;
+	int64_t _maxtime_ms;
+
+	bool _have_kept;
+	Reading _kept;		/**< last kept reading (DEADBAND) or door pivot (SWINGINGDOOR) */
+	bool _have_held;
+	Reading _held;		/**< SWINGINGDOOR: last reading, kept if the next one closes the door */
+	double _slope_max;	/**< SWINGINGDOOR: upper door, min. slope of the upper bounds seen */
+	double _slope_min;	/**< SWINGINGDOOR: lower door, max. slope of the lower bounds seen */
+};
+
+#endif /* _COMPRESSOR_H_ */
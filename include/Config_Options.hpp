@@ -67,7 +67,20 @@ public:
 	const int &verbosity() const { return _verbosity; }
 	const int &comet_timeout() const { return _comet_timeout; }
 	const int &buffer_length() const { return _buffer_length; }
+	int local_workers() const { return _local_workers; }
+	int local_connections() const { return _local_connections; }
 	int retry_pause() const { return _retry_pause; }
+	const std::string &spool_dir() const { return _spool_dir; }
+	size_t spool_size() const { return _spool_size; }
+	int spool_sync() const { return _spool_sync; }
+	int upload_workers() const { return _upload_workers; }
+	int upload_connections() const { return _upload_connections; }
+	bool upload_prewarm() const { return _upload_prewarm; }
+	int upload_batch_window() const { return _upload_batch_window; }
+	int upload_retry_max() const { return _upload_retry_max; }
+	int upload_breaker() const { return _upload_breaker; }
+	size_t push_buffer_size() const { return _push_buffer_size; }
+	PushDataList::Policy push_buffer_policy() const { return _push_buffer_policy; }
 
 	bool channel_index() const { return _channel_index; }
 	bool daemon()    const { return _daemon; }
@@ -101,7 +114,20 @@ private:
 	int _verbosity;			// verbosity level
 	int _comet_timeout;		// in seconds; 
 	int _buffer_length;		// in seconds; how long to buffer readings for local interfalce
+	int _local_workers;		// threads serving the local interface, 0 = one thread per connection
+	int _local_connections;	// max. concurrent connections to the local interface, 0 = unlimited
 	int _retry_pause;		// in seconds; how long to pause after an unsuccessful HTTP request
+	std::string _spool_dir;	// directory for the spool of unsent readings, empty disables spooling
+	size_t _spool_size;		// in bytes; max. size of the spool per channel
+	int _spool_sync;		// in seconds; how often to flush the spool to disk
+	int _upload_workers;	// number of threads sending readings to the middlewares
+	int _upload_connections;	// max. concurrent requests per middleware, 0 = unlimited
+	bool _upload_prewarm;	// open connections to all middlewares at startup
+	int _upload_batch_window;	// ms to gather the channels of a batch before sending
+	int _upload_retry_max;	// in seconds; upper limit of the exponential retry backoff
+	int _upload_breaker;	// failures in a row which pause all channels of a middleware, 0 = never
+	size_t _push_buffer_size;	// in bytes; max. size of the readings waiting for the push thread
+	PushDataList::Policy _push_buffer_policy;	// which readings to drop if the push thread can't keep up
 
 	// boolean bitfields, padding at the end of struct
 	int _channel_index:1;	// give a index of all available channels via local interface
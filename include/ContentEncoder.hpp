@@ -0,0 +1,89 @@
+/**
+ * Compression of request bodies (HTTP Content-Encoding)
+ *
+ * @package vzlogger
+ * @copyright Copyright (c) 2011, The volkszaehler.org project
+ * @license http://www.gnu.org/licenses/gpl.txt GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CONTENTENCODER_H_
+#define _CONTENTENCODER_H_
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+#include <shared_ptr.hpp>
+
+class ContentEncoder {
+
+	public:
+	typedef vz::shared_ptr<ContentEncoder> Ptr;
+
+	enum Encoding {
+		NONE,
+		GZIP,		/**< gzip wrapper (RFC 1952) */
+		DEFLATE		/**< zlib wrapper (RFC 1950), as required for "deflate" by HTTP */
+	};
+
+	/**
+	 * @param encoding compression format
+	 * @param min_size bodies smaller than this are sent uncompressed
+	 * @throw vz::VZException if zlib can't be initialized
+	 */
+	ContentEncoder(Encoding encoding, size_t min_size = 1024);
+	~ContentEncoder();
+
+	/**
+	 * Parse the name of an encoding ("none", "gzip" or "deflate")
+	 * @throw vz::VZException for unknown names
+	 */
+	static Encoding parse(const std::string &name);
+
+	/**
+	 * Compress a request body into the internal buffer. The zlib stream and
+	 * the buffer are reused for each body, so no allocations are needed
+	 * once the buffer reached the size of the largest body.
+	 *
+	 * @return false if the body should be sent as is (too small, not smaller or error)
+	 */
+	bool encode(const char *body, size_t len);
+
+	/** compressed body of the last successful encode() */
+	const char *data() const { return _out.empty() ? NULL : &_out[0]; }
+	size_t size() const { return _size; }
+
+	/** header line to send with the compressed body */
+	const char *header() const;
+
+	Encoding encoding() const { return _encoding; }
+
+	private:
+	ContentEncoder(const ContentEncoder &); // no copies
+	ContentEncoder & operator=(const ContentEncoder &);
+
+	Encoding _encoding;
+	size_t _min_size;
+	z_stream _zs;
+	std::vector<char> _out;
+	size_t _size;
+};
+
+#endif /* _CONTENTENCODER_H_ */
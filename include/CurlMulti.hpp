@@ -0,0 +1,108 @@
+/**
+ * CurlMulti - asynchronous transport for all apis based on the curl multi interface
+ *
+ * One thread drives all transfers. Requests to the same host share the
+ * connection cache and are multiplexed over a single HTTP/2 connection
+ * where the server supports it, so the throughput to a middleware scales
+ * with the number of outstanding requests instead of the round-trip time.
+ *
+ * @package vzlogger
+ * @copyright Copyright (c) 2011, The volkszaehler.org project
+ * @license http://www.gnu.org/licenses/gpl.txt GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CURLMULTI_H_
+#define _CURLMULTI_H_
+
+#include <pthread.h>
+#include <deque>
+#include <functional>
+#include <map>
+#include <curl/curl.h>
+
+class CurlMulti {
+
+	public:
+	/**
+	 * Completion callback, called from the transport thread
+	 * @param easy the finished handle (already removed from the transport)
+	 * @param result result of the transfer, CURLE_ABORTED_BY_CALLBACK if the transport was stopped
+	 */
+	typedef std::function<void(CURL *easy, CURLcode result)> Callback;
+
+	/**
+	 * Start the transport thread
+	 *
+	 * @param max_host_connections max. connections per host, 0 = unlimited
+	 * @throw vz::VZException if the transport can't be started
+	 */
+	CurlMulti(long max_host_connections = 0);
+
+	/**
+	 * Stop the transport thread. Transfers still running are aborted.
+	 */
+	~CurlMulti();
+
+	/**
+	 * Start a transfer (thread-safe, doesn't block)
+	 *
+	 * @param easy completely configured handle. It has to be kept until the callback was called.
+	 * @param cb called when the transfer finished
+	 */
+	void submit(CURL *easy, Callback cb);
+
+	/**
+	 * Prefer HTTP/2 for the handle and wait for a connection to multiplex on instead
+	 * of opening another one. Only for servers known to support it, others may
+	 * fail the TLS negotiation. Handles are reused, so it is reset if not enabled.
+	 */
+	static void multiplex(CURL *easy, bool enable);
+
+	/**
+	 * Replacement for curl_easy_perform(): submit the transfer and wait for it
+	 * Must not be called from a completion callback.
+	 */
+	CURLcode perform(CURL *easy);
+
+	size_t active();	/**< number of transfers submitted but not finished */
+
+	private:
+	CurlMulti(const CurlMulti &); // no copies
+	CurlMulti & operator=(const CurlMulti &);
+
+	static void *loop(void *arg);
+	void run();
+	void wakeup();
+	void finish(CURL *easy, CURLcode result);
+
+	CURLM *_multi;
+	pthread_t _thread;
+	int _wakeup[2];				/**< pipe to interrupt curl_multi_wait() */
+	bool _running;
+
+	pthread_mutex_t _mutex;
+	std::deque<std::pair<CURL *, Callback> > _pending;	/**< submitted, not yet added to _multi */
+	std::map<CURL *, Callback> _transfers;	/**< added to _multi */
+};
+
+// var to a global/single instance. needs to be initialized e.g. in main()
+// apis fall back to curl_easy_perform() if not set
+extern CurlMulti *curlMulti;
+
+#endif /* _CURLMULTI_H_ */
@@ -3,37 +3,64 @@
 
 #include <string>
 #include <map>
+#include <deque>
 #include <pthread.h>
+#include <time.h>
 #include <curl/curl.h>
 
+/**
+ * Pool of curl sessions (easy handles) per key, e.g. per middleware
+ *
+ * Up to max_per_key handles are handed out for a key at the same time,
+ * further requests wait in FIFO order. Returned handles are kept for reuse
+ * (with their connections) and cleaned up after being idle for idle_timeout seconds.
+ */
 class CurlSessionProvider
 {
 public:
+    struct Stats {
+        size_t created;     // handles created
+        size_t evicted;     // idle handles cleaned up
+        size_t in_use;      // handles currently handed out
+        size_t idle;        // handles available for reuse
+        size_t waits;       // requests that had to wait for a handle
+        double wait_total;  // in seconds
+        double wait_max;    // in seconds
+    };
+
     // non thread safe:
-    CurlSessionProvider();
+    CurlSessionProvider(size_t max_per_key = 1, int idle_timeout = 60); // max_per_key 0 = unlimited
     ~CurlSessionProvider();
 
     // thread-safe functions:
-    CURL *get_easy_session(std::string key, int timeout=0); // this is intended to block if the handle for the current key is in use and single_session_per_key
-    void return_session(std::string key, CURL *&); // return a handle. this unblocks another pending request for this key if single_session_per_key
+    CURL *get_easy_session(std::string key, int timeout=0); // blocks if max_per_key handles for the key are in use. timeout in seconds (0 = forever), returns 0 on timeout
+    void return_session(std::string key, CURL *&); // return a handle. this unblocks the oldest pending request for this key
     bool inUse(std::string key); // check whether a key is in use (does not guarantee that get... will not block)
+    Stats stats(std::string key); // statistics of one key
+    Stats stats(); // statistics summed up for all keys
 
 protected:
-    class CurlUsage
+    class CurlPool
     {
     public:
-        CurlUsage() : eh(0), inUse(false) { mutex = PTHREAD_MUTEX_INITIALIZER; };
-        CURL *eh;
-        bool inUse;
-        pthread_mutex_t mutex;
+        CurlPool();
+        ~CurlPool();
+        std::deque<std::pair<CURL *, time_t> > idle; // handle and time it was returned, most recently used last
+        std::deque<pthread_cond_t *> waiters; // FIFO of waiting requests
+        Stats stats;
     };
 
-    typedef std::map<std::string, CurlUsage>::iterator map_it;
-    typedef std::map<std::string, CurlUsage>::const_iterator cmap_it;
+    bool exhausted(const CurlPool &pool) const;
+    void evict(CurlPool &pool, time_t now);
+
+    typedef std::map<std::string, CurlPool *>::iterator map_it;
+    typedef std::map<std::string, CurlPool *>::const_iterator cmap_it;
 
-    std::map<std::string, CurlUsage> _easy_handle_map;
+    std::map<std::string, CurlPool *> _pools;
 private:
     pthread_mutex_t _map_mutex;
+    size_t _max_per_key;
+    int _idle_timeout;
 };
 
 // var to a global/single instance. needs to be initialzed e.g. in main()
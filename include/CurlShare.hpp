@@ -0,0 +1,74 @@
+/**
+ * CurlShare - DNS, TLS session and connection cache shared by all curl handles
+ *
+ * @package vzlogger
+ * @copyright Copyright (c) 2011, The volkszaehler.org project
+ * @license http://www.gnu.org/licenses/gpl.txt GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CURLSHARE_H_
+#define _CURLSHARE_H_
+
+#include <pthread.h>
+#include <list>
+#include <string>
+#include <curl/curl.h>
+
+class CurlShare {
+
+	public:
+	/**
+	 * @throw vz::VZException if the share can't be created
+	 */
+	CurlShare();
+
+	/**
+	 * All handles using the share have to be cleaned up before
+	 */
+	~CurlShare();
+
+	/**
+	 * Let a handle use the shared caches
+	 */
+	void apply(CURL *easy);
+
+	/**
+	 * Open connections (including the TLS handshake) to the hosts of the urls,
+	 * so the first requests can reuse them
+	 *
+	 * @param timeout in seconds per url
+	 */
+	void prewarm(const std::list<std::string> &urls, long timeout = 5);
+
+	private:
+	CurlShare(const CurlShare &); // no copies
+	CurlShare & operator=(const CurlShare &);
+
+	static void lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr);
+	static void unlock(CURL *handle, curl_lock_data data, void *userptr);
+
+	CURLSH *_share;
+	pthread_mutex_t _mutex[CURL_LOCK_DATA_LAST];	/**< one lock per kind of shared data */
+};
+
+// var to a global/single instance. needs to be initialized e.g. in main()
+// handles don't share their caches if not set
+extern CurlShare *curlShare;
+
+#endif /* _CURLSHARE_H_ */
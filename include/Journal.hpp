@@ -0,0 +1,160 @@
+/**
+ * Readings of a channel shared by its sinks
+ *
+ * A channel can be sent to several apis (sinks). The readings taken over from
+ * the channel buffer are stored here once, each sink has its own cursor and
+ * acknowledges the readings it has sent. Readings acknowledged by all sinks
+ * are released. Serialized chunks are kept per wire format, so sinks sending
+ * the same readings in the same format serialize them only once.
+ *
+ * @package vzlogger
+ * @copyright Copyright (c) 2011, The volkszaehler.org project
+ * @license http://www.gnu.org/licenses/gpl.txt GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _JOURNAL_H_
+#define _JOURNAL_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <functional>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <shared_ptr.hpp>
+#include <Reading.hpp>
+#include <RingBuffer.hpp>
+#include <Buffer.hpp>
+#include <JsonWriter.hpp>
+#include <Spool.hpp>
+
+class Journal {
+
+	public:
+	typedef vz::shared_ptr<Journal> Ptr;
+	typedef vz::shared_ptr<JsonWriter> Body;	/**< serialized chunk, shared between sinks */
+
+	/**
+	 * Serialize the readings log[first..last) into json
+	 * @return number of readings serialized
+	 */
+	typedef std::function<size_t (const RingBuffer<Reading> &log, size_t first, size_t last,
+								  JsonWriter &json)> Serializer;
+
+	/**
+	 * @param duplicates send duplicate values only each <duplicates> seconds (0 = send all)
+	 */
+	explicit Journal(int duplicates = 0);
+	~Journal();
+
+	/**
+	 * Add a sink, it starts with the readings currently stored
+	 * @return id of the sink
+	 */
+	size_t attach();
+
+	/**
+	 * Remove a sink, its unacknowledged readings are released
+	 */
+	void detach(size_t sink);
+
+	/**
+	 * Make the journal durable: replay the unacknowledged readings of the spool
+	 * and spool all further readings until they are acknowledged by all sinks
+	 * @return number of readings replayed
+	 */
+	size_t spool(Spool::Ptr spool);
+	bool spooled() const { return (bool)_spool; }
+
+	/**
+	 * Move the new readings of the channel buffer into the journal
+	 * Readings not newer than the last one and duplicates are skipped.
+	 * @return number of readings added
+	 */
+	size_t fetch(Buffer &buf);
+
+	/**
+	 * Add a single reading, filtered like fetch()
+	 * @return true if added
+	 */
+	bool append(const Reading &rd);
+
+	size_t pending(size_t sink);	/**< number of readings not yet acknowledged by sink */
+	size_t size();					/**< number of readings stored */
+
+	/**
+	 * Copy the readings not yet acknowledged by sink to out
+	 */
+	void copy(size_t sink, std::vector<Reading> &out);
+
+	/**
+	 * Acknowledge the n oldest pending readings of sink
+	 */
+	void ack(size_t sink, size_t n);
+
+	/**
+	 * Serialize the oldest pending readings of sink, at most max of them
+	 *
+	 * If another sink already serialized the same readings with the same format,
+	 * its body is returned instead of serializing them again.
+	 * @param format wire format including all parameters affecting the result
+	 * @param count set to the number of readings in the body
+	 * @return the body, empty if nothing is pending
+	 */
+	Body serialize(size_t sink, const std::string &format, size_t max, const Serializer &fn, size_t &count);
+
+	private:
+	struct Cached {
+		uint64_t from;		/**< sequence number of the first reading */
+		size_t max;			/**< requested number of readings */
+		size_t count;		/**< serialized number of readings */
+		Body body;
+	};
+
+	Journal(const Journal &); // no copies
+	Journal & operator=(const Journal &);
+
+	bool accept(const Reading &rd);	/**< duplicate filter */
+	void store(const Reading &rd);
+	void release();		/**< drop the readings acknowledged by all sinks */
+	void drop_front(size_t n);
+
+	int _duplicates;
+	int64_t _last_timestamp;	/**< of the last reading accepted */
+	Reading _lastReadingSent;	/**< duplicates: last value accepted */
+	bool _haveLastReading;
+
+	RingBuffer<Reading> _log;
+	RingBuffer<Reading> _batch;	/**< readings taken over from the channel buffer */
+	uint64_t _base;				/**< sequence number of _log[0] */
+	std::vector<uint64_t> _cursors;	/**< per sink: sequence number of the first pending reading */
+	std::vector<bool> _attached;
+
+	Spool::Ptr _spool;
+	uint64_t _spoolFrom;		/**< sequence number of the first spooled reading */
+	std::deque<uint64_t> _unspooled;	/**< sequence numbers of readings the spool couldn't store */
+
+	std::map<std::string, Cached> _cache;	/**< last body per format */
+
+	pthread_mutex_t _mutex;
+};
+
+#endif /* _JOURNAL_H_ */
@@ -0,0 +1,101 @@
+/**
+ * Streaming JSON writer
+ *
+ * Formats JSON straight into a byte buffer which is reused between documents,
+ * instead of building a json-c object tree (two allocations per tuple) and
+ * stringifying it afterwards.
+ *
+ * @package vzlogger
+ * @copyright Copyright (c) 2011, The volkszaehler.org project
+ * @license http://www.gnu.org/licenses/gpl.txt GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _JSONWRITER_H_
+#define _JSONWRITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+class JsonWriter {
+
+	public:
+	JsonWriter() { clear(); }
+
+	/**
+	 * Start a new document. Keeps the allocated buffer.
+	 */
+	void clear() {
+		_buf.clear();
+		_depth = 0;
+		_first[0] = true;
+		_after_key = false;
+	}
+
+	const char *c_str() const { return _buf.c_str(); }
+	const std::string &str() const { return _buf; }
+	size_t size() const { return _buf.size(); }
+
+	/**
+	 * Drop everything written after size. Only valid within the current
+	 * container and after at least one of its values.
+	 */
+	void truncate(size_t size) { _buf.resize(size); }
+
+	void begin_array();
+	void end_array();
+	void begin_object();
+	void end_object();
+
+	/** member name, has to be followed by a value */
+	void key(const char *name);
+
+	void integer(int64_t v);
+	void number(double v);		/**< non-finite values are written as null */
+	void string(const char *s);
+	void raw(const char *json, size_t len);	/**< value which is serialized already */
+
+	/** [ts,value] as used by the middleware */
+	void tuple(int64_t ts, double value);
+
+	/**
+	 * Format an integer into out (at least 21 bytes)
+	 * @return number of chars written
+	 */
+	static size_t format_integer(char *out, int64_t v);
+
+	/**
+	 * Format the shortest decimal representation which parses back to
+	 * the same double into out (at least 32 bytes)
+	 * @return number of chars written
+	 */
+	static size_t format_number(char *out, double v);
+
+	private:
+	static const int MAX_DEPTH = 16;
+
+	void separator();
+
+	std::string _buf;
+	int _depth;
+	bool _first[MAX_DEPTH];	/**< no value written yet in the container of this level */
+	bool _after_key;
+};
+
+#endif /* _JSONWRITER_H_ */
@@ -0,0 +1,123 @@
+/**
+ * Readings of a channel kept for the local interface
+ *
+ * Each channel has a ring of its readings sorted by time. Requests find
+ * the readings of a time range by binary search instead of scanning them,
+ * and may downsample them to a number of points keeping the curve's shape.
+ *
+ * @package vzlogger
+ * @copyright Copyright (c) 2011, The volkszaehler.org project
+ * @license http://www.gnu.org/licenses/gpl.txt GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LOCALBUFFER_H_
+#define _LOCALBUFFER_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <limits>
+#include <vector>
+
+#include <shared_ptr.hpp>
+#include <RingBuffer.hpp>
+
+class ChannelData
+{
+public:
+	ChannelData() : _t(0), _v(0) {};
+	ChannelData(const int64_t &t, const double &v) : _t(t), _v(v) {};
+	int64_t _t;
+	double _v;
+};
+
+typedef RingBuffer<ChannelData> RING_ChannelData;
+
+/**
+ * Range and size of the tuples returned by a request
+ */
+class TupleQuery
+{
+public:
+	TupleQuery() : _from(0), _to(std::numeric_limits<int64_t>::max()), _limit(0), _points(0) {};
+
+	int64_t _from;		// oldest timestamp returned (inclusive)
+	int64_t _to;		// newest timestamp returned (inclusive)
+	size_t _limit;		// return the newest <limit> tuples only, 0 = all
+	size_t _points;		// downsample to this number of tuples, 0 = all
+};
+
+/**
+ * Readings of a single channel sorted by time, with a lock of its own
+ * so requests for different channels don't wait for each other
+ */
+class LocalBuffer
+{
+public:
+	typedef vz::shared_ptr<LocalBuffer> Ptr;
+
+	/**
+	 * @param capacity of the ring, it grows only if a time based buffer needs more
+	 * @param max number of readings to keep, 0 for a time based buffer
+	 */
+	LocalBuffer(size_t capacity, size_t max);
+	~LocalBuffer();
+
+	void lock()   { pthread_mutex_lock(&_mutex); }
+	void unlock() { pthread_mutex_unlock(&_mutex); }
+
+	/**
+	 * Append a reading, readings not newer than the last one are skipped to keep the order
+	 */
+	void push(int64_t t, double v);
+
+	/**
+	 * @return index of the first reading newer than t (binary search)
+	 */
+	size_t after(int64_t t) const;
+
+	/**
+	 * Drop the readings older than t
+	 */
+	void expire(int64_t t);
+
+	int64_t newest() const { return _data.empty() ? 0 : _data.back()._t; }
+
+	/**
+	 * Select the readings returned for a query
+	 *
+	 * Downsampling keeps the newest reading for 1 point, the first and the last one
+	 * for 2 points, and uses Largest-Triangle-Three-Buckets for more.
+	 * @param selected indices into _data in ascending order
+	 */
+	void select(const TupleQuery &query, std::vector<size_t> &selected) const;
+
+	RING_ChannelData _data;
+	size_t _max;
+	int64_t _streamed;		// timestamp of the newest reading sent to the streams
+
+private:
+	LocalBuffer(const LocalBuffer &); // no copies
+	LocalBuffer & operator=(const LocalBuffer &);
+
+	void lttb(size_t first, size_t last, size_t points, std::vector<size_t> &selected) const;
+
+	pthread_mutex_t _mutex;
+};
+
+#endif /* _LOCALBUFFER_H_ */
@@ -83,16 +83,31 @@ public:
 /**
  *  Accessor to the channel list
  */
-	inline void push_back(Channel::Ptr channel) { _channels.push_back(channel); }
+	inline void push_back(Channel::Ptr channel) {
+		_channels.push_back(channel);
+
+		uint32_t key = channel->identifier_key();
+		if (key >= _dispatch.size()) _dispatch.resize(key + 1);
+		_dispatch[key].push_back(channel);
+	}
 	inline iterator begin()  { return _channels.begin(); }
 	inline iterator end()    { return _channels.end(); }
 	inline size_t size()     { return _channels.size(); }
 
+/**
+ * Channels subscribed to readings with the given identifier key
+ * @return NULL if no channel uses this identifier
+ */
+	inline const std::vector<Channel::Ptr> *channels(uint32_t key) const {
+		return (key < _dispatch.size() && !_dispatch[key].empty()) ? &_dispatch[key] : NULL;
+	}
+
 	bool running() const { return _thread_running; }
 
 private:
 	Meter::Ptr _meter;
 	std::vector<Channel::Ptr> _channels;
+	std::vector<std::vector<Channel::Ptr> > _dispatch; // dispatch table: identifier key -> channels
 
 	bool _thread_running;   // flag if thread is started
 	pthread_t _thread;      // Thread data for meter (reading)
@@ -44,6 +44,7 @@ class Obis {
 	const std::string toString()  ;
 
 	bool operator==(const Obis &rhs) const;
+	bool operator<(const Obis &rhs) const; // any strict order, e.g. for maps
 
 	bool isManufacturerSpecific() const;
 	bool isAllNotGiven() const; // check whether all are not given (=DC/255)
@@ -0,0 +1,119 @@
+/**
+ * Streaming quantile estimation
+ *
+ * Implements the P-square algorithm (R. Jain, I. Chlamtac, 1985): a single
+ * quantile is tracked with five markers whose heights are adjusted by
+ * piecewise parabolic interpolation on each new value. Memory and time per
+ * value are constant, no values are stored.
+ *
+ * @package vzlogger
+ * @copyright Copyright (c) 2011, The volkszaehler.org project
+ * @license http://www.gnu.org/licenses/gpl.txt GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _P2QUANTILE_H_
+#define _P2QUANTILE_H_
+
+#include <stddef.h>
+#include <algorithm>
+
+class P2Quantile {
+
+public:
+	/**
+	 * @param p quantile to estimate, 0 < p < 1 (e.g. 0.95 for the 95th percentile)
+	 */
+	explicit P2Quantile(double p = 0.5) : _p(p), _count(0) {}
+
+	void reset() { _count = 0; }
+	size_t count() const { return _count; }
+
+	void add(double x) {
+		if (_count < 5) {
+			_q[_count++] = x;
+			if (_count == 5) {
+				std::sort(_q, _q + 5);
+				for (int i = 0; i < 5; i++) _n[i] = i + 1;
+				_np[0] = 1; _np[1] = 1 + 2 * _p; _np[2] = 1 + 4 * _p; _np[3] = 3 + 2 * _p; _np[4] = 5;
+				_dn[0] = 0; _dn[1] = _p / 2; _dn[2] = _p; _dn[3] = (1 + _p) / 2; _dn[4] = 1;
+			}
+			return;
+		}
+
+		// find the cell k with q[k] <= x < q[k+1], extending the extremes if needed
+		int k;
+		if (x < _q[0]) { _q[0] = x; k = 0; }
+		else if (x < _q[1]) k = 0;
+		else if (x < _q[2]) k = 1;
+		else if (x < _q[3]) k = 2;
+		else if (x <= _q[4]) k = 3;
+		else { _q[4] = x; k = 3; }
+
+		for (int i = k + 1; i < 5; i++) _n[i]++;
+		for (int i = 0; i < 5; i++) _np[i] += _dn[i];
+
+		// adjust the heights of the middle markers if they are off their desired position
+		for (int i = 1; i < 4; i++) {
+			double d = _np[i] - _n[i];
+			if ((d >= 1 && _n[i + 1] - _n[i] > 1) || (d <= -1 && _n[i - 1] - _n[i] < -1)) {
+				int s = (d > 0) ? 1 : -1;
+				double q = parabolic(i, s);
+				if (_q[i - 1] < q && q < _q[i + 1]) {
+					_q[i] = q;
+				} else {
+					_q[i] = _q[i] + s * (_q[i + s] - _q[i]) / (_n[i + s] - _n[i]); // linear
+				}
+				_n[i] += s;
+			}
+		}
+		_count++;
+	}
+
+	/**
+	 * Current estimate. Exact (interpolated) as long as less than five values were added.
+	 */
+	double value() const {
+		if (_count >= 5) return _q[2];
+		if (_count == 0) return 0.0;
+
+		double q[5];
+		std::copy(_q, _q + _count, q);
+		std::sort(q, q + _count);
+		double pos = _p * (_count - 1);
+		size_t i = (size_t)pos;
+		if (i + 1 >= _count) return q[_count - 1];
+		return q[i] + (pos - i) * (q[i + 1] - q[i]);
+	}
+
+private:
+	double parabolic(int i, int d) const {
+		return _q[i] + d / (_n[i + 1] - _n[i - 1]) *
+			((_n[i] - _n[i - 1] + d) * (_q[i + 1] - _q[i]) / (_n[i + 1] - _n[i]) +
+			 (_n[i + 1] - _n[i] - d) * (_q[i] - _q[i - 1]) / (_n[i] - _n[i - 1]));
+	}
+
+	double _p;
+	size_t _count;
+	double _q[5];	/**< marker heights */
+	double _n[5];	/**< actual marker positions */
+	double _np[5];	/**< desired marker positions */
+	double _dn[5];	/**< increments of the desired positions */
+};
+
+#endif /* _P2QUANTILE_H_ */
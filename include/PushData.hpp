@@ -6,27 +6,76 @@
 #define __push_data_hpp_
 
 #include <string>
-#include <utility> // for std::pair
 #include <unordered_map>
-#include <queue>
+#include <deque>
 #include <list>
+#include <vector>
+#include <stdint.h>
 #include <pthread.h>
+#include <curl/curl.h>
+
+#include "ContentEncoder.hpp"
+#include "JsonWriter.hpp"
+#include "RingBuffer.hpp"
 
 // PushDataList provides a thread safe list
+// Readings are collected in one of two preallocated buffers while the push thread
+// sends the other one. Channels are referenced by interned ids instead of uuid strings.
+// The buffer is bounded, if the push thread can't keep up readings get dropped by policy.
 class PushDataList
 {
 public:
-    typedef std::pair<int64_t, double> DataTuple;
-    typedef std::queue<DataTuple> DataQueue;
-    typedef std::unordered_map<std::string, DataQueue> DataMap;
+    typedef uint32_t Id; // interned uuid
+
+    enum Policy {
+        DROP_OLDEST, // drop the oldest reading if the buffer is full
+        DROP_NEWEST, // drop the new reading if the buffer is full
+        COALESCE     // keep only the latest reading per channel
+    };
+
+    typedef struct {
+        Id id;
+        int64_t time_ms;
+        double value;
+    } DataTuple;
+    typedef RingBuffer<DataTuple> Data; // in order of arrival
 
-    PushDataList();
+    PushDataList(size_t max_size = 64 * 1024, Policy policy = DROP_OLDEST); // max_size in bytes per buffer
     ~PushDataList();
-    void add(const std::string &uuid, const int64_t &time_ms, const double &value);
-    DataMap *waitForData(); // blocks infinite until data is available. returned object is owned by caller! must be deleted after usage!
+
+    Id id(const std::string &uuid); // interns uuid, ids are never released
+    const std::string &uuid(Id id);
+    size_t ids(); // number of interned uuids
+
+    void add(Id id, const int64_t &time_ms, const double &value);
+    void add(const std::string &uuid, const int64_t &time_ms, const double &value) { add(id(uuid), time_ms, value); }
+
+    // blocks max 5s until data is available, NULL on timeout.
+    // The returned data is owned by the list and valid until the next call (single consumer!)
+    const Data *waitForData();
+
+    size_t capacity() const { return _capacity; }
+    size_t dropped() const { return _dropped; } // number of readings dropped so far
+
+    static Policy parse(const char *policy); // throws vz::VZException
 protected:
+    typedef struct {
+        Data data;
+        std::vector<size_t> last; // COALESCE: per id absolute position + 1 of its latest tuple
+        size_t popped; // number of tuples dropped from the front since the last clear
+    } Buffer;
+
+    void clear(Buffer &buf);
+
+    Buffer _buf[2];
+    int _write; // buffer add() writes to, the other one belongs to the consumer
+    size_t _capacity; // max. tuples per buffer
+    Policy _policy;
+    size_t _dropped;
+    size_t _reported; // _dropped at the time of the last warning
 
-    DataMap *_next;
+    std::unordered_map<std::string, Id> _idMap;
+    std::deque<std::string> _uuids; // by id, references stay valid
     pthread_mutex_t _map_mutex;
     pthread_cond_t _cond;
 };
@@ -39,7 +88,8 @@ class PushDataServer
 public:
     PushDataServer(struct json_object *option);
 	PushDataServer(const PushDataServer &) = delete; // no copy constructor!
-    ~PushDataServer();
+    ~PushDataServer(); // waits for the requests in flight
+    void release(); // waits for the requests in flight and frees the curl handles, before curlShare is deleted
     bool waitAndSendOnceToAll();
 protected:
     typedef struct {
@@ -48,16 +98,44 @@ protected:
     } CURLresponse;
 
 
-    std::string generateJson(PushDataList::DataMap &dataMap);
-    bool send(const std::string &middleware, const std::string &datastr);
+    typedef struct {
+        std::string url;
+        ContentEncoder::Ptr encoder; // optional compression of the body
+        long timeout; // seconds per request
+        size_t queue_max; // max. requests waiting while one is in flight
+
+        // asynchronous sending (with curlMulti), guarded by _mutex
+        CURL *curl; // own handle, kept over the transfer
+        bool busy; // request in flight
+        std::string body; // of the request in flight
+        std::deque<std::string> queue; // bodies waiting for the request in flight
+        CURLresponse response;
+    } Middleware;
+
+    const std::string &generateJson(const PushDataList::Data &data); // valid until the next call
+    bool send(const Middleware &middleware, const std::string &datastr); // blocking
+    void prepare(CURL *curl, const Middleware &middleware, const std::string &datastr, CURLresponse *response);
+    bool result(const Middleware &middleware, CURLcode curl_code, long http_code, const CURLresponse &response);
+
+    // asynchronous sending, each target has its own queue so a stalled one doesn't delay the others
+    void enqueue(Middleware &middleware, const std::string &datastr);
+    void start(Middleware &middleware);
+    void done(Middleware &middleware, CURLcode curl_code); // called from the transport thread
     friend class PushDataServerTest;
 
     static size_t curl_custom_write_callback(void *ptr, size_t size, size_t nmemb, void *data);
 
 
-    typedef std::list<std::string> MiddlewareList;
+    typedef std::list<Middleware> MiddlewareList;
     MiddlewareList _middlewareList;
     struct curl_slist *_headers;
+    struct curl_slist *_gzipHeaders; // _headers plus Content-Encoding
+    struct curl_slist *_deflateHeaders;
+    JsonWriter _json; // request body, reused
+    std::vector<size_t> _start; // generateJson: per id start in _order
+    std::vector<size_t> _order; // generateJson: tuple indices grouped by id
+    pthread_mutex_t _mutex;
+    pthread_cond_t _cond; // signaled when a request finished
 };
 
 void *push_data_thread(void *arg);
@@ -28,7 +28,12 @@
 
 #include <string>
 #include <sstream>
+#include <map>
+#include <vector>
+#include <atomic>
 
+#include <stdint.h>
+#include <pthread.h>
 #include <sys/time.h>
 #include <string.h>
 
@@ -135,6 +140,65 @@ public:
 private:
 };
 
+/**
+ * Registry of all reading identifiers in use
+ *
+ * Each distinct identifier is stored once and resolved to a small integer key.
+ * Readings only carry this key, so matching a reading to a channel is an integer compare.
+ * Key 0 is reserved for "no identifier".
+ * Identifiers are never removed, so lookup() reads the published entries without locking.
+ */
+class ReadingIdentifierRegistry {
+public:
+	static ReadingIdentifierRegistry &instance();
+
+	/**
+	 * Get the key for an identifier, registering it if it wasn't seen before
+	 * @return 0 for an empty identifier, or if the registry is full
+	 */
+	uint32_t intern(ReadingIdentifier::Ptr rid);
+	ReadingIdentifier::Ptr lookup(uint32_t key) const;
+	size_t size() const;
+
+private:
+	ReadingIdentifierRegistry();
+	~ReadingIdentifierRegistry();
+	ReadingIdentifierRegistry(const ReadingIdentifierRegistry &); // no copies
+	ReadingIdentifierRegistry & operator=(const ReadingIdentifierRegistry &);
+
+	enum { CHUNK = 256, CHUNKS = 256 };
+
+	pthread_mutex_t _mutex;							// serializes intern()
+	std::map<std::string, uint32_t> _keys;			// type and unparsed identifier -> key
+	bool _full;										// warned about the limit
+	ReadingIdentifier::Ptr *_chunks[CHUNKS];		// indexed by key, chunks are never moved
+	std::atomic<uint32_t> _size;					// keys below are stored and visible to lookup()
+};
+
+/**
+ * Keys of the identifiers a meter reports, so each is interned only once
+ *
+ * Used by the reading thread of a single meter, so it needs no lock.
+ * K is the natural key of the identifier (e.g. Obis or std::string), ID the
+ * identifier class constructed from it.
+ */
+template <class K, class ID>
+class ReadingIdentifierKeys {
+public:
+	uint32_t key(const K &k) {
+		typename std::map<K, uint32_t>::const_iterator it = _keys.find(k);
+		if (it != _keys.end()) return it->second;
+
+		const uint32_t key = ReadingIdentifierRegistry::instance().intern(ReadingIdentifier::Ptr(new ID(k)));
+		if (_keys.size() < MAX_KEYS) _keys[k] = key; // free-form identifiers don't grow it forever
+		return key;
+	}
+
+private:
+	enum { MAX_KEYS = 1024 };
+	std::map<K, uint32_t> _keys;
+};
+
 class Reading {
 
 public:
@@ -159,8 +223,10 @@ public:
 	// not needed yet: void time_from_ms( int64_t &ms );
 	void time_from_double( double const &d);
 
-	void identifier(ReadingIdentifier *rid)  { _identifier.reset(rid); }
-	const ReadingIdentifier::Ptr identifier() { return _identifier; }
+	void identifier(ReadingIdentifier *rid)  { _key = ReadingIdentifierRegistry::instance().intern(ReadingIdentifier::Ptr(rid)); }
+	const ReadingIdentifier::Ptr identifier() const { return ReadingIdentifierRegistry::instance().lookup(_key); }
+	uint32_t key() const { return _key; } // interned identifier, see ReadingIdentifierRegistry
+	void key(uint32_t key) { _key = key; } // for fixed identifiers a meter interns once
 
 /**
  * Print identifier to buffer for debugging/dump
@@ -173,10 +239,10 @@ public:
                 (_time.tv_sec == rhs._time.tv_sec) && (_time.tv_usec == rhs._time.tv_usec);}
 
 protected:
-	bool   _deleted;
 	double _value;
 	struct timeval _time;
-	ReadingIdentifier::Ptr _identifier;
+	uint32_t _key;
+	bool   _deleted;
 };
 
 /**
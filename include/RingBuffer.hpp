@@ -0,0 +1,158 @@
+/**
+ * Contiguous ring buffer
+ *
+ * Stores its elements in a single array which is reused between
+ * push_back() and pop_front()/clear(). The storage only grows (doubling)
+ * if more elements are held at once than ever before, so a buffer which
+ * is drained regularly never allocates again once it reached its working size.
+ *
+ * @package vzlogger
+ * @copyright Copyright (c) 2011, The volkszaehler.org project
+ * @license http://www.gnu.org/licenses/gpl.txt GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _RINGBUFFER_H_
+#define _RINGBUFFER_H_
+
+#include <stddef.h>
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+template<class T>
+class RingBuffer {
+
+public:
+	template<class R, class V> class Iterator;
+	typedef Iterator<RingBuffer, T> iterator;
+	typedef Iterator<const RingBuffer, const T> const_iterator;
+
+	explicit RingBuffer(size_t capacity = 16) : _head(0), _size(0) {
+		size_t n = 1;
+		while (n < capacity) n <<= 1; // keep capacity a power of two, index wrap is a mask
+		_data.resize(n);
+	}
+
+	size_t size() const     { return _size; }
+	size_t capacity() const { return _data.size(); }
+	bool empty() const      { return _size == 0; }
+
+	T &operator[](size_t i)             { return _data[(_head + i) & (_data.size() - 1)]; }
+	const T &operator[](size_t i) const { return _data[(_head + i) & (_data.size() - 1)]; }
+
+	T &front() { return (*this)[0]; }
+	T &back()  { return (*this)[_size - 1]; }
+	const T &front() const { return (*this)[0]; }
+	const T &back() const  { return (*this)[_size - 1]; }
+
+	void push_back(const T &v) {
+		if (_size == _data.size()) grow();
+		(*this)[_size++] = v;
+	}
+
+	void pop_front() {
+		_head = (_head + 1) & (_data.size() - 1);
+		_size--;
+	}
+
+	/**
+	 * Drop the n oldest elements at once
+	 */
+	void pop_front(size_t n) {
+		_head = (_head + n) & (_data.size() - 1);
+		_size -= n;
+	}
+
+	/**
+	 * Drop all elements. Keeps the allocated storage.
+	 */
+	void clear() { _head = 0; _size = 0; }
+
+	/**
+	 * Remove all elements matching pred while keeping the order of the others.
+	 * Single pass, no allocation.
+	 */
+	template<class Pred>
+	void erase_if(Pred pred) {
+		size_t keep = 0;
+		for (size_t i = 0; i < _size; i++) {
+			if (!pred((*this)[i])) {
+				if (keep != i) (*this)[keep] = (*this)[i];
+				keep++;
+			}
+		}
+		_size = keep;
+	}
+
+	void swap(RingBuffer &other) {
+		_data.swap(other._data);
+		std::swap(_head, other._head);
+		std::swap(_size, other._size);
+	}
+
+	iterator begin() { return iterator(this, 0); }
+	iterator end()   { return iterator(this, _size); }
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const   { return const_iterator(this, _size); }
+
+	template<class R, class V>
+	class Iterator {
+	public:
+		typedef std::bidirectional_iterator_tag iterator_category;
+		typedef typename std::remove_const<V>::type value_type;
+		typedef ptrdiff_t difference_type;
+		typedef V *pointer;
+		typedef V &reference;
+
+		Iterator() : _rb(NULL), _pos(0) {}
+		Iterator(R *rb, size_t pos) : _rb(rb), _pos(pos) {}
+
+		V &operator*() const  { return (*_rb)[_pos]; }
+		V *operator->() const { return &(*_rb)[_pos]; }
+
+		Iterator &operator++()   { _pos++; return *this; }
+		Iterator operator++(int) { Iterator tmp(*this); _pos++; return tmp; }
+		Iterator &operator--()   { _pos--; return *this; }
+		Iterator operator--(int) { Iterator tmp(*this); _pos--; return tmp; }
+
+		bool operator==(const Iterator &rhs) const { return _pos == rhs._pos && _rb == rhs._rb; }
+		bool operator!=(const Iterator &rhs) const { return !(*this == rhs); }
+
+	private:
+		R *_rb;
+		size_t _pos;
+	};
+
+private:
+	void grow() {
+		std::vector<T> data(_data.size() * 2);
+		for (size_t i = 0; i < _size; i++) {
+			data[i] = (*this)[i];
+		}
+		_data.swap(data);
+		_head = 0;
+	}
+
+	std::vector<T> _data;
+	size_t _head;	/**< index of the oldest element in _data */
+	size_t _size;	/**< number of valid elements */
+};
+
+#endif /* _RINGBUFFER_H_ */
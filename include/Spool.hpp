@@ -0,0 +1,126 @@
+/**
+ * Durable spool for readings not yet acknowledged by the middleware
+ *
+ * Append-only and segment based: readings are written to memory mapped
+ * segment files of fixed size in <dir>/<name>/. Each segment header keeps
+ * the number of records already acknowledged, segments which are written
+ * and acknowledged completely are deleted. The mappings are flushed to
+ * disk each <sync> seconds. Unacknowledged readings are replayed at startup.
+ *
+ * @package vzlogger
+ * @copyright Copyright (c) 2011, The volkszaehler.org project
+ * @license http://www.gnu.org/licenses/gpl.txt GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SPOOL_H_
+#define _SPOOL_H_
+
+#include <stdint.h>
+#include <time.h>
+#include <string>
+#include <deque>
+#include <list>
+
+#include <shared_ptr.hpp>
+#include <Reading.hpp>
+
+class Spool {
+
+	public:
+	typedef vz::shared_ptr<Spool> Ptr;
+
+	/**
+	 * Open (and create if needed) the spool
+	 *
+	 * @param dir base directory of all spools
+	 * @param name name of this spool, e.g. the channel uuid
+	 * @param maxsize max. size of all segments in bytes. The oldest segment gets dropped if exceeded.
+	 * @param sync flush to disk each <sync> seconds, 0 after each change
+	 * @param segment_size size of a segment file in bytes
+	 * @throw vz::VZException if the spool can't be opened
+	 */
+	Spool(const std::string &dir, const std::string &name, size_t maxsize, int sync,
+		  size_t segment_size = 256 * 1024);
+	~Spool();
+
+	/**
+	 * Append unacknowledged readings to out (oldest first)
+	 * @return number of readings appended
+	 */
+	size_t replay(std::list<Reading> &out);
+
+	/**
+	 * Append a reading
+	 * If the disk is full the oldest segment is dropped to make room.
+	 * @return number of oldest unacknowledged readings dropped due to the size limit or a full disk
+	 * @throw vz::VZException if no segment can be allocated
+	 */
+	size_t append(const Reading &rd);
+
+	/**
+	 * Acknowledge the n oldest unacknowledged readings
+	 */
+	void ack(size_t n);
+
+	size_t pending() const;		/**< number of unacknowledged readings */
+	size_t segments() const { return _segments.size(); }
+	void sync();
+
+	private:
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t acked;			/**< number of acknowledged records in this segment */
+	};
+
+	struct Record {
+		int64_t time_ms;		/**< written last, 0 marks a free record */
+		double value;
+	};
+
+	struct Segment {
+		uint64_t seq;
+		void *map;
+		size_t written;			/**< number of valid records */
+		bool writable;			/**< blocks reserved, records can be appended */
+		Header *header() const { return static_cast<Header *>(map); }
+		Record *records() const { return reinterpret_cast<Record *>(static_cast<Header *>(map) + 1); }
+	};
+
+	Spool(const Spool &); // no copies
+	Spool & operator=(const Spool &);
+
+	std::string filename(uint64_t seq) const;
+	Segment open_segment(uint64_t seq, bool create);
+	bool closed(const Segment &seg) const { return seg.written == _capacity || !seg.writable; }
+	size_t drop_front();
+	void maybe_sync();
+
+	std::string _path;
+	size_t _maxsize;
+	int _sync;
+	size_t _segment_size;
+	size_t _capacity;			/**< records per segment */
+	time_t _last_sync;
+	bool _dirty;
+
+	std::deque<Segment> _segments;
+};
+
+#endif /* _SPOOL_H_ */
@@ -0,0 +1,172 @@
+/**
+ * Shared pool of uploader threads
+ *
+ * Instead of one logging thread per channel a small number of workers
+ * take channels with pending readings from a ready queue and send them.
+ * Failed channels are retried by a timer, and the number of concurrent
+ * requests to a single middleware is limited.
+ *
+ * @package vzlogger
+ * @copyright Copyright (c) 2011, The volkszaehler.org project
+ * @license http://www.gnu.org/licenses/gpl.txt GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _UPLOADPOOL_H_
+#define _UPLOADPOOL_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string>
+#include <deque>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <shared_ptr.hpp>
+#include <Channel.hpp>
+#include <ApiIF.hpp>
+
+class UploadPool {
+
+	public:
+	typedef vz::ApiIF::Ptr (*ApiFactory)(Channel::Ptr ch, size_t sink);
+
+	/**
+	 * Start the worker threads
+	 *
+	 * @param workers number of worker threads
+	 * @param connections max. concurrent requests per middleware (0 = unlimited)
+	 * @param retry_pause delay in seconds after the first failure of a middleware,
+	 *        doubled for each further failure in a row
+	 * @param factory creates the api for each sink of a channel in attach()
+	 * @param batch_window delay in ms before channels with a batch key are sent,
+	 *        so other channels of the same batch can join the request
+	 * @param retry_max upper limit of the retry delay in seconds (0 = retry_pause)
+	 * @param breaker number of failed retry rounds in a row which pause all channels of a
+	 *        middleware until a single probe request succeeds (0 = never)
+	 */
+	UploadPool(size_t workers, size_t connections, int retry_pause, ApiFactory factory,
+			   int batch_window = 0, int retry_max = 0, unsigned int breaker = 3);
+
+	/**
+	 * Stop and join the worker threads. Requests in flight are finished first.
+	 */
+	~UploadPool();
+
+	/**
+	 * Create the apis for the sinks of a channel and start serving them
+	 * Each sink is scheduled on its own, with the limits and backoff of its middleware.
+	 * @throw vz::VZException if an api can't be created
+	 */
+	void attach(Channel::Ptr ch);
+
+	/**
+	 * Stop scheduling a channel (doesn't block)
+	 */
+	void cancel(const Channel *ch);
+
+	/**
+	 * Wait until a canceled channel isn't sent anymore and release it
+	 */
+	void join(const Channel *ch);
+
+	/**
+	 * Mark a channel as having new readings (called from the meter threads)
+	 */
+	void ready(const Channel *ch);
+
+	private:
+	enum State {
+		IDLE,		/**< nothing to send */
+		QUEUED,		/**< in the ready queue */
+		BUSY,		/**< being sent by a worker */
+		RETRY		/**< waiting for the retry timer */
+	};
+
+	/**
+	 * Circuit breaker of a middleware
+	 */
+	enum Circuit {
+		CLOSED,		/**< requests pass */
+		OPEN,		/**< all channels wait until open_until */
+		HALF_OPEN	/**< a single probe request decides */
+	};
+
+	struct Endpoint {
+		Endpoint() : circuit(CLOSED), failures(0), retry_at(0), open_until(0), probing(false) {}
+		Circuit circuit;
+		unsigned int failures;	/**< retry rounds in a row */
+		int64_t retry_at;		/**< end of the current retry round, monotonic ms */
+		int64_t open_until;		/**< monotonic ms */
+		bool probing;			/**< probe request in flight */
+	};
+
+	struct Entry {
+		typedef vz::shared_ptr<Entry> Ptr;
+		Channel::Ptr ch;
+		size_t sink;			/**< index of the sink in the channel */
+		vz::ApiIF::Ptr api;
+		std::string middleware;	/**< key for the concurrency limit */
+		std::string endpoint;	/**< key for the backoff, the middleware or the channel if none */
+		std::string batch;		/**< batch key of the api, empty if sent alone */
+		State state;
+		bool dirty;				/**< new readings arrived while BUSY */
+		bool canceled;
+	};
+
+	UploadPool(const UploadPool &); // no copies
+	UploadPool & operator=(const UploadPool &);
+
+	static void *worker(void *arg);
+	void run();
+	Entry::Ptr next();		/**< dequeue the first entry whose middleware has a free slot */
+	void enqueue(const Entry::Ptr &e);	/**< new readings, batched entries wait for the batch window */
+	void push_ready(const Entry::Ptr &e);
+	void gather(const std::string &key, std::vector<Entry::Ptr> &batch);
+	bool admit(const Entry::Ptr &e, int64_t now);	/**< circuit breaker allows sending e */
+	int64_t failed(const std::string &endpoint);	/**< update the breaker once per retry round, @return retry delay in ms */
+	void succeeded(const std::string &endpoint);
+	int64_t deadline();		/**< next timer or circuit to expire, 0 if none */
+	static int64_t now_ms();
+
+	size_t _connections;
+	int _retry_pause;
+	ApiFactory _factory;
+	int _batch_window;
+	int _retry_max;
+	unsigned int _breaker;
+	std::minstd_rand _random;	/**< jitter of the retry delays */
+
+	bool _running;
+	pthread_mutex_t _mutex;
+	pthread_cond_t _cond;		/**< signaled on new work, freed slots and finished sends */
+	std::vector<pthread_t> _threads;
+
+	typedef std::multimap<const Channel *, Entry::Ptr> EntryMap;	/**< one entry per sink */
+	EntryMap _entries;
+	std::deque<Entry::Ptr> _ready;
+	std::multimap<int64_t, Entry::Ptr> _timers;	/**< retry or batch deadline (monotonic ms) -> entry */
+	std::map<std::string, size_t> _active;		/**< requests in flight per middleware */
+	std::map<std::string, Endpoint> _endpoints;
+};
+
+// var to a global/single instance. needs to be initialized e.g. in main()
+extern UploadPool *uploadPool;
+
+#endif /* _UPLOADPOOL_H_ */
@@ -44,7 +44,7 @@ namespace vz {
 			void clearHeader();
 			void commitHeader();
       
-			CURLcode perform() { return curl_easy_perform(handle()); }
+			CURLcode perform();
       
 		private:
 			CURL *_curl;
@@ -38,6 +38,7 @@
 #include <api/CurlIF.hpp>
 #include <api/CurlResponse.hpp>
 #include <Reading.hpp>
+#include <Journal.hpp>
 
 namespace vz {
 	namespace api {
@@ -51,7 +52,7 @@ namespace vz {
 			MySmartGrid(Channel::Ptr ch, std::list<Option> options);
 			~MySmartGrid();
 	
-			void send();
+			bool send();
 
 			void register_device();
 			
@@ -107,7 +108,11 @@ namespace vz {
 			CurlIF _curlIF;
 			CurlResponse::Ptr _response;
 	
+			Journal::Ptr _journal;   /**< readings of the channel, shared with its other sinks */
+			size_t _sink;            /**< our cursor in the journal */
+
 			// Volatil
+			std::vector<Reading> _batch; /**< new readings taken over from the journal */
 			std::list<Reading> _values;
 
 			time_t _first_ts;
@@ -33,6 +33,7 @@
 
 #include <ApiIF.hpp>
 #include <Options.hpp>
+#include <Journal.hpp>
 
 namespace vz {
 	namespace api {
@@ -44,10 +45,14 @@ namespace vz {
 			Null(Channel::Ptr ch, std::list<Option> options);
 			~Null();
 
-			void send();
+			bool send();
 
 			void register_device();
 
+		private:
+			Journal::Ptr _journal;	/**< readings of the channel, shared with its other sinks */
+			size_t _sink;			/**< our cursor in the journal */
+
 		}; // class Null
 
 	} // namespace api
@@ -38,7 +38,11 @@
 #include <json-c/json.h>
 
 #include <ApiIF.hpp>
+#include <ContentEncoder.hpp>
+#include <JsonWriter.hpp>
 #include <Options.hpp>
+#include <Spool.hpp>
+#include <Journal.hpp>
 #include "Buffer.hpp"
 
 namespace vz {
@@ -61,10 +65,24 @@ namespace vz {
 			Volkszaehler(Channel::Ptr ch, std::list<Option> options);
 			~Volkszaehler();
 
-			void send();
+			bool send();
 
 			void register_device();
 
+			/**
+			 * Channels with the batch option are sent together per middleware
+			 */
+			std::string batch_key() const { return _batchUpload ? _middleware : std::string(); }
+
+			/**
+			 * Send the readings of several channels of this middleware in one request
+			 * (multi-UUID format) or, if the middleware doesn't support it, in one request
+			 * per channel on the same connection
+			 *
+			 * @return false if any request failed
+			 */
+			bool send_batch(const std::vector<ApiIF *> &apis);
+
 			const std::string middleware() const { return _middleware; }
 
 		private:
@@ -72,13 +90,97 @@ namespace vz {
 			unsigned int _curlTimeout;
 			std::string _url;
 
+			// chunked upload
+			static const size_t CHUNK_MIN = 10;		/**< smallest adaptive chunk */
+			static const size_t CHUNK_STEP = 100;	/**< adaptive increase per fast request */
+			size_t _maxTuples;	/**< max. tuples per request, 0 = unlimited */
+			size_t _maxBytes;	/**< max. request body size, 0 = unlimited */
+			bool _adaptive;		/**< adapt chunk size to the request duration */
+			size_t _chunk;		/**< current max. tuples per request */
+			size_t _inflight;	/**< number of tuples in the current request */
+
+			// batched upload
+			bool _batchUpload;	/**< send together with other channels of the middleware */
+			bool _multiUuid;	/**< middleware accepts multi-UUID requests (until it rejects one) */
+			bool _http2;		/**< multiplex the requests to the middleware over HTTP/2 */
+
+			// request body compression
+			ContentEncoder::Ptr _encoder;	/**< reused for all requests, if enabled */
+			struct curl_slist *_encodedHeaders;	/**< _api.headers plus Content-Encoding */
+
+			// serialized request bodies
+			std::string _format;	/**< wire format of the tuples, chunks are shared with sinks of the same format */
+			Journal::Body _body;	/**< tuples of the current chunk */
+			JsonWriter _batchJson;	/**< multi-UUID request, reused between requests */
+
 			/**
-			 * Create JSON object of tuples
+			 * Fetch the new readings into the journal and serialize the first chunk of tuples
 			 *
 			 * @param buf	the buffer our readings are stored in (required for mutex)
-			 * @return the json_object (has to be free'd)
+			 * @return the JSON string (valid until the next call), NULL if nothing is queued
+			 */
+			const char * api_json_tuples(Buffer::Ptr buf);
+
+			/**
+			 * Serialize the oldest pending tuples within the chunk limits
+			 * and remember their number in _inflight
+			 *
+			 * @return the JSON string (valid until the next call), NULL if nothing is pending
+			 */
+			const char * api_json_chunk();
+
+			/**
+			 * Serialize log[first..last) as array of tuples, up to maxbytes
+			 * @return number of tuples serialized, at least one
+			 */
+			static size_t serialize_tuples(const RingBuffer<Reading> &log, size_t first, size_t last,
+										   size_t maxbytes, JsonWriter &json);
+
+			/**
+			 * Send a single chunk and remove it from the queue if acknowledged
+			 *
+			 * @return true on success
+			 */
+			bool send_chunk(const char *json_str);
+
+			/**
+			 * Serialize an array of {uuid, tuples} objects for a multi-UUID request
+			 * from the current chunks of the channels
+			 *
+			 * @return the JSON string (valid until the next call)
+			 */
+			const char * api_json_batch(const std::vector<Volkszaehler *> &apis);
+
+			/**
+			 * Send the current chunks of several channels in one multi-UUID request
+			 * and remove them from the queues if acknowledged
+			 *
+			 * @param rejected set if the middleware doesn't understand the request
+			 * @return true on success
+			 */
+			bool send_multi(const std::vector<Volkszaehler *> &apis, bool &rejected);
+
+			/**
+			 * @return true if the HTTP status means the middleware doesn't support
+			 * multi-UUID requests; server errors are retried like network errors instead
+			 */
+			static bool multi_rejected(long http_code);
+
+			/**
+			 * POST a request body to the middleware
+			 */
+			CURLcode post(const std::string &url, const char *body, CURLresponse *response,
+						  long *http_code, double *total_time);
+
+			/**
+			 * Acknowledge the tuples of the current chunk in the journal
+			 */
+			void ack();
+
+			/**
+			 * Adjust the chunk size to the result of the last request (AIMD)
 			 */
-			json_object * api_json_tuples(Buffer::Ptr buf);
+			void adapt_chunk(CURLcode curl_code, double total_time);
 
       /**
        * Parses JSON encoded exception and stores describtion in err
@@ -90,11 +192,8 @@ namespace vz {
 		private:
 			api_handle_t _api;
 
-          // Volatil
-			std::list<Reading> _values;
-		  int64_t _last_timestamp; /**< remember last timestamp */
-          // duplicate support:
-          Reading *_lastReadingSent;
+			Journal::Ptr _journal;	/**< readings of the channel, shared with its other sinks */
+			size_t _sink;			/**< our cursor in the journal */
 
 		}; //class Volkszaehler
 
@@ -32,6 +32,21 @@
 
 #include <microhttpd.h>
 
+/* epoll with an internal polling thread, renamed in libmicrohttpd 0.9.53 */
+/* suspended connections for comet requests, renamed as well */
+#if MHD_VERSION >= 0x00095300
+#define LOCAL_EPOLL_FLAGS MHD_USE_EPOLL_INTERNAL_THREAD
+#define LOCAL_SUSPEND_FLAGS MHD_ALLOW_SUSPEND_RESUME
+#else
+#define LOCAL_EPOLL_FLAGS (MHD_USE_SELECT_INTERNALLY | MHD_USE_EPOLL_LINUX_ONLY)
+#define LOCAL_SUSPEND_FLAGS MHD_USE_SUSPEND_RESUME
+#endif
+
+/**
+ * Serve a request to the local interface
+ *
+ * Called concurrently by the workers of the HTTPd, the readings are locked per channel only.
+ */
 int handle_request(
 	void *cls,
 	struct MHD_Connection *connection,
@@ -43,9 +58,37 @@ int handle_request(
 	void **con_cls
 );
 
+/**
+ * Free the state of a comet request, passed as MHD_OPTION_NOTIFY_COMPLETED
+ */
+void request_completed(
+	void *cls,
+	struct MHD_Connection *connection,
+	void **con_cls,
+	enum MHD_RequestTerminationCode toe
+);
+
+/**
+ * Answer all suspended comet requests and end the streams, has to be called before the HTTPd is stopped
+ */
+void stop_local_requests();
+
 class Channel;
-void shrink_localbuffer(); // remove old data in the local buffer
-void add_ch_to_localbuffer(Channel &ch);
+class MapContainer;
+class Reading;
+
+/**
+ * Create the buffers of all channels and hook them into the channel buffers,
+ * has to be called before the meters are started
+ */
+void init_localbuffer(MapContainer &mappings);
+void push_localbuffer(int id, const Reading &rd); // a Buffer::Listener, called by the reading threads
+void expire_ch_localbuffer(Channel &ch); // wakes the comet requests waiting for the channel
+
+/**
+ * Send the readings added since the last call to the /stream clients, a Channel::Listener
+ */
+void stream_localbuffer(Channel &ch);
 
 #endif /* _LOCAL_H_ */
 
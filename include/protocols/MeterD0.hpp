@@ -83,6 +83,8 @@ private:
 	void dump_file(DUMP_MODE mode, const char* str);
 	void dump_file(DUMP_MODE mode, const char* buf, size_t len);
 	void dump_file(const char &c){ dump_file(DUMP_IN, &c, 1);};
+
+	ReadingIdentifierKeys<Obis, ObisIdentifier> _keys;
 };
 
 #endif /* _D0_H_ */
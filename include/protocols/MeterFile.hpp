@@ -47,6 +47,7 @@ public:
 	int _rewind;
 
 	FILE *_fd;
+	ReadingIdentifierKeys<std::string, StringIdentifier> _keys;
 };
 
 #endif /* _FILE_H_ */
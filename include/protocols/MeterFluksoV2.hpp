@@ -44,6 +44,7 @@ public:
   private:
 	const char *_fifo;
 	int _fd;	/* file descriptor of fifo */
+	ReadingIdentifierKeys<int, ChannelIdentifier> _keys;
 
 	//const char *DEFAULT_FIFO = "/var/run/spid/delta/out";
 	// const char *_DEFAULT_FIFO;
@@ -190,6 +190,7 @@ protected:
 	int _autofix_range, _autofix_x, _autofix_y;
 	ReadsMap *_last_reads;
 	bool _generate_debug_image;
+	ReadingIdentifierKeys<std::string, StringIdentifier> _keys;
 };
 
 #endif
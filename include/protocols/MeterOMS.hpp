@@ -66,6 +66,12 @@ protected:
 	std::string _device;
 	bool _mbus_debug;
 	double _last_timestamp;
+
+	// interned identifiers of the readings
+	const uint32_t _key_1_8_0;
+	const uint32_t _key_2_8_0;
+	const uint32_t _key_1_7_0;
+	const uint32_t _key_2_7_0;
 };
 
 #endif
@@ -44,6 +44,7 @@ protected:
 	double _min;
 	double _max;
 	double _last;
+	const uint32_t _key; // interned NilIdentifier
 };
 
 #endif /* _RANDOM_H_ */
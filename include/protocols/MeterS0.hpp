@@ -122,6 +122,12 @@ public:
 	std::atomic<struct timespec> _time_last_impulse; // timestamp of last impulse
 	struct timespec _time_last_impulse_returned; // timestamp of last impulse returned
 	bool _first_impulse;
+
+	// interned identifiers of the readings
+	const uint32_t _key_power;
+	const uint32_t _key_impulse;
+	const uint32_t _key_power_neg;
+	const uint32_t _key_impulse_neg;
 };
 
 #endif /* _S0_H_ */
@@ -93,6 +93,8 @@ protected:
 	 * @return file descriptor, <0 on error
 	 */
 	int _openSocket(const char *node, const char *service);
+
+	ReadingIdentifierKeys<Obis, ObisIdentifier> _keys;
 };
 
 
@@ -49,6 +49,7 @@ public:
 protected:
 
 	W1HWif *_hwif;
+	ReadingIdentifierKeys<std::string, StringIdentifier> _keys;
 };
 
 #endif
@@ -26,9 +26,13 @@
 #ifndef _THREADS_H_
 #define _THREADS_H_
 
-void logging_thread_cleanup(void *arg);
+#include <ApiIF.hpp>
+
+/**
+ * Create the configured api interface of a channel
+ */
+vz::ApiIF::Ptr create_api(Channel::Ptr ch, size_t sink = 0);
 
-void * logging_thread(void *arg);
 void * reading_thread(void *arg);
 
 #endif /* _THREADS_H_ */
@@ -1,5 +1,5 @@
 /**
- * Circular buffer (double linked)
+ * Circular buffer (contiguous ring)
  *
  * Used to store recent readings and buffer in case of net inconnectivity
  *
@@ -28,139 +28,200 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include "float.h" /* double min max */
+#include <algorithm>
+#include <math.h>
 #include "common.h"
 
 #include "Buffer.hpp"
 
 Buffer::Buffer() :
-		_keep(32), _last_avg(0)
+		_sent(32), _listener(NULL), _listener_id(-1), _keep(32), _agg_count(0), _agg_have_prev(false)
 {
 	_newValues=false;
 	pthread_mutex_init(&_mutex, NULL);
 	_aggmode=NONE;
+	agg_reset();
+}
+
+void Buffer::set_aggmode(Buffer::aggmode m) {
+	_aggmode = m;
+	switch (m) {
+		case P50: _agg_quantile = P2Quantile(0.50); break;
+		case P95: _agg_quantile = P2Quantile(0.95); break;
+		case P99: _agg_quantile = P2Quantile(0.99); break;
+		default: break;
+	}
+	agg_reset();
 }
 
 void Buffer::push(const Reading &rd) {
 	lock();
+	if (_aggmode == NONE) {
+		store(rd);
+	} else {
+		agg_add(rd);
+	}
+	unlock();
+}
+
+/**
+ * Hand over all readings to the consumer
+ *
+ * The readings are swapped into batch in O(1), so the producer is never blocked while
+ * the consumer processes them. batch is cleared before and its storage gets recycled
+ * for the following readings.
+ */
+void Buffer::take(RingBuffer<Reading> &batch) {
+	batch.clear();
+	lock();
+	_sent.swap(batch);
+	unlock();
+}
+
+/**
+ * Store a reading for the consumers unless the compressor drops it
+ * Called with the buffer locked.
+ */
+void Buffer::store(const Reading &rd) {
+	if (!_compressor.enabled()) {
+		append(rd);
+		return;
+	}
+
+	Reading kept;
+	if (_compressor.add(rd, kept)) {
+		append(kept);
+	}
+}
+
+/**
+ * Hand a stored reading to the consumers and the listener
+ * Called with the buffer locked.
+ */
+void Buffer::append(const Reading &rd) {
 	_sent.push_back(rd);
+	if (_listener) {
+		_listener(_listener_id, rd);
+	}
+}
+
+bool Buffer::flush() {
+	Reading kept;
+	lock();
+	const bool flushed = _compressor.flush(kept);
+	if (flushed) {
+		append(kept);
+	}
 	unlock();
+	return flushed;
+}
+
+/**
+ * Reset the running accumulators at the start of a new aggregation period
+ * The previous reading used for AVG is kept as starting point of the next period.
+ */
+void Buffer::agg_reset() {
+	_agg_count = 0;
+	_agg_value = 0.0;
+	_agg_timespan = 0.0;
+	_agg_m2 = 0.0;
+	_agg_quantile.reset();
+}
+
+/**
+ * Fold a reading into the running accumulators of the current period
+ * Called with the buffer locked.
+ */
+void Buffer::agg_add(const Reading &rd) {
+	if (_agg_count == 0 || rd.time_ms() >= _agg_latest.time_ms()) {
+		_agg_latest = rd;
+	}
+
+	switch (_aggmode) {
+		case MAX:
+			_agg_value = (_agg_count == 0) ? rd.value() : std::max(_agg_value, rd.value());
+			break;
+		case MIN:
+			_agg_value = (_agg_count == 0) ? rd.value() : std::min(_agg_value, rd.value());
+			break;
+		case SUM:
+			_agg_value += rd.value();
+			break;
+		case STDDEV: {
+			double delta = rd.value() - _agg_value;
+			_agg_value += delta / (_agg_count + 1);
+			_agg_m2 += delta * (rd.value() - _agg_value);
+			break;
+		}
+		case P50:
+		case P95:
+		case P99:
+			_agg_quantile.add(rd.value());
+			break;
+		case AVG:
+		case INTEGRAL:
+			// AVG needs to handle tuples with different distances properly:
+			// each value is weighted with the time until the next one arrives.
+			// The last reading from the previous period is used as the starting point.
+			// we assume readings are pushed sorted by time here!
+			if (_agg_have_prev) {
+				double timespan = ((double)(rd.time_ms() - _agg_prev.time_ms())) / 1000.0;
+				_agg_value += _agg_prev.value() * timespan; // timespan between prev. and this one
+				_agg_timespan += timespan;
+			}
+			_agg_prev = rd;
+			_agg_have_prev = true;
+			break;
+		default:
+			break;
+	}
+	_agg_count++;
 }
 
 void Buffer::aggregate(int aggtime, bool aggFixedInterval) {
 	if (_aggmode == NONE) return;
 
 	lock();
-	if (_aggmode == MAX) {
-		Reading *latest=NULL;
-		double aggvalue=DBL_MIN;
-		for (iterator it = _sent.begin(); it!= _sent.end(); it++) {
-			if (! it->deleted()) {
-				if (!latest) {
-					latest=&*it;
-				} else {
-					if (it->time_ms() > latest->time_ms()) {
-						latest=&*it;
-					}
-				}
-				aggvalue=std::max(aggvalue,it->value());
-				print(log_debug, "%f @ %lld", "MAX",it->value(),it->time_ms());
-			}
-		}
-		for (iterator it = _sent.begin(); it!= _sent.end(); it++) {
-			if (! it->deleted()) {
-				if (&*it==latest) {
-					it->value(aggvalue);
-					print(log_debug, "RESULT %f @ %lld", "MAX",it->value(),it->time_ms());
-				} else {
-					it->mark_delete();
-				}
-			}
-		}
-	} else if (_aggmode == AVG) {
-		// AVG needs to handle tuples with different distances properly:
-		// so we need to consider the last tuple from last aggregate call as well
-		// and use this value as the starting point.
-		// we assume buffer values are already sorted by time here! TODO: is this always true?
-		// otherwise a sort by time would be needed but this might conflict with _last_avg
-
-		Reading *latest = NULL;
-		double aggvalue = 0;
-		double aggtimespan = 0.0;
-		unsigned int aggcount = 0;
-		Reading *previous = _last_avg;
-		for (iterator it = _sent.begin(); it!= _sent.end(); it++) {
-			if (! it->deleted()) {
-				if (!latest) {
-					latest=&*it;
-				} else {
-					if (it->time_ms() > latest->time_ms()) {
-						latest=&*it;
-					}
-				}
-				print(log_debug, "[%d] %f @ %lld", "AVG",aggcount,it->value(),it->time_ms());
-				if (previous) {
-					double timespan = ((double)(it->time_ms() - previous->time_ms())) / 1000.0;
-					aggvalue += previous->value() * timespan; // timespan between prev. and this one
-					aggtimespan += timespan;
-				}
-				previous = &*it;
-				aggcount++;
-			}
-		}
-		for (iterator it = _sent.begin(); it!= _sent.end(); it++) {
-			if (! it->deleted()) {
-				if (&*it==latest) {
-					// store the last value before we modify it.
-					if (!_last_avg) _last_avg = new Reading(*it);
-					else *_last_avg = *it;
-
-					if (aggtimespan>0.0)
-						it->value(aggvalue/aggtimespan);
-					// else keep current value (if no previous and just single value)
-					print(log_debug, "[%d] RESULT %f @ %lld", "AVG",aggcount,it->value(),it->time_ms());
-				} else {
-					it->mark_delete();
-				}
-			}
-		}
-	} else if (_aggmode == SUM) {
-		Reading *latest=NULL;
-		double aggvalue=0;
-		for (iterator it = _sent.begin(); it!= _sent.end(); it++) {
-			if (! it->deleted()) {
-				if (!latest) {
-					latest=&*it;
-				} else {
-					if (it->time_ms() > latest->time_ms()) {
-						latest=&*it;
-					}
-				}
-				aggvalue=aggvalue+it->value();
-				print(log_debug, "%f @ %lld", "SUM",it->value(),it->time_ms());
-			}
-		}
-		for (iterator it = _sent.begin(); it!= _sent.end(); it++) {
-			if (! it->deleted()) {
-				if (&*it==latest) {
-					it->value(aggvalue);
-					print(log_debug, "RESULT %f @ %lld", "SUM",it->value(),it->time_ms());
-				} else {
-					it->mark_delete();
-				}
-			}
+	if (_agg_count > 0) {
+		Reading result(_agg_latest);
+		result.reset();
+
+		switch (_aggmode) {
+			case AVG:
+				if (_agg_timespan > 0.0)
+					result.value(_agg_value / _agg_timespan);
+				// else keep current value (if no previous and just single value)
+				break;
+			case INTEGRAL:
+				result.value(_agg_value / 3600.0); // e.g. W * s -> Wh
+				break;
+			case COUNT:
+				result.value(_agg_count);
+				break;
+			case STDDEV:
+				result.value(sqrt(_agg_m2 / _agg_count));
+				break;
+			case P50:
+			case P95:
+			case P99:
+				result.value(_agg_quantile.value());
+				break;
+			default:
+				result.value(_agg_value);
+				break;
 		}
-	}
-	/* fix timestamp if aggFixedInterval set */
-	if ((aggFixedInterval==true) && (aggtime>0)) {
-		struct timeval tv;
-		for (iterator it = _sent.begin(); it!= _sent.end(); it++) {
-			if (! it->deleted()) {
-				tv.tv_usec = 0;
-				tv.tv_sec = aggtime * (long int)((it->time_ms()/1000) / aggtime);
-				it->time(tv);
-			}
+
+		/* fix timestamp if aggFixedInterval set */
+		if ((aggFixedInterval==true) && (aggtime>0)) {
+			struct timeval tv;
+			tv.tv_usec = 0;
+			tv.tv_sec = aggtime * (long int)((result.time_ms()/1000) / aggtime);
+			result.time(tv);
 		}
+
+		print(log_debug, "[%d] RESULT %f @ %lld", "AGG", _agg_count, result.value(), result.time_ms());
+		store(result);
+		agg_reset();
 	}
 	unlock();
 	clean();
@@ -171,13 +232,7 @@ void Buffer::aggregate(int aggtime, bool aggFixedInterval) {
 void Buffer::clean(bool deleted_only) {
 	lock();
 	if (deleted_only) {
-		for (iterator it = _sent.begin(); it!= _sent.end(); it++) {
-			if (it->deleted()) {
-				it = _sent.erase(it);
-				it--;
-			}
-
-		}
+		_sent.erase_if([](const Reading &rd) { return rd.deleted(); });
 	} else {
 		_sent.clear();
 	}
@@ -224,7 +279,6 @@ char * Buffer::dump(char *dump, size_t len) {
 
 Buffer::~Buffer() {
 	pthread_mutex_destroy(&_mutex);
-	if (_last_avg) delete _last_avg;
 }
 
 /*
@@ -29,12 +29,16 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <errno.h>
+#include <stdint.h>
 
 #include "common.h"
 
 #include "Channel.hpp"
+#include "UploadPool.hpp"
 
 int Channel::instances = 0;
+Channel::Listener Channel::_listener = NULL;
 
 Channel::Channel(
 	const std::list<Option> &pOptions,
@@ -42,14 +46,17 @@ Channel::Channel(
 	const std::string uuid,
 	ReadingIdentifier::Ptr pIdentifier
 	)
-		: _thread_running(false)
+		: _running(false)
 		, _options(pOptions)
 		, _buffer(new Buffer())
 		, _identifier(pIdentifier)
+		, _identifier_key(ReadingIdentifierRegistry::instance().intern(pIdentifier))
 		, _last(0)
 		, _uuid(uuid)
 		, _apiProtocol(apiProtocol)
 		, _duplicates (0)
+		, _push_id (-1)
+		, _local_id (-1)
 {
 	id = instances++;
 
@@ -69,6 +76,20 @@ Channel::Channel(
 			_buffer->set_aggmode(Buffer::AVG);
 		} else if (strcasecmp(aggmode_str, "sum") == 0 ) {
 			_buffer->set_aggmode(Buffer::SUM);
+		} else if (strcasecmp(aggmode_str, "min") == 0 ) {
+			_buffer->set_aggmode(Buffer::MIN);
+		} else if (strcasecmp(aggmode_str, "count") == 0 ) {
+			_buffer->set_aggmode(Buffer::COUNT);
+		} else if (strcasecmp(aggmode_str, "stddev") == 0 ) {
+			_buffer->set_aggmode(Buffer::STDDEV);
+		} else if (strcasecmp(aggmode_str, "integral") == 0 ) {
+			_buffer->set_aggmode(Buffer::INTEGRAL);
+		} else if (strcasecmp(aggmode_str, "p50") == 0 ) {
+			_buffer->set_aggmode(Buffer::P50);
+		} else if (strcasecmp(aggmode_str, "p95") == 0 ) {
+			_buffer->set_aggmode(Buffer::P95);
+		} else if (strcasecmp(aggmode_str, "p99") == 0 ) {
+			_buffer->set_aggmode(Buffer::P99);
 		} else if (strcasecmp(aggmode_str, "none") == 0 ) {
 			_buffer->set_aggmode(Buffer::NONE);
 		} else {
@@ -96,14 +117,93 @@ Channel::Channel(
 		throw;
 	}
 
-	pthread_cond_init(&condition, NULL); // initialize thread syncronization helpers
+	try {
+		// lossy compression
+		Compressor::compmode compmode = Compressor::NONE;
+		const char *compmode_str = optlist.lookup_string(pOptions, "compmode");
+		if (strcasecmp(compmode_str, "deadband") == 0 ) {
+			compmode = Compressor::DEADBAND;
+		} else if (strcasecmp(compmode_str, "swingingdoor") == 0 ) {
+			compmode = Compressor::SWINGINGDOOR;
+		} else if (strcasecmp(compmode_str, "none") != 0 ) {
+			throw vz::VZException("Compmode unknown.");
+		}
+
+		double compdev = 0.0;
+		double compdevrel = 0.0;
+		int compmaxtime = (compmode == Compressor::SWINGINGDOOR) ? Compressor::SWINGINGDOOR_MAXTIME : 0;
+		try {
+			compdev = optlist.lookup_double(pOptions, "compdev");
+		} catch (vz::OptionNotFoundException &e) { }
+		try {
+			compdevrel = optlist.lookup_double(pOptions, "compdevrel");
+		} catch (vz::OptionNotFoundException &e) { }
+		try {
+			compmaxtime = optlist.lookup_int(pOptions, "compmaxtime");
+		} catch (vz::OptionNotFoundException &e) { }
+		if (compdev < 0 || compdevrel < 0 || compmaxtime < 0) {
+			throw vz::VZException("compdev, compdevrel and compmaxtime have to be >= 0");
+		}
+		if (compmode == Compressor::SWINGINGDOOR && compmaxtime == 0) {
+			print(log_warning, "compmaxtime disabled, a flat signal is only sent when it changes", name());
+		}
+
+		_buffer->set_compression(compmode, compdev, compdevrel, compmaxtime);
+	} catch (vz::OptionNotFoundException &e) {
+		// no compression by default
+	} catch (vz::VZException &e) {
+		std::stringstream oss;
+		oss << e.what();
+		print(log_error, "Missing or invalid compmode (%s)", name(), oss.str().c_str());
+		throw;
+	}
+
+	_journal = Journal::Ptr(new Journal(_duplicates));
+
+	Sink sink;
+	sink.api = apiProtocol;
+	sink.options.insert(sink.options.end(), pOptions.begin(), pOptions.end());
+	_sinks.push_back(sink);
 }
 
 /**
  * Free all allocated memory recursivly
  */
 Channel::~Channel() {
-	pthread_cond_destroy(&condition);
+}
+
+void Channel::start() {
+	if (!uploadPool) {
+		throw vz::VZException("No upload pool.");
+	}
+	_running = true; // before attaching, so no notify() gets lost
+	try {
+		uploadPool->attach(shared_from_this());
+	} catch (...) {
+		_running = false;
+		throw;
+	}
+}
+
+void Channel::cancel() {
+	if (running()) uploadPool->cancel(this);
+}
+
+void Channel::join() {
+	if (running()) {
+		uploadPool->join(this);
+		_running = false;
+	}
+}
+
+/**
+ * Tell the listener and the upload pool that new readings are available
+ *
+ * The buffer has to be flagged with have_newValues() before.
+ */
+void Channel::notify() {
+	if (_listener) _listener(*this);
+	if (running()) uploadPool->ready(this);
 }
 
 
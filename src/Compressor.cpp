@@ -0,0 +1,122 @@
+/**
+ * Lossy compression of a channel's readings
+ *
+ * @package vzlogger
+ * @copyright Copyright (c) 2011, The volkszaehler.org project
+ * @license http://www.gnu.org/licenses/gpl.txt GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+
+#include "Compressor.hpp"
+
+Compressor::Compressor() :
+		_mode(NONE), _dev(0.0), _devrel(0.0), _maxtime_ms(0),
+		_have_kept(false), _have_held(false), _slope_max(DBL_MAX), _slope_min(-DBL_MAX)
+{
+}
+
+void Compressor::configure(compmode mode, double dev, double devrel, int maxtime) {
+	_mode = mode;
+	_dev = dev;
+	_devrel = devrel;
+	_maxtime_ms = (int64_t)maxtime * 1000;
+	_have_kept = false;
+	_have_held = false;
+}
+
+double Compressor::deviation(double value) const {
+	return std::max(_dev, _devrel * fabs(value));
+}
+
+bool Compressor::add(const Reading &rd, Reading &out) {
+	if (_mode == NONE || !_have_kept) {
+		// the first reading is always kept
+		_kept = rd;
+		_have_kept = true;
+		_have_held = false;
+		_slope_max = DBL_MAX;
+		_slope_min = -DBL_MAX;
+		out = rd;
+		return true;
+	}
+
+	const bool timeout = (_maxtime_ms > 0) && (rd.time_ms() - _kept.time_ms() >= _maxtime_ms);
+
+	if (_mode == DEADBAND) {
+		if (timeout || fabs(rd.value() - _kept.value()) > deviation(_kept.value())) {
+			_kept = rd;
+			out = rd;
+			return true;
+		}
+		return false;
+	}
+
+	// SWINGINGDOOR
+	double dt = (double)(rd.time_ms() - _kept.time_ms());
+	if (dt <= 0) { // same timestamp as the pivot, nothing to interpolate
+		return false;
+	}
+
+	// slopes of the lines from the pivot which are within the deviation of all readings up to the held one
+	const double held_max = _slope_max;
+	const double held_min = _slope_min;
+
+	double e = deviation(_kept.value());
+	_slope_max = std::min(_slope_max, (rd.value() + e - _kept.value()) / dt);
+	_slope_min = std::max(_slope_min, (rd.value() - e - _kept.value()) / dt);
+
+	if ((_slope_min > _slope_max || timeout) && _have_held) {
+		// door closed: the held reading becomes the new pivot and has to be kept.
+		// Its value is moved onto the middle of the door, so that the line from the
+		// previous pivot stays within the deviation of all dropped readings.
+		const double slope = (held_min + held_max) / 2;
+		_held.value(_kept.value() + slope * (_held.time_ms() - _kept.time_ms()));
+		_kept = _held;
+		out = _held;
+
+		dt = (double)(rd.time_ms() - _kept.time_ms());
+		e = deviation(_kept.value());
+		_slope_max = (dt > 0) ? (rd.value() + e - _kept.value()) / dt : DBL_MAX;
+		_slope_min = (dt > 0) ? (rd.value() - e - _kept.value()) / dt : -DBL_MAX;
+
+		_held = rd;
+		return true;
+	}
+
+	_held = rd;
+	_have_held = true;
+	return false;
+}
+
+bool Compressor::flush(Reading &out) {
+	if (_mode != SWINGINGDOOR || !_have_held) return false;
+
+	// like a closing door, but the current door includes the held reading
+	const double slope = (_slope_min + _slope_max) / 2;
+	_held.value(_kept.value() + slope * (_held.time_ms() - _kept.time_ms()));
+	_kept = _held;
+	_have_held = false;
+	_slope_max = DBL_MAX;
+	_slope_min = -DBL_MAX;
+	out = _kept;
+	return true;
+}
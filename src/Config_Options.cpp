@@ -42,7 +42,19 @@ Config_Options::Config_Options()
 		, _verbosity(0)
 		, _comet_timeout(30)
 		, _buffer_length(-1)
+		, _local_workers(4)
+		, _local_connections(64)
 		, _retry_pause(15)
+		, _spool_size(16 * 1024 * 1024)
+		, _spool_sync(10)
+		, _upload_workers(4)
+		, _upload_connections(2)
+		, _upload_prewarm(false)
+		, _upload_batch_window(200)
+		, _upload_retry_max(300)
+		, _upload_breaker(3)
+		, _push_buffer_size(64 * 1024)
+		, _push_buffer_policy(PushDataList::DROP_OLDEST)
 		, _daemon(false)
 		, _local(false)
 		, _logging(true)
@@ -60,7 +72,19 @@ Config_Options::Config_Options(
 		, _verbosity(0)
 		, _comet_timeout(30)
 		, _buffer_length(-1)
+		, _local_workers(4)
+		, _local_connections(64)
 		, _retry_pause(15)
+		, _spool_size(16 * 1024 * 1024)
+		, _spool_sync(10)
+		, _upload_workers(4)
+		, _upload_connections(2)
+		, _upload_prewarm(false)
+		, _upload_batch_window(200)
+		, _upload_retry_max(300)
+		, _upload_breaker(3)
+		, _push_buffer_size(64 * 1024)
+		, _push_buffer_policy(PushDataList::DROP_OLDEST)
 		, _daemon(false)
 		, _local(false)
 		, _logging(true)
@@ -146,6 +170,12 @@ void Config_Options::config_parse(
 						_buffer_length = json_object_get_int(local_value);
 						if (!_buffer_length) _buffer_length = -1; // 0 makes no sense, use size based mode with 1 element
 					}
+					else if (strcmp(key, "workers") == 0 && local_type == json_type_int) {
+						_local_workers = json_object_get_int(local_value);
+					}
+					else if (strcmp(key, "connections") == 0 && local_type == json_type_int) {
+						_local_connections = json_object_get_int(local_value);
+					}
 					else if (strcmp(key, "index") == 0 && local_type == json_type_boolean) {
 						_channel_index = json_object_get_boolean(local_value);
 					}
@@ -155,6 +185,69 @@ void Config_Options::config_parse(
 					}
 				}
 			}
+			else if (strcmp(key, "spool") == 0 && type == json_type_object) {
+				json_object_object_foreach(value, key, spool_value) {
+					enum json_type spool_type = json_object_get_type(spool_value);
+
+					if (strcmp(key, "dir") == 0 && spool_type == json_type_string) {
+						_spool_dir = json_object_get_string(spool_value);
+					}
+					else if (strcmp(key, "size") == 0 && spool_type == json_type_int && json_object_get_int(spool_value) > 0) {
+						_spool_size = (size_t)json_object_get_int(spool_value) * 1024;
+					}
+					else if (strcmp(key, "sync") == 0 && spool_type == json_type_int) {
+						_spool_sync = json_object_get_int(spool_value);
+					}
+					else {
+						print(log_error, "Ignoring invalid field or type: %s=%s (%s)",
+									NULL, key, json_object_get_string(spool_value), option_type_str[spool_type]);
+					}
+				}
+			}
+			else if (strcmp(key, "upload") == 0 && type == json_type_object) {
+				json_object_object_foreach(value, key, upload_value) {
+					enum json_type upload_type = json_object_get_type(upload_value);
+
+					if (strcmp(key, "workers") == 0 && upload_type == json_type_int && json_object_get_int(upload_value) > 0) {
+						_upload_workers = json_object_get_int(upload_value);
+					}
+					else if (strcmp(key, "connections") == 0 && upload_type == json_type_int && json_object_get_int(upload_value) >= 0) {
+						_upload_connections = json_object_get_int(upload_value);
+					}
+					else if (strcmp(key, "prewarm") == 0 && upload_type == json_type_boolean) {
+						_upload_prewarm = json_object_get_boolean(upload_value);
+					}
+					else if (strcmp(key, "batchwindow") == 0 && upload_type == json_type_int && json_object_get_int(upload_value) >= 0) {
+						_upload_batch_window = json_object_get_int(upload_value);
+					}
+					else if (strcmp(key, "retrymax") == 0 && upload_type == json_type_int && json_object_get_int(upload_value) >= 0) {
+						_upload_retry_max = json_object_get_int(upload_value);
+					}
+					else if (strcmp(key, "breaker") == 0 && upload_type == json_type_int && json_object_get_int(upload_value) >= 0) {
+						_upload_breaker = json_object_get_int(upload_value);
+					}
+					else {
+						print(log_error, "Ignoring invalid field or type: %s=%s (%s)",
+									NULL, key, json_object_get_string(upload_value), option_type_str[upload_type]);
+					}
+				}
+			}
+			else if (strcmp(key, "pushbuffer") == 0 && type == json_type_object) {
+				json_object_object_foreach(value, key, buffer_value) {
+					enum json_type buffer_type = json_object_get_type(buffer_value);
+
+					if (strcmp(key, "size") == 0 && buffer_type == json_type_int && json_object_get_int(buffer_value) > 0) {
+						_push_buffer_size = (size_t)json_object_get_int(buffer_value) * 1024;
+					}
+					else if (strcmp(key, "policy") == 0 && buffer_type == json_type_string) {
+						_push_buffer_policy = PushDataList::parse(json_object_get_string(buffer_value));
+					}
+					else {
+						print(log_error, "Ignoring invalid field or type: %s=%s (%s)",
+									NULL, key, json_object_get_string(buffer_value), option_type_str[buffer_type]);
+					}
+				}
+			}
 			else if ((strcmp(key, "sensors") == 0 || strcmp(key, "meters") == 0) && type == json_type_array) {
 				int len = json_object_array_length(value);
 				for (int i = 0; i < len; i++) {
@@ -230,6 +323,7 @@ void Config_Options::config_parse_channel(Json &jso, MeterMap &mapping)
 	const char *uuid = NULL;
 	const char *id_str = NULL;
 	std::string apiProtocol_str;
+	struct json_object *jso_sinks = NULL;
 
 	print(log_debug, "Configure channel.", NULL);
 	json_object_object_foreach(jso.Object(), key, value) {
@@ -247,6 +341,9 @@ void Config_Options::config_parse_channel(Json &jso, MeterMap &mapping)
 		else if (strcmp(key, "api") == 0 && type == json_type_string) {
 			apiProtocol_str = json_object_get_string(value);
 		}
+		else if (strcmp(key, "sinks") == 0 && type == json_type_array) {
+			jso_sinks = value;
+		}
 		else { /* all other options will be passed to meter_init() */
 			Option option(key, value);
 			options.push_back(option);
@@ -289,6 +386,31 @@ void Config_Options::config_parse_channel(Json &jso, MeterMap &mapping)
 	}
 
 	Channel::Ptr ch(new Channel(options, apiProtocol_str.c_str(), uuid, id));
+
+	/* several apis for the readings of the channel, their options override the channel options */
+	if (jso_sinks) {
+		std::vector<Channel::Sink> sinks;
+		int len = json_object_array_length(jso_sinks);
+		for (int i = 0; i < len; i++) {
+			struct json_object *jso_sink = json_object_array_get_idx(jso_sinks, i);
+			if (json_object_get_type(jso_sink) != json_type_object) {
+				throw vz::VZException("config: sinks element not an object");
+			}
+			Channel::Sink sink;
+			sink.api = apiProtocol_str;
+			json_object_object_foreach(jso_sink, key, value) {
+				if (strcmp(key, "api") == 0 && json_object_get_type(value) == json_type_string) {
+					sink.api = json_object_get_string(value);
+				} else {
+					sink.options.push_back(Option(key, value));
+				}
+			}
+			sink.options.insert(sink.options.end(), options.begin(), options.end());
+			print(log_info, "Sink %d: api=%s", ch->name(), i, sink.api.c_str());
+			sinks.push_back(sink);
+		}
+		ch->sinks(sinks);
+	}
 	print(log_info, "New channel initialized (uuid=...%s api=%s id=%s)", ch->name(),
 				uuid+30, apiProtocol_str.c_str(), (id_str) ? id_str : "(none)");
 	mapping.push_back(ch);
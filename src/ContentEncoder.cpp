@@ -0,0 +1,84 @@
+/**
+ * Compression of request bodies (HTTP Content-Encoding)
+ *
+ * @package vzlogger
+ * @copyright Copyright (c) 2011, The volkszaehler.org project
+ * @license http://www.gnu.org/licenses/gpl.txt GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include <VZException.hpp>
+#include "ContentEncoder.hpp"
+
+ContentEncoder::ContentEncoder(Encoding encoding, size_t min_size)
+		: _encoding(encoding)
+		, _min_size(min_size)
+		, _size(0)
+{
+	memset(&_zs, 0, sizeof(_zs));
+	if (_encoding == NONE) return;
+
+	// window bits 15, +16 selects the gzip wrapper instead of zlib
+	const int bits = (_encoding == GZIP) ? 15 + 16 : 15;
+	if (deflateInit2(&_zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		throw vz::VZException("Cannot initialize zlib.");
+	}
+}
+
+ContentEncoder::~ContentEncoder() {
+	if (_encoding != NONE) deflateEnd(&_zs);
+}
+
+ContentEncoder::Encoding ContentEncoder::parse(const std::string &name) {
+	if (name == "none") return NONE;
+	if (name == "gzip") return GZIP;
+	if (name == "deflate") return DEFLATE;
+	throw vz::VZException("Invalid encoding '" + name + "'");
+}
+
+bool ContentEncoder::encode(const char *body, size_t len) {
+	if (_encoding == NONE || len < _min_size) return false;
+
+	deflateReset(&_zs);
+	// the bound doesn't cover the gzip header in all zlib versions
+	const size_t bound = deflateBound(&_zs, len) + 32;
+	if (_out.size() < bound) _out.resize(bound);
+
+	_zs.next_in = (Bytef *)body;
+	_zs.avail_in = len;
+	_zs.next_out = (Bytef *)&_out[0];
+	_zs.avail_out = _out.size();
+
+	if (deflate(&_zs, Z_FINISH) != Z_STREAM_END) return false;
+
+	_size = _out.size() - _zs.avail_out;
+	return _size < len;
+}
+
+const char *ContentEncoder::header() const {
+	switch (_encoding) {
+		case GZIP:
+			return "Content-Encoding: gzip";
+		case DEFLATE:
+			return "Content-Encoding: deflate";
+		default:
+			return NULL;
+	}
+}
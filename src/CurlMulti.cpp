@@ -0,0 +1,238 @@
+/**
+ * CurlMulti - asynchronous transport for all apis based on the curl multi interface
+ *
+ * @package vzlogger
+ * @copyright Copyright (c) 2011, The volkszaehler.org project
+ * @license http://www.gnu.org/licenses/gpl.txt GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common.h"
+#include <VZException.hpp>
+#include "CurlMulti.hpp"
+
+CurlMulti *curlMulti = 0;
+
+CurlMulti::CurlMulti(long max_host_connections)
+		: _running(true)
+{
+	curl_global_init(CURL_GLOBAL_ALL);
+
+	_multi = curl_multi_init();
+	if (!_multi) {
+		throw vz::VZException("CURL: cannot create multi handle.");
+	}
+#if LIBCURL_VERSION_NUM >= 0x072b00 /* 7.43.0 */
+	// send concurrent requests to the same host over one HTTP/2 connection if possible
+	curl_multi_setopt(_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+#if LIBCURL_VERSION_NUM >= 0x071e00 /* 7.30.0 */
+	if (max_host_connections > 0) {
+		curl_multi_setopt(_multi, CURLMOPT_MAX_HOST_CONNECTIONS, max_host_connections);
+	}
+#endif
+
+	if (pipe(_wakeup) < 0) {
+		curl_multi_cleanup(_multi);
+		throw vz::VZException("Cannot create pipe.");
+	}
+	for (int i = 0; i < 2; i++) {
+		fcntl(_wakeup[i], F_SETFL, fcntl(_wakeup[i], F_GETFL) | O_NONBLOCK);
+		fcntl(_wakeup[i], F_SETFD, FD_CLOEXEC);
+	}
+
+	pthread_mutex_init(&_mutex, NULL);
+
+	int ret = pthread_create(&_thread, NULL, &CurlMulti::loop, this);
+	if (ret) {
+		print(log_error, "Cannot create transport thread: %s", "curl", strerror(ret));
+		close(_wakeup[0]);
+		close(_wakeup[1]);
+		curl_multi_cleanup(_multi);
+		throw vz::VZException("Cannot create transport thread.");
+	}
+}
+
+CurlMulti::~CurlMulti() {
+	pthread_mutex_lock(&_mutex);
+	_running = false;
+	pthread_mutex_unlock(&_mutex);
+	wakeup();
+	pthread_join(_thread, NULL);
+
+	close(_wakeup[0]);
+	close(_wakeup[1]);
+	curl_multi_cleanup(_multi);
+	pthread_mutex_destroy(&_mutex);
+	curl_global_cleanup();
+}
+
+void CurlMulti::multiplex(CURL *easy, bool enable) {
+#if LIBCURL_VERSION_NUM >= 0x072b00 /* 7.43.0 */
+	// rather wait for a connection to multiplex on than opening another one
+	curl_easy_setopt(easy, CURLOPT_PIPEWAIT, enable ? 1L : 0L);
+#endif
+#if LIBCURL_VERSION_NUM >= 0x072f00 /* 7.47.0 */
+	curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, enable ? CURL_HTTP_VERSION_2TLS : CURL_HTTP_VERSION_NONE);
+#endif
+}
+
+void CurlMulti::submit(CURL *easy, Callback cb) {
+	pthread_mutex_lock(&_mutex);
+	_pending.push_back(std::make_pair(easy, cb));
+	pthread_mutex_unlock(&_mutex);
+	wakeup();
+}
+
+namespace {
+	struct Completion {
+		pthread_mutex_t mutex;
+		pthread_cond_t cond;
+		bool done;
+		CURLcode result;
+	};
+}
+
+CURLcode CurlMulti::perform(CURL *easy) {
+	Completion c;
+	pthread_mutex_init(&c.mutex, NULL);
+	pthread_cond_init(&c.cond, NULL);
+	c.done = false;
+	c.result = CURLE_OK;
+
+	submit(easy, [&c](CURL *, CURLcode result) {
+		pthread_mutex_lock(&c.mutex);
+		c.result = result;
+		c.done = true;
+		pthread_cond_signal(&c.cond);
+		pthread_mutex_unlock(&c.mutex);
+	});
+
+	pthread_mutex_lock(&c.mutex);
+	while (!c.done) {
+		pthread_cond_wait(&c.cond, &c.mutex);
+	}
+	pthread_mutex_unlock(&c.mutex);
+
+	pthread_cond_destroy(&c.cond);
+	pthread_mutex_destroy(&c.mutex);
+	return c.result;
+}
+
+size_t CurlMulti::active() {
+	pthread_mutex_lock(&_mutex);
+	size_t n = _pending.size() + _transfers.size();
+	pthread_mutex_unlock(&_mutex);
+	return n;
+}
+
+void CurlMulti::wakeup() {
+	char c = 0;
+	if (write(_wakeup[1], &c, 1) < 0 && errno != EAGAIN) {
+		print(log_error, "Cannot wake up transport thread: %s", "curl", strerror(errno));
+	}
+}
+
+/**
+ * Remove a finished transfer and call its callback
+ */
+void CurlMulti::finish(CURL *easy, CURLcode result) {
+	curl_multi_remove_handle(_multi, easy);
+
+	pthread_mutex_lock(&_mutex);
+	std::map<CURL *, Callback>::iterator it = _transfers.find(easy);
+	Callback cb = it->second;
+	_transfers.erase(it);
+	pthread_mutex_unlock(&_mutex);
+
+	cb(easy, result);
+}
+
+void *CurlMulti::loop(void *arg) {
+	static_cast<CurlMulti *>(arg)->run();
+	return NULL;
+}
+
+void CurlMulti::run() {
+	for (;;) {
+		// take over new transfers
+		pthread_mutex_lock(&_mutex);
+		if (!_running) {
+			pthread_mutex_unlock(&_mutex);
+			break;
+		}
+		std::deque<std::pair<CURL *, Callback> > pending;
+		pending.swap(_pending);
+		pthread_mutex_unlock(&_mutex);
+
+		for (std::deque<std::pair<CURL *, Callback> >::iterator it = pending.begin(); it != pending.end(); it++) {
+			CURLMcode mc = curl_multi_add_handle(_multi, it->first);
+			if (mc != CURLM_OK) {
+				print(log_error, "CURL: %s", "curl", curl_multi_strerror(mc));
+				it->second(it->first, CURLE_FAILED_INIT);
+				continue;
+			}
+			pthread_mutex_lock(&_mutex);
+			_transfers[it->first] = it->second;
+			pthread_mutex_unlock(&_mutex);
+		}
+
+		int still_running;
+		curl_multi_perform(_multi, &still_running);
+
+		CURLMsg *msg;
+		int queued;
+		while ((msg = curl_multi_info_read(_multi, &queued)) != NULL) {
+			if (msg->msg == CURLMSG_DONE) {
+				finish(msg->easy_handle, msg->data.result);
+			}
+		}
+
+		// sleep until there is network activity, a timeout or a new transfer
+		struct curl_waitfd wfd;
+		wfd.fd = _wakeup[0];
+		wfd.events = CURL_WAIT_POLLIN;
+		wfd.revents = 0;
+		curl_multi_wait(_multi, &wfd, 1, 1000, NULL);
+		if (wfd.revents) {
+			char buf[64];
+			while (read(_wakeup[0], buf, sizeof(buf)) > 0);
+		}
+	}
+
+	// abort everything still in flight
+	pthread_mutex_lock(&_mutex);
+	std::deque<std::pair<CURL *, Callback> > pending;
+	pending.swap(_pending);
+	std::map<CURL *, Callback> transfers;
+	transfers.swap(_transfers);
+	pthread_mutex_unlock(&_mutex);
+
+	for (std::map<CURL *, Callback>::iterator it = transfers.begin(); it != transfers.end(); it++) {
+		curl_multi_remove_handle(_multi, it->first);
+		it->second(it->first, CURLE_ABORTED_BY_CALLBACK);
+	}
+	for (std::deque<std::pair<CURL *, Callback> >::iterator it = pending.begin(); it != pending.end(); it++) {
+		it->second(it->first, CURLE_ABORTED_BY_CALLBACK);
+	}
+}
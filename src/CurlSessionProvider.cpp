@@ -1,5 +1,5 @@
 /**
- * CurlSessionProvider - provides one curl session (easy handle) for a key
+ * CurlSessionProvider - provides a pool of curl sessions (easy handles) per key
  *
  * @author Matthias Behr <mbehr@mcbehr.de>
  * @copyright Copyright (c) 2015, The volkszaehler.org project
@@ -8,90 +8,202 @@
  */
 
 #include <assert.h>
+#include <errno.h>
+#include <string.h>
 #include <time.h>
 #include "CurlSessionProvider.hpp"
+#include "CurlShare.hpp"
 
-CurlSessionProvider::CurlSessionProvider()
+static time_t monotonic_now()
 {
-    _map_mutex = PTHREAD_MUTEX_INITIALIZER;
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+static double elapsed(const timespec &start)
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+CurlSessionProvider::CurlPool::CurlPool()
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+CurlSessionProvider::CurlPool::~CurlPool()
+{
+    for (size_t i = 0; i < idle.size(); ++i)
+        curl_easy_cleanup(idle[i].first);
+}
+
+CurlSessionProvider::CurlSessionProvider(size_t max_per_key, int idle_timeout) :
+    _max_per_key(max_per_key), _idle_timeout(idle_timeout)
+{
+    pthread_mutex_init(&_map_mutex, NULL);
     curl_global_init(CURL_GLOBAL_ALL);
 }
 
 CurlSessionProvider::~CurlSessionProvider()
 {
-    // curl_easy_cleanup for each CURL*
-    timespec ts;
-    clock_gettime(CLOCK_REALTIME , &ts);
-    ts.tv_sec+=1;
-    pthread_mutex_timedlock(&_map_mutex, &ts); // try max 1s to acquire the lock. There might have been another thread pthread_cancelled while owning the lock.
-    for (map_it it = _easy_handle_map.begin(); it!=_easy_handle_map.end(); ++it)
-    {
-        CurlUsage cu = (*it).second;
-        curl_easy_cleanup(cu.eh);
-    }
+    // curl_easy_cleanup for each idle CURL*
+    pthread_mutex_lock(&_map_mutex);
+    for (map_it it = _pools.begin(); it!=_pools.end(); ++it)
+        delete (*it).second;
+    _pools.clear();
     curl_global_cleanup();
 
     pthread_mutex_unlock(&_map_mutex);
     pthread_mutex_destroy(&_map_mutex);
 }
 
+// call with _map_mutex locked
+bool CurlSessionProvider::exhausted(const CurlPool &pool) const
+{
+    return pool.idle.empty() && _max_per_key > 0 && pool.stats.in_use >= _max_per_key;
+}
+
+// call with _map_mutex locked
+void CurlSessionProvider::evict(CurlPool &pool, time_t now)
+{
+    while (!pool.idle.empty() && now - pool.idle.front().second >= _idle_timeout) {
+        curl_easy_cleanup(pool.idle.front().first);
+        pool.idle.pop_front();
+        pool.stats.evicted++;
+    }
+}
+
 // thread-safe functions:
-CURL *CurlSessionProvider::get_easy_session(std::string key, int timeout) // this is intended to block if the handle for the current key is in use and single_session_per_key
+CURL *CurlSessionProvider::get_easy_session(std::string key, int timeout) // this is intended to block if all handles for the current key are in use
 {
     CURL *toRet=0;
     // thread safe lock here to access the map:
-    assert( 0 == pthread_mutex_lock(&_map_mutex));
-    map_it it = _easy_handle_map.find(key);
-    if (it!= _easy_handle_map.end()){
-        CurlUsage &cur = (*it).second;
-        pthread_mutex_unlock(&_map_mutex); // we unlock here already but access the current element anyhow assuming an insert doesnt invalidate the reference
-		int err;
-		do {
-			timespec abs_time;
-			clock_gettime(CLOCK_REALTIME , &abs_time);
-			abs_time.tv_sec += 1;
-			pthread_testcancel(); // to check whether the thread shall end here!
-			err = pthread_mutex_timedlock(&cur.mutex, &abs_time);
-		} while ((err == EAGAIN) || (err == ETIMEDOUT));
-        assert(!cur.inUse);
-        cur.inUse = true;
-        toRet = cur.eh;
+    pthread_mutex_lock(&_map_mutex);
+    CurlPool *&pp = _pools[key];
+    if (!pp) pp = new CurlPool();
+    CurlPool &pool = *pp;
+
+    // wait in line if there are others waiting already or no handle is left
+    if (!pool.waiters.empty() || exhausted(pool)) {
+        pthread_cond_t cond;
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&cond, &attr);
+        pthread_condattr_destroy(&attr);
+
+        timespec start, abs_time;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        abs_time = start;
+        abs_time.tv_sec += timeout;
+
+        pool.waiters.push_back(&cond);
+        int err = 0;
+        while ((pool.waiters.front() != &cond || exhausted(pool)) &&
+               err != ETIMEDOUT) {
+            err = timeout > 0 ? pthread_cond_timedwait(&cond, &_map_mutex, &abs_time) :
+                pthread_cond_wait(&cond, &_map_mutex);
+        }
+        for (std::deque<pthread_cond_t *>::iterator it = pool.waiters.begin(); it != pool.waiters.end(); ++it) {
+            if (*it == &cond) {
+                pool.waiters.erase(it);
+                break;
+            }
+        }
+        pthread_cond_destroy(&cond);
+
+        double waited = elapsed(start);
+        pool.stats.waits++;
+        pool.stats.wait_total += waited;
+        if (waited > pool.stats.wait_max) pool.stats.wait_max = waited;
+
+        if (err == ETIMEDOUT && exhausted(pool)) {
+            // the next one in line may be able to proceed anyhow
+            if (!pool.waiters.empty()) pthread_cond_signal(pool.waiters.front());
+            pthread_mutex_unlock(&_map_mutex);
+            return 0;
+        }
+    }
+
+    evict(pool, monotonic_now());
+    if (!pool.idle.empty()) {
+        // reuse the most recently used handle, its connection is most likely still alive
+        toRet = pool.idle.back().first;
+        pool.idle.pop_back();
     } else {
         // create new one:
-        CurlUsage cu;
-        cu.eh = curl_easy_init();
-        cu.inUse=true;
-        pthread_mutex_lock(&cu.mutex);
-        _easy_handle_map.insert(std::make_pair(key, cu));
-        toRet = cu.eh;
-		pthread_mutex_unlock(&_map_mutex);
+        toRet = curl_easy_init();
+        if (toRet) {
+            if (curlShare) curlShare->apply(toRet); // share DNS, TLS sessions and connections
+            pool.stats.created++;
+        }
     }
+    if (toRet) pool.stats.in_use++;
+
+    // there might be more handles available for the next one in line
+    if (!pool.waiters.empty()) pthread_cond_signal(pool.waiters.front());
+    pthread_mutex_unlock(&_map_mutex);
 
     return toRet;
 }
 
-void CurlSessionProvider::return_session(std::string key, CURL *&eh) // return a handle. this unblocks another pending request for this key if single_session_per_key
+void CurlSessionProvider::return_session(std::string key, CURL *&eh) // return a handle. this unblocks the oldest pending request for this key
 {
     // thread safe lock here:
-    assert( 0 == pthread_mutex_lock(&_map_mutex));
-    CurlUsage &cu = _easy_handle_map[key];
-    assert(eh == cu.eh);
+    pthread_mutex_lock(&_map_mutex);
+    map_it it = _pools.find(key);
+    assert(it != _pools.end());
+    CurlPool &pool = *(*it).second;
+    assert(pool.stats.in_use > 0);
+
+    time_t now = monotonic_now();
+    pool.idle.push_back(std::make_pair(eh, now));
+    pool.stats.in_use--;
     eh=0;
-    cu.inUse = false;
-    pthread_mutex_unlock(&cu.mutex);
+    evict(pool, now);
+
+    if (!pool.waiters.empty()) pthread_cond_signal(pool.waiters.front());
     pthread_mutex_unlock(&_map_mutex);
 }
 
 bool CurlSessionProvider::inUse(std::string key)
 {
+    return stats(key).in_use > 0;
+}
+
+CurlSessionProvider::Stats CurlSessionProvider::stats(std::string key)
+{
+    Stats toRet;
+    memset(&toRet, 0, sizeof(toRet));
     pthread_mutex_lock(&_map_mutex);
-    cmap_it it = _easy_handle_map.find(key);
-    if (it != _easy_handle_map.end()){
-        pthread_mutex_unlock(&_map_mutex);
-        return (*it).second.inUse;
+    cmap_it it = _pools.find(key);
+    if (it != _pools.end()) {
+        toRet = (*it).second->stats;
+        toRet.idle = (*it).second->idle.size();
     }
     pthread_mutex_unlock(&_map_mutex);
-    return false;
+    return toRet;
+}
+
+CurlSessionProvider::Stats CurlSessionProvider::stats()
+{
+    Stats toRet;
+    memset(&toRet, 0, sizeof(toRet));
+    pthread_mutex_lock(&_map_mutex);
+    for (cmap_it it = _pools.begin(); it != _pools.end(); ++it) {
+        const Stats &s = (*it).second->stats;
+        toRet.created += s.created;
+        toRet.evicted += s.evicted;
+        toRet.in_use += s.in_use;
+        toRet.idle += (*it).second->idle.size();
+        toRet.waits += s.waits;
+        toRet.wait_total += s.wait_total;
+        if (s.wait_max > toRet.wait_max) toRet.wait_max = s.wait_max;
+    }
+    pthread_mutex_unlock(&_map_mutex);
+    return toRet;
 }
 
 // global var:
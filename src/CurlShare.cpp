@@ -0,0 +1,133 @@
+/**
+ * CurlShare - DNS, TLS session and connection cache shared by all curl handles
+ *
+ * @package vzlogger
+ * @copyright Copyright (c) 2011, The volkszaehler.org project
+ * @license http://www.gnu.org/licenses/gpl.txt GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <vector>
+
+#include "common.h"
+#include <VZException.hpp>
+#include "CurlShare.hpp"
+#include "CurlMulti.hpp"
+
+CurlShare *curlShare = 0;
+
+CurlShare::CurlShare() {
+	curl_global_init(CURL_GLOBAL_ALL);
+
+	_share = curl_share_init();
+	if (!_share) {
+		throw vz::VZException("CURL: cannot create share handle.");
+	}
+	for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+		pthread_mutex_init(&_mutex[i], NULL);
+	}
+
+	curl_share_setopt(_share, CURLSHOPT_LOCKFUNC, &CurlShare::lock);
+	curl_share_setopt(_share, CURLSHOPT_UNLOCKFUNC, &CurlShare::unlock);
+	curl_share_setopt(_share, CURLSHOPT_USERDATA, this);
+
+	curl_share_setopt(_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt(_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900 /* 7.57.0 */
+	curl_share_setopt(_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+}
+
+CurlShare::~CurlShare() {
+	if (curl_share_cleanup(_share) != CURLSHE_OK) {
+		print(log_warning, "CURL share still in use", "curl");
+	}
+	for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+		pthread_mutex_destroy(&_mutex[i]);
+	}
+	curl_global_cleanup();
+}
+
+void CurlShare::apply(CURL *easy) {
+	curl_easy_setopt(easy, CURLOPT_SHARE, _share);
+}
+
+void CurlShare::lock(CURL *, curl_lock_data data, curl_lock_access, void *userptr) {
+	pthread_mutex_lock(&static_cast<CurlShare *>(userptr)->_mutex[data]);
+}
+
+void CurlShare::unlock(CURL *, curl_lock_data data, void *userptr) {
+	pthread_mutex_unlock(&static_cast<CurlShare *>(userptr)->_mutex[data]);
+}
+
+static size_t discard_callback(void *, size_t size, size_t nmemb, void *) {
+	return size * nmemb;
+}
+
+static void prewarm_done(CURL *eh, CURLcode result) {
+	char *url = NULL;
+	curl_easy_getinfo(eh, CURLINFO_EFFECTIVE_URL, &url);
+	print(result == CURLE_OK ? log_debug : log_warning, "Prewarming connection to %s: %s", "curl",
+		  url ? url : "", curl_easy_strerror(result));
+}
+
+void CurlShare::prewarm(const std::list<std::string> &urls, long timeout) {
+	std::vector<CURL *> handles;
+	for (std::list<std::string>::const_iterator it = urls.begin(); it != urls.end(); it++) {
+		CURL *eh = curl_easy_init();
+		if (!eh) continue;
+		apply(eh);
+		// a HEAD request, connections opened with CURLOPT_CONNECT_ONLY wouldn't be reused
+		curl_easy_setopt(eh, CURLOPT_URL, it->c_str());
+		curl_easy_setopt(eh, CURLOPT_NOBODY, 1L);
+		curl_easy_setopt(eh, CURLOPT_TIMEOUT, timeout);
+		curl_easy_setopt(eh, CURLOPT_NOSIGNAL, 1L);
+		curl_easy_setopt(eh, CURLOPT_WRITEFUNCTION, discard_callback);
+		handles.push_back(eh);
+	}
+
+	if (curlMulti) {
+		// open all connections in parallel
+		pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+		pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+		size_t done = 0;
+		for (size_t i = 0; i < handles.size(); i++) {
+			curlMulti->submit(handles[i], [&](CURL *eh, CURLcode result) {
+				prewarm_done(eh, result);
+				pthread_mutex_lock(&mutex);
+				done++;
+				pthread_cond_signal(&cond);
+				pthread_mutex_unlock(&mutex);
+			});
+		}
+		pthread_mutex_lock(&mutex);
+		while (done < handles.size()) {
+			pthread_cond_wait(&cond, &mutex);
+		}
+		pthread_mutex_unlock(&mutex);
+	} else {
+		for (size_t i = 0; i < handles.size(); i++) {
+			prewarm_done(handles[i], curl_easy_perform(handles[i]));
+		}
+	}
+
+	// the connections stay in the shared cache
+	for (size_t i = 0; i < handles.size(); i++) {
+		curl_easy_cleanup(handles[i]);
+	}
+}
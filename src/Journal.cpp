@@ -0,0 +1,235 @@
+/**
+ * Readings of a channel shared by its sinks
+ *
+ * @package vzlogger
+ * @copyright Copyright (c) 2011, The volkszaehler.org project
+ * @license http://www.gnu.org/licenses/gpl.txt GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <list>
+
+#include "common.h"
+#include "Journal.hpp"
+
+Journal::Journal(int duplicates)
+		: _duplicates(duplicates)
+		, _last_timestamp(0)
+		, _haveLastReading(false)
+		, _base(0)
+		, _spoolFrom(0)
+{
+	pthread_mutex_init(&_mutex, NULL);
+}
+
+Journal::~Journal() {
+	pthread_mutex_destroy(&_mutex);
+}
+
+size_t Journal::attach() {
+	pthread_mutex_lock(&_mutex);
+	size_t sink;
+	for (sink = 0; sink < _attached.size() && _attached[sink]; sink++);
+	if (sink == _attached.size()) {
+		_attached.push_back(true);
+		_cursors.push_back(_base);
+	} else {
+		_attached[sink] = true;
+		_cursors[sink] = _base;
+	}
+	pthread_mutex_unlock(&_mutex);
+	return sink;
+}
+
+void Journal::detach(size_t sink) {
+	pthread_mutex_lock(&_mutex);
+	_attached[sink] = false;
+	release();
+	pthread_mutex_unlock(&_mutex);
+}
+
+size_t Journal::spool(Spool::Ptr spool) {
+	std::list<Reading> replayed;
+	spool->replay(replayed);
+
+	pthread_mutex_lock(&_mutex);
+	// readings stored before aren't in the spool
+	_spoolFrom = _base + _log.size();
+	_spool = spool;
+	for (std::list<Reading>::const_iterator it = replayed.begin(); it != replayed.end(); it++) {
+		_log.push_back(*it);
+		_last_timestamp = std::max(_last_timestamp, it->time_ms());
+	}
+	pthread_mutex_unlock(&_mutex);
+	return replayed.size();
+}
+
+size_t Journal::fetch(Buffer &buf) {
+	pthread_mutex_lock(&_mutex);
+	// take over all readings at once, so the meter thread isn't blocked while we process them
+	buf.take(_batch);
+	size_t n = 0;
+	for (size_t i = 0; i < _batch.size(); i++) {
+		if (accept(_batch[i])) {
+			store(_batch[i]);
+			n++;
+		}
+	}
+	pthread_mutex_unlock(&_mutex);
+	return n;
+}
+
+bool Journal::append(const Reading &rd) {
+	pthread_mutex_lock(&_mutex);
+	const bool ok = accept(rd);
+	if (ok) store(rd);
+	pthread_mutex_unlock(&_mutex);
+	return ok;
+}
+
+/**
+ * Call with _mutex locked
+ */
+bool Journal::accept(const Reading &rd) {
+	const int64_t timestamp = rd.time_ms();
+	// we can only add/consider a timestamp if the ms resolution is different than from previous one:
+	if (timestamp <= _last_timestamp) return false;
+
+	if (_duplicates > 0) {
+		// duplicates should be ignored, but sent at least each <duplicates> seconds
+		if (_haveLastReading && timestamp < _last_timestamp + _duplicates * 1000
+				&& rd.value() == _lastReadingSent.value()) {
+			return false;
+		}
+		_lastReadingSent = rd;
+		_haveLastReading = true;
+	}
+	_last_timestamp = timestamp;
+	return true;
+}
+
+/**
+ * Call with _mutex locked
+ */
+void Journal::store(const Reading &rd) {
+	_log.push_back(rd);
+	if (_spool) {
+		try {
+			// keep the journal in line with the spool if it had to drop the oldest readings
+			drop_front(_spool->append(rd));
+		} catch (std::exception &e) {
+			// the reading is still sent, it is only lost if we are stopped before
+			if (_unspooled.empty()) {
+				print(log_error, "Cannot spool readings: %s", "spool", e.what());
+			}
+			_unspooled.push_back(_base + _log.size() - 1);
+		}
+	}
+}
+
+size_t Journal::pending(size_t sink) {
+	pthread_mutex_lock(&_mutex);
+	const size_t n = _base + _log.size() - _cursors[sink];
+	pthread_mutex_unlock(&_mutex);
+	return n;
+}
+
+size_t Journal::size() {
+	pthread_mutex_lock(&_mutex);
+	const size_t n = _log.size();
+	pthread_mutex_unlock(&_mutex);
+	return n;
+}
+
+void Journal::copy(size_t sink, std::vector<Reading> &out) {
+	pthread_mutex_lock(&_mutex);
+	for (size_t i = _cursors[sink] - _base; i < _log.size(); i++) {
+		out.push_back(_log[i]);
+	}
+	pthread_mutex_unlock(&_mutex);
+}
+
+void Journal::ack(size_t sink, size_t n) {
+	pthread_mutex_lock(&_mutex);
+	_cursors[sink] = std::min<uint64_t>(_cursors[sink] + n, _base + _log.size());
+	release();
+	pthread_mutex_unlock(&_mutex);
+}
+
+Journal::Body Journal::serialize(size_t sink, const std::string &format, size_t max, const Serializer &fn,
+								 size_t &count) {
+	pthread_mutex_lock(&_mutex);
+	const uint64_t from = _cursors[sink];
+	const size_t n = std::min<size_t>(max, _base + _log.size() - from);
+	Body body;
+	count = 0;
+	if (n > 0) {
+		Cached &c = _cache[format];
+		if (c.body && c.from == from && c.max == n) {
+			body = c.body; // serialized by another sink already
+		} else {
+			// reuse the storage of the previous body unless a sink still holds it
+			if (!c.body || c.body.use_count() > 1) c.body = Body(new JsonWriter());
+			c.from = from;
+			c.max = n;
+			c.count = fn(_log, from - _base, from - _base + n, *c.body);
+			body = c.body;
+		}
+		count = c.count;
+	}
+	pthread_mutex_unlock(&_mutex);
+	return body;
+}
+
+/**
+ * Call with _mutex locked
+ */
+void Journal::release() {
+	// without sinks the readings are kept for the next one
+	if (std::find(_attached.begin(), _attached.end(), true) == _attached.end()) return;
+
+	uint64_t min = _base + _log.size();
+	for (size_t i = 0; i < _cursors.size(); i++) {
+		if (_attached[i]) min = std::min(min, _cursors[i]);
+	}
+	const size_t n = min - _base;
+	if (_spool && min > _spoolFrom) {
+		// readings which aren't in the spool aren't acknowledged there
+		size_t unspooled = 0;
+		while (!_unspooled.empty() && _unspooled.front() < min) {
+			if (_unspooled.front() >= std::max(_base, _spoolFrom)) unspooled++;
+			_unspooled.pop_front();
+		}
+		_spool->ack(min - std::max(_base, _spoolFrom) - unspooled);
+	}
+	for (size_t i = 0; i < n; i++) _log.pop_front();
+	_base = min;
+}
+
+/**
+ * Drop the n oldest readings for all sinks. Call with _mutex locked
+ */
+void Journal::drop_front(size_t n) {
+	n = std::min(n, _log.size());
+	for (size_t i = 0; i < n; i++) _log.pop_front();
+	_base += n;
+	for (size_t i = 0; i < _cursors.size(); i++) {
+		_cursors[i] = std::max(_cursors[i], _base);
+	}
+}
@@ -0,0 +1,151 @@
+/**
+ * Streaming JSON writer
+ *
+ * @package vzlogger
+ * @copyright Copyright (c) 2011, The volkszaehler.org project
+ * @license http://www.gnu.org/licenses/gpl.txt GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "JsonWriter.hpp"
+
+void JsonWriter::separator() {
+	if (_after_key) {
+		_after_key = false;
+		return;
+	}
+	if (!_first[_depth]) _buf += ',';
+	_first[_depth] = false;
+}
+
+void JsonWriter::begin_array() {
+	separator();
+	_buf += '[';
+	if (_depth < MAX_DEPTH - 1) _depth++;
+	_first[_depth] = true;
+}
+
+void JsonWriter::end_array() {
+	_buf += ']';
+	if (_depth > 0) _depth--;
+}
+
+void JsonWriter::begin_object() {
+	separator();
+	_buf += '{';
+	if (_depth < MAX_DEPTH - 1) _depth++;
+	_first[_depth] = true;
+}
+
+void JsonWriter::end_object() {
+	_buf += '}';
+	if (_depth > 0) _depth--;
+}
+
+void JsonWriter::key(const char *name) {
+	string(name);
+	_buf += ':';
+	_after_key = true;
+}
+
+void JsonWriter::integer(int64_t v) {
+	char tmp[24];
+	separator();
+	_buf.append(tmp, format_integer(tmp, v));
+}
+
+void JsonWriter::number(double v) {
+	char tmp[32];
+	separator();
+	_buf.append(tmp, format_number(tmp, v));
+}
+
+void JsonWriter::string(const char *s) {
+	static const char hex[] = "0123456789abcdef";
+	separator();
+	_buf += '"';
+	for (; *s; s++) {
+		const unsigned char c = *s;
+		if (c == '"' || c == '\\') {
+			_buf += '\\';
+			_buf += c;
+		} else if (c < 0x20) {
+			_buf += "\\u00";
+			_buf += hex[c >> 4];
+			_buf += hex[c & 0xf];
+		} else {
+			_buf += c;
+		}
+	}
+	_buf += '"';
+}
+
+void JsonWriter::raw(const char *json, size_t len) {
+	separator();
+	_buf.append(json, len);
+}
+
+void JsonWriter::tuple(int64_t ts, double value) {
+	char tmp[64];
+	separator();
+	size_t n = 0;
+	tmp[n++] = '[';
+	n += format_integer(tmp + n, ts);
+	tmp[n++] = ',';
+	n += format_number(tmp + n, value);
+	tmp[n++] = ']';
+	_buf.append(tmp, n);
+}
+
+size_t JsonWriter::format_integer(char *out, int64_t v) {
+	char tmp[24];
+	char *p = tmp + sizeof(tmp);
+	// negate as unsigned, so INT64_MIN doesn't overflow
+	uint64_t u = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+	do {
+		*--p = '0' + (u % 10);
+		u /= 10;
+	} while (u);
+	if (v < 0) *--p = '-';
+
+	const size_t n = tmp + sizeof(tmp) - p;
+	for (size_t i = 0; i < n; i++) out[i] = p[i];
+	return n;
+}
+
+size_t JsonWriter::format_number(char *out, double v) {
+	if (!isfinite(v)) {
+		out[0] = 'n'; out[1] = 'u'; out[2] = 'l'; out[3] = 'l';
+		return 4;
+	}
+	// integral values (e.g. counters) don't need the float formatting
+	if (v == floor(v) && fabs(v) < 1e15) {
+		return format_integer(out, (int64_t)v);
+	}
+	// 17 significant digits always round trip, but fewer mostly suffice
+	int n = 0;
+	for (int precision = 15; precision <= 17; precision++) {
+		n = snprintf(out, 32, "%.*g", precision, v);
+		if (strtod(out, NULL) == v) break;
+	}
+	return n;
+}
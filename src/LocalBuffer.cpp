@@ -0,0 +1,135 @@
+/**
+ * Readings of a channel kept for the local interface
+ *
+ * @package vzlogger
+ * @copyright Copyright (c) 2011, The volkszaehler.org project
+ * @license http://www.gnu.org/licenses/gpl.txt GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <algorithm>
+
+#include "LocalBuffer.hpp"
+
+LocalBuffer::LocalBuffer(size_t capacity, size_t max)
+		: _data(capacity), _max(max), _streamed(0)
+{
+	pthread_mutex_init(&_mutex, NULL);
+}
+
+LocalBuffer::~LocalBuffer() {
+	pthread_mutex_destroy(&_mutex);
+}
+
+void LocalBuffer::push(int64_t t, double v) {
+	if (!_data.empty() && t <= _data.back()._t) return;
+	if (_max && _data.size() >= _max) _data.pop_front();
+	_data.push_back(ChannelData(t, v));
+}
+
+size_t LocalBuffer::after(int64_t t) const {
+	size_t lo = 0, hi = _data.size();
+	while (lo < hi) {
+		const size_t mid = lo + (hi - lo) / 2;
+		if (_data[mid]._t <= t) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo;
+}
+
+void LocalBuffer::expire(int64_t t) {
+	_data.pop_front(after(t - 1));
+}
+
+void LocalBuffer::select(const TupleQuery &query, std::vector<size_t> &selected) const {
+	selected.clear();
+
+	// the requested range, without scanning
+	size_t first = after(query._from - 1);
+	const size_t last = std::max(first, after(query._to));
+	if (query._limit && last - first > query._limit) {
+		first = last - query._limit;
+	}
+	if (first == last) return;
+
+	if (query._points == 0 || last - first <= query._points) {
+		for (size_t i = first; i < last; i++) {
+			selected.push_back(i);
+		}
+	}
+	else if (query._points == 1) {
+		selected.push_back(last - 1);
+	}
+	else if (query._points == 2) {
+		selected.push_back(first);
+		selected.push_back(last - 1);
+	}
+	else {
+		lttb(first, last, query._points, selected);
+	}
+}
+
+/**
+ * Select points of the readings _data[first..last) with Largest-Triangle-Three-Buckets:
+ * the first and last reading are kept, from each bucket in between the reading forming
+ * the largest triangle with the previously selected one and the average of the next bucket.
+ * Keeps peaks and the shape of the curve.
+ */
+void LocalBuffer::lttb(size_t first, size_t last, size_t points, std::vector<size_t> &selected) const {
+	const RING_ChannelData &l = _data;
+	const size_t n = last - first;
+	const double every = (double)(n - 2) / (points - 2);
+	const int64_t t0 = l[first]._t; // keeps the doubles precise
+
+	size_t a = first;
+	selected.push_back(a);
+
+	for (size_t i = 0; i < points - 2; i++) {
+		// average of the next bucket, the last reading for the last one
+		const size_t avg_start = first + (size_t)((i + 1) * every) + 1;
+		const size_t avg_end = std::min(first + (size_t)((i + 2) * every) + 1, last);
+		double avg_t = 0, avg_v = 0;
+		for (size_t j = avg_start; j < avg_end; j++) {
+			avg_t += l[j]._t - t0;
+			avg_v += l[j]._v;
+		}
+		avg_t /= (avg_end - avg_start);
+		avg_v /= (avg_end - avg_start);
+
+		// reading of this bucket with the largest triangle
+		const size_t start = first + (size_t)(i * every) + 1;
+		const size_t end = first + (size_t)((i + 1) * every) + 1;
+		const double a_t = l[a]._t - t0;
+		const double a_v = l[a]._v;
+		double max_area = -1;
+		size_t next = start;
+		for (size_t j = start; j < end; j++) {
+			const double area = fabs((a_t - avg_t) * (l[j]._v - a_v) - (a_t - (l[j]._t - t0)) * (avg_v - a_v));
+			if (area > max_area) {
+				max_area = area;
+				next = j;
+			}
+		}
+
+		a = next;
+		selected.push_back(a);
+	}
+
+	selected.push_back(last - 1);
+}
@@ -37,9 +37,6 @@
 
 #include <MeterMap.hpp>
 #include <Config_Options.hpp>
-#include <api/Volkszaehler.hpp>
-#include <api/MySmartGrid.hpp>
-#include <api/Null.hpp>
 #include "threads.h"
 
 extern Config_Options options;	/* global application options */
@@ -71,9 +68,9 @@ void MeterMap::start() {
 
 			if (options.logging()) {
 				(*it)->start();
-				print(log_debug, "Logging thread started", (*it)->name());
+				print(log_debug, "Logging started", (*it)->name());
 			} else
-				print(log_debug, "Logging thread not started", (*it)->name());
+				print(log_debug, "Logging not started", (*it)->name());
 		}
 		_thread_running = true;
 	} else {
@@ -120,22 +117,10 @@ void MeterMap::registration() {
 		return;
 	}
 	for (iterator ch = _channels.begin(); ch != _channels.end(); ch++) {
-		// create configured api interfaces
-		// NOTE: if additional APIs are introduced both threads.cpp and MeterMap.cpp need to be updated
-		vz::ApiIF::Ptr api;
-		if ((*ch)->apiProtocol() == "mysmartgrid") {
-			api =  vz::ApiIF::Ptr(new vz::api::MySmartGrid(*ch, (*ch)->options()));
-			print(log_debug, "Using MySmartGrid api.", (*ch)->name());
+		for (size_t i = 0; i < (*ch)->sinks(); i++) {
+			vz::ApiIF::Ptr api = create_api(*ch, i);
+			api->register_device();
 		}
-		else if ((*ch)->apiProtocol() == "null") {
-			api =  vz::ApiIF::Ptr(new vz::api::Null(*ch, (*ch)->options()));
-			print(log_debug, "Using null api- meter data available via local httpd if enabled.", (*ch)->name());
-		} else {
-			api =  vz::ApiIF::Ptr(new vz::api::Volkszaehler(*ch, (*ch)->options()));
-			print(log_debug, "Using default volkszaehler api.", (*ch)->name());
-		}
-
-		api->register_device();
 	}
 	printf("..done\n");
 }
@@ -268,6 +268,10 @@ bool Obis::operator==(const Obis &rhs) const {
 	return 1; // equal
 }
 
+bool Obis::operator<(const Obis &rhs) const {
+	return memcmp(_obisId._raw, rhs._obisId._raw, sizeof(_obisId._raw)) < 0;
+}
+
 bool Obis::isAllNotGiven() const {
 	return *this == Obis(); // compare this one with empty one from default constructor
 }
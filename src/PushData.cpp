@@ -3,13 +3,17 @@
  * */
 
 #include <assert.h>
+#include <string.h>
 #include <time.h>
+#include <algorithm>
 #include "vzlogger.h"
 #include "PushData.hpp"
 #include "CurlSessionProvider.hpp"
+#include "CurlMulti.hpp"
+#include "CurlShare.hpp"
 
 PushDataServer::PushDataServer(struct json_object *option) :
-    _headers(0)
+    _headers(0), _gzipHeaders(0), _deflateHeaders(0)
 {
     if (option) {
         // todo parse param option (is a json_type_array with len>0
@@ -23,8 +27,38 @@ PushDataServer::PushDataServer(struct json_object *option) :
             struct json_object *jv;
 			if (!json_object_object_get_ex(jso, "url", &jv)) throw vz::VZException("config: push url not found");
 			if (json_object_get_type(jv) != json_type_string) throw vz::VZException("config: push url no string");
-            std::string url = json_object_get_string(jv);
-            _middlewareList.push_back(url);
+            Middleware middleware;
+            middleware.url = json_object_get_string(jv);
+            middleware.timeout = 30;
+            middleware.queue_max = 10;
+            middleware.curl = 0;
+            middleware.busy = false;
+            middleware.response.data = 0;
+            middleware.response.size = 0;
+			if (json_object_object_get_ex(jso, "timeout", &jv)) {
+				if (json_object_get_type(jv) != json_type_int || json_object_get_int(jv) <= 0)
+					throw vz::VZException("config: push timeout no positive int");
+				middleware.timeout = json_object_get_int(jv);
+			}
+			if (json_object_object_get_ex(jso, "queue", &jv)) {
+				if (json_object_get_type(jv) != json_type_int || json_object_get_int(jv) < 0)
+					throw vz::VZException("config: push queue no positive int");
+				middleware.queue_max = json_object_get_int(jv);
+			}
+            // optional body compression, the push server has to accept the encoding
+			if (json_object_object_get_ex(jso, "encoding", &jv)) {
+				if (json_object_get_type(jv) != json_type_string) throw vz::VZException("config: push encoding no string");
+				ContentEncoder::Encoding encoding = ContentEncoder::parse(json_object_get_string(jv));
+				size_t min_size = 1024;
+				if (json_object_object_get_ex(jso, "encodingmin", &jv)) {
+					if (json_object_get_type(jv) != json_type_int || json_object_get_int(jv) < 0)
+						throw vz::VZException("config: push encodingmin no positive int");
+					min_size = json_object_get_int(jv);
+				}
+				if (encoding != ContentEncoder::NONE)
+					middleware.encoder = ContentEncoder::Ptr(new ContentEncoder(encoding, min_size));
+			}
+            _middlewareList.push_back(middleware);
         }
 
     } // else for now assume this as the unit testing case and accept it
@@ -37,12 +71,52 @@ PushDataServer::PushDataServer(struct json_object *option) :
 	_headers = curl_slist_append(_headers, "Content-type: application/json");
 	_headers = curl_slist_append(_headers, "Accept: application/json");
 	_headers = curl_slist_append(_headers, agent);
+	for (struct curl_slist *h = _headers; h; h = h->next) {
+		_gzipHeaders = curl_slist_append(_gzipHeaders, h->data);
+		_deflateHeaders = curl_slist_append(_deflateHeaders, h->data);
+	}
+	_gzipHeaders = curl_slist_append(_gzipHeaders, "Content-Encoding: gzip");
+	_deflateHeaders = curl_slist_append(_deflateHeaders, "Content-Encoding: deflate");
+
+	pthread_mutex_init(&_mutex, NULL);
+	pthread_cond_init(&_cond, NULL);
 }
 
 PushDataServer::~PushDataServer()
 {
+	release();
+	pthread_cond_destroy(&_cond);
+	pthread_mutex_destroy(&_mutex);
+
 	if (_headers)
 		curl_slist_free_all(_headers);
+	curl_slist_free_all(_gzipHeaders);
+	curl_slist_free_all(_deflateHeaders);
+}
+
+void PushDataServer::release()
+{
+	// requests in flight reference the targets. The transport aborts them if it is stopped.
+	pthread_mutex_lock(&_mutex);
+	for (auto it = _middlewareList.begin(); it != _middlewareList.end() && curlMulti; ) {
+		if (it->busy) {
+			pthread_cond_wait(&_cond, &_mutex);
+			it = _middlewareList.begin();
+		} else {
+			++it;
+		}
+	}
+
+	// the handles are attached to curlShare, they have to go first
+	for (auto it = _middlewareList.begin(); it != _middlewareList.end(); ++it) {
+		if (it->curl)
+			curl_easy_cleanup(it->curl);
+		it->curl = 0;
+		free(it->response.data);
+		it->response.data = NULL;
+		it->response.size = 0;
+	}
+	pthread_mutex_unlock(&_mutex);
 }
 
 bool PushDataServer::waitAndSendOnceToAll()
@@ -51,69 +125,141 @@ bool PushDataServer::waitAndSendOnceToAll()
 		print(log_error, "waitAndSendOnceToAll empty pushDataList!", "push");
         return false;
     }
-    PushDataList::DataMap *dataMap = pushDataList->waitForData();
-    if (!dataMap) {
-		print(log_finest, "waitAndSendOnceToAll empty dataMap (timeout?)", "push"); // this is no error as it happens each 5s on timeout
+    const PushDataList::Data *data = pushDataList->waitForData();
+    if (!data) {
+		print(log_finest, "waitAndSendOnceToAll no data (timeout?)", "push"); // this is no error as it happens each 5s on timeout
         return false;
     }
 
-    std::string json=generateJson(*dataMap);
+    const std::string &json=generateJson(*data);
 
     // now send this data to all defined push middlewares:
 	print(log_debug, "push: %s", "push", json.c_str());
 
     bool toRet=true;
-    // iterate through list of push middlewares:
-    for (auto it = _middlewareList.begin(); it != _middlewareList.end(); ++it)
-    {
-        // use CurlSessionProvider to serialize access to middleware:
-        if (!send(*it, json))
-            toRet = false;
+    if (curlMulti) {
+        // send to all targets in parallel, the results are logged when they arrive
+        pthread_mutex_lock(&_mutex);
+        for (auto it = _middlewareList.begin(); it != _middlewareList.end(); ++it)
+            enqueue(*it, json);
+        pthread_mutex_unlock(&_mutex);
+    } else {
+        // iterate through list of push middlewares:
+        for (auto it = _middlewareList.begin(); it != _middlewareList.end(); ++it)
+        {
+            // use CurlSessionProvider to serialize access to middleware:
+            if (!send(*it, json))
+                toRet = false;
+        }
     }
 
-    delete dataMap;
     return toRet;
 }
 
-std::string PushDataServer::generateJson(PushDataList::DataMap &dataMap)
+// call with _mutex locked
+void PushDataServer::enqueue(Middleware &target, const std::string &datastr)
+{
+    if (target.busy) {
+        if (target.queue.size() >= target.queue_max) {
+            if (target.queue.empty()) {
+                print(log_warning, "push to %s still running, dropping data", "push", target.url.c_str());
+                return;
+            }
+            print(log_warning, "push to %s stalled, dropping oldest queued data", "push", target.url.c_str());
+            target.queue.pop_front();
+        }
+        target.queue.push_back(datastr);
+        return;
+    }
+    target.body = datastr;
+    start(target);
+}
+
+// call with _mutex locked
+void PushDataServer::start(Middleware &target)
+{
+    if (!target.curl) {
+        target.curl = curl_easy_init();
+        if (curlShare)
+            curlShare->apply(target.curl);
+    }
+    target.busy = true;
+    target.response.size = 0;
+    prepare(target.curl, target, target.body, &target.response);
+    Middleware *t = &target; // list elements keep their address
+    curlMulti->submit(target.curl, [this, t](CURL *, CURLcode curl_code) { done(*t, curl_code); });
+}
+
+void PushDataServer::done(Middleware &target, CURLcode curl_code)
+{
+    long int http_code = 0;
+    curl_easy_getinfo(target.curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+    pthread_mutex_lock(&_mutex);
+    result(target, curl_code, http_code, target.response);
+    target.busy = false;
+    // continue with the queued data, unless the transport is stopping
+    if (curl_code != CURLE_ABORTED_BY_CALLBACK && !target.queue.empty()) {
+        target.body.swap(target.queue.front());
+        target.queue.pop_front();
+        start(target);
+    }
+    pthread_cond_broadcast(&_cond);
+    pthread_mutex_unlock(&_mutex);
+}
+
+const std::string &PushDataServer::generateJson(const PushDataList::Data &data)
 {
-    std::string toRet;
-    struct json_object *jso = json_object_new_object();
-    struct json_object *jsa = json_object_new_array(); // jsa will be the "data" object
+    // group the tuples by channel, keeping their order (counting sort)
+    size_t ids = 0;
+    for (auto it = data.begin(); it != data.end(); ++it)
+        if (it->id >= ids) ids = it->id + 1;
+    _start.assign(ids + 1, 0);
+    for (auto it = data.begin(); it != data.end(); ++it)
+        _start[it->id + 1]++;
+    for (size_t i = 1; i <= ids; ++i)
+        _start[i] += _start[i - 1];
+    _order.resize(data.size());
+    size_t n = 0;
+    for (auto it = data.begin(); it != data.end(); ++it, ++n)
+        _order[_start[it->id]++] = n;
+    // _start[id] now is the end of id, the begin is the end of id-1
+
+    _json.clear();
+    _json.begin_object();
+    _json.key("data");
+    _json.begin_array();
 
     // now add a tuple (uuid, values) for each uuid:
-    for (auto it = dataMap.begin(); it!=dataMap.end(); ++it) {
-        struct json_object *jsu = json_object_new_object();
-        json_object_object_add(jsu, "uuid", json_object_new_string((*it).first.c_str()));
-
-        struct json_object *jst = json_object_new_array();
-        // now add the DataTuples to the jst:
-        while (!(*it).second.empty()) {
-            const PushDataList::DataTuple &t = (*it).second.front();
-            struct json_object *jsv = json_object_new_array();
-            json_object_array_add(jsv, json_object_new_int64(t.first));
-            json_object_array_add(jsv, json_object_new_double(t.second));
-
-            json_object_array_add(jst, jsv);
-            (*it).second.pop();
+    size_t begin = 0;
+    for (size_t id = 0; id < ids; ++id) {
+        size_t end = _start[id];
+        if (begin == end) continue; // no data for this channel
+        _json.begin_object();
+        _json.key("uuid");
+        _json.string(pushDataList ? pushDataList->uuid(id).c_str() : "");
+
+        _json.key("tuples");
+        _json.begin_array();
+        for (size_t i = begin; i < end; ++i) {
+            const PushDataList::DataTuple &t = data[_order[i]];
+            _json.tuple(t.time_ms, t.value);
         }
+        _json.end_array();
 
-        json_object_object_add(jsu, "tuples", jst);
-
-        json_object_array_add(jsa, jsu);
+        _json.end_object();
+        begin = end;
     }
 
-    json_object_object_add(jso, "data", jsa);
-    const char *json_str = json_object_to_json_string(jso);
-    toRet = json_str;
-    json_object_put(jso);
+    _json.end_array();
+    _json.end_object();
 
-    return toRet;
+    return _json.str();
 }
 
-bool PushDataServer::send(const std::string &middleware, const std::string &datastr)
+bool PushDataServer::send(const Middleware &target, const std::string &datastr)
 {
-    bool toRet=true;
+    const std::string &middleware = target.url;
     CURL *curl = curlSessionProvider ? curlSessionProvider->get_easy_session(middleware) : 0;
     if (!curl) {
 		print(log_error, "send no curl session!", "push");
@@ -122,29 +268,55 @@ bool PushDataServer::send(const std::string &middleware, const std::string &data
 
     CURLresponse response;
     response.data = 0;
+    response.size = 0;
     CURLcode curl_code;
-    long int http_code;
+    long int http_code = 0;
+
+    prepare(curl, target, datastr, &response);
+
+	curl_code = curlMulti ? curlMulti->perform(curl) : curl_easy_perform(curl);
+	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+    if (curlSessionProvider)
+        curlSessionProvider->return_session(middleware, curl);
+
+    bool toRet = result(target, curl_code, http_code, response);
+	if (response.data)
+		free(response.data);
+	return toRet;
+}
 
-    curl_easy_setopt(curl, CURLOPT_URL, middleware.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, _headers);
+void PushDataServer::prepare(CURL *curl, const Middleware &target, const std::string &datastr, CURLresponse *response)
+{
+    curl_easy_setopt(curl, CURLOPT_URL, target.url.c_str());
     //curl_easy_setopt(curl, CURLOPT_VERBOSE, options.verbosity());
     curl_easy_setopt(curl, CURLOPT_DEBUGFUNCTION, 0);
     curl_easy_setopt(curl, CURLOPT_DEBUGDATA, 0);
     // signal-handling in libcurl is NOT thread-safe. so force to deactivated them!
     curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1);
 
-	// set timeout to 30 sec. required if e.g. next router has an ip-change.
-	curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30);
-
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, datastr.c_str());
+	// required if e.g. next router has an ip-change.
+	curl_easy_setopt(curl, CURLOPT_TIMEOUT, target.timeout);
+
+    if (target.encoder && target.encoder->encode(datastr.data(), datastr.size())) {
+        print(log_finest, "compressed %d to %d bytes", "push", datastr.size(), target.encoder->size());
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER,
+                         target.encoder->encoding() == ContentEncoder::GZIP ? _gzipHeaders : _deflateHeaders);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)target.encoder->size());
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, target.encoder->data());
+    } else {
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, _headers);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)datastr.size());
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, datastr.c_str());
+    }
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_custom_write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *) &response);
-
-	curl_code = curl_easy_perform(curl);
-	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *) response);
+}
 
-    if (curlSessionProvider)
-        curlSessionProvider->return_session(middleware, curl);
+bool PushDataServer::result(const Middleware &target, CURLcode curl_code, long http_code, const CURLresponse &response)
+{
+    const std::string &middleware = target.url;
+    bool toRet=true;
 
 	// check response
 	if (curl_code == CURLE_OK && http_code == 200) { // everything is ok
@@ -161,8 +333,6 @@ bool PushDataServer::send(const std::string &middleware, const std::string &data
 		}
 	}
 
-	if (response.data)
-		free(response.data);
 	if (toRet)
 		print(log_finest, "send ok to url %s", "push", middleware.c_str());
 	else
@@ -190,9 +360,16 @@ size_t PushDataServer::curl_custom_write_callback(void *ptr, size_t size, size_t
 }
 
 
-PushDataList::PushDataList() :
-    _next(0), _map_mutex(PTHREAD_MUTEX_INITIALIZER)
+PushDataList::PushDataList(size_t max_size, Policy policy) :
+    _write(0), _policy(policy), _dropped(0), _reported(0), _map_mutex(PTHREAD_MUTEX_INITIALIZER)
 {
+    _capacity = max_size / sizeof(DataTuple);
+    if (_capacity < 1) _capacity = 1;
+    for (int i = 0; i < 2; ++i) {
+        Data data(_capacity); // preallocated, never grows as add() keeps it within _capacity
+        _buf[i].data.swap(data);
+        _buf[i].popped = 0;
+    }
     pthread_cond_init(&_cond, NULL);
 }
 
@@ -200,30 +377,100 @@ PushDataList::~PushDataList()
 {
     pthread_mutex_lock(&_map_mutex); // todo. wrong thread might own the mutex? But might have been cancelled (thread_cancellation so will never unlock!)
 
-    if (_next) delete _next;
-
     // we keep it locked to prevent race conds at the end
     pthread_cond_destroy(&_cond);
     pthread_mutex_destroy(&_map_mutex);
 }
 
-void PushDataList::add(const std::string &uuid, const int64_t &time_ms, const double &value)
+PushDataList::Policy PushDataList::parse(const char *policy)
+{
+    if (strcmp(policy, "oldest") == 0) return DROP_OLDEST;
+    if (strcmp(policy, "newest") == 0) return DROP_NEWEST;
+    if (strcmp(policy, "coalesce") == 0) return COALESCE;
+    throw vz::VZException("config: unknown push buffer policy");
+}
+
+PushDataList::Id PushDataList::id(const std::string &uuid)
+{
+    pthread_mutex_lock(&_map_mutex);
+    auto it = _idMap.find(uuid);
+    Id id;
+    if (it != _idMap.end()) {
+        id = it->second;
+    } else {
+        id = _uuids.size();
+        _uuids.push_back(uuid);
+        _idMap[uuid] = id;
+    }
+    pthread_mutex_unlock(&_map_mutex);
+    return id;
+}
+
+const std::string &PushDataList::uuid(Id id)
 {
-    assert( 0 == pthread_mutex_lock(&_map_mutex));
+    pthread_mutex_lock(&_map_mutex);
+    const std::string &uuid = _uuids.at(id);
+    pthread_mutex_unlock(&_map_mutex);
+    return uuid;
+}
 
-    if (!_next)
-        _next = new DataMap;
+size_t PushDataList::ids()
+{
+    pthread_mutex_lock(&_map_mutex);
+    size_t n = _uuids.size();
+    pthread_mutex_unlock(&_map_mutex);
+    return n;
+}
 
-    _next->operator[](uuid).push(DataTuple(time_ms, value));
+void PushDataList::clear(Buffer &buf)
+{
+    buf.data.clear();
+    buf.popped = 0;
+    std::fill(buf.last.begin(), buf.last.end(), 0);
+}
+
+void PushDataList::add(Id id, const int64_t &time_ms, const double &value)
+{
+    pthread_mutex_lock(&_map_mutex);
+
+    Buffer &buf = _buf[_write];
+    DataTuple t;
+    t.id = id;
+    t.time_ms = time_ms;
+    t.value = value;
+
+    if (_policy == COALESCE) {
+        if (buf.last.size() <= id)
+            buf.last.resize(id + 1, 0);
+        size_t pos = buf.last[id];
+        if (pos > buf.popped) { // replace the value still waiting
+            buf.data[pos - 1 - buf.popped] = t;
+            pthread_mutex_unlock(&_map_mutex);
+            return;
+        }
+    }
+
+    if (buf.data.size() >= _capacity) {
+        _dropped++;
+        if (_policy == DROP_NEWEST) {
+            pthread_mutex_unlock(&_map_mutex);
+            return;
+        }
+        buf.data.pop_front(); // DROP_OLDEST or COALESCE with more channels than capacity
+        buf.popped++;
+    }
+    buf.data.push_back(t);
+    if (_policy == COALESCE)
+        buf.last[id] = buf.popped + buf.data.size();
 
     pthread_cond_broadcast(&_cond);
     pthread_mutex_unlock(&_map_mutex);
 }
 
-PushDataList::DataMap *PushDataList::waitForData()
+const PushDataList::Data *PushDataList::waitForData()
 {
-    DataMap *toRet = 0;
-    assert( 0 == pthread_mutex_lock(&_map_mutex));
+    const Data *toRet = 0;
+    pthread_mutex_lock(&_map_mutex);
 	int rc = 0;
 
 	// try max 5s. We need to avoid deadlocking e.g. on program end/termination.
@@ -231,13 +478,19 @@ PushDataList::DataMap *PushDataList::waitForData()
 	clock_gettime(CLOCK_REALTIME, &ts);
 	ts.tv_sec += 5;
 
-	while((!(_next && !_next->empty())) && rc == 0) {
+	while(_buf[_write].data.empty() && rc == 0) {
 		rc = pthread_cond_timedwait(&_cond, &_map_mutex, &ts);
 	}
 
 	if (rc == 0) {
-		toRet = _next;
-		_next = 0; // change ownership to caller. We will create new one on next add()
+		// the consumer is done with the other buffer, swap them
+		clear(_buf[1 - _write]);
+		toRet = &_buf[_write].data;
+		_write = 1 - _write;
+	}
+	if (_dropped != _reported) {
+		print(log_warning, "push buffer full, dropped %d readings", "push", _dropped - _reported);
+		_reported = _dropped;
 	}
     pthread_mutex_unlock(&_map_mutex);
 
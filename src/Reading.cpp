@@ -29,22 +29,25 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <typeinfo>
 
+#include "common.h"
 #include "VZException.hpp"
 #include "Reading.hpp"
 
 Reading::Reading()
-		: _deleted(false)
-		, _value(0)
+		: _value(0)
+		, _key(0)
+		, _deleted(false)
 {
 	_time.tv_sec = 0;
 	_time.tv_usec = 0;
 }
 
 Reading::Reading(ReadingIdentifier::Ptr pIndentifier)
-		: _deleted(false)
-		, _value(0)
-		, _identifier(pIndentifier)
+		: _value(0)
+		, _key(ReadingIdentifierRegistry::instance().intern(pIndentifier))
+		, _deleted(false)
 {
 	_time.tv_sec = 0;
 	_time.tv_usec = 0;
@@ -54,20 +57,20 @@ Reading::Reading(
 	, struct timeval pTime
 	, ReadingIdentifier::Ptr pIndentifier
 	)
-		: _deleted(false)
-		, _value(pValue)
+		: _value(pValue)
 		, _time(pTime)
-		, _identifier(pIndentifier)
+		, _key(ReadingIdentifierRegistry::instance().intern(pIndentifier))
+		, _deleted(false)
 {
 }
 
 Reading::Reading(
 	const Reading &orig
 	) :
-		_deleted(orig._deleted)
-		, _value(orig._value)
+		_value(orig._value)
 		, _time(orig._time)
-		, _identifier (orig._identifier)
+		, _key(orig._key)
+		, _deleted(orig._deleted)
 {
 }
 
@@ -136,7 +139,7 @@ size_t Reading::unparse(
 	char *buffer, size_t n
 	) {
 
-	return _identifier->unparse(buffer, n);
+	return identifier()->unparse(buffer, n);
 
 #if 0
 	switch (protocol) {
@@ -164,6 +167,68 @@ size_t Reading::unparse(
 #endif
 }
 
+/* ReadingIdentifierRegistry */
+ReadingIdentifierRegistry &ReadingIdentifierRegistry::instance() {
+	static ReadingIdentifierRegistry registry;
+	return registry;
+}
+
+ReadingIdentifierRegistry::ReadingIdentifierRegistry() : _full(false), _size(1) { // key 0: no identifier
+	pthread_mutex_init(&_mutex, NULL);
+	memset(_chunks, 0, sizeof(_chunks));
+	_chunks[0] = new ReadingIdentifier::Ptr[CHUNK];
+}
+
+ReadingIdentifierRegistry::~ReadingIdentifierRegistry() {
+	for (size_t i = 0; i < CHUNKS; i++) delete[] _chunks[i];
+	pthread_mutex_destroy(&_mutex);
+}
+
+uint32_t ReadingIdentifierRegistry::intern(ReadingIdentifier::Ptr rid) {
+	if (!rid) return 0;
+
+	// the concrete type is part of the key as e.g. an empty string and an empty obis unparse the same
+	char buffer[MAX_IDENTIFIER_LEN];
+	rid->unparse(buffer, MAX_IDENTIFIER_LEN);
+	std::string name(typeid(*rid).name());
+	name += ':';
+	name += buffer;
+
+	pthread_mutex_lock(&_mutex);
+	uint32_t key;
+	std::map<std::string, uint32_t>::const_iterator it = _keys.find(name);
+	if (it != _keys.end()) {
+		key = it->second;
+	} else {
+		key = _size.load(std::memory_order_relaxed);
+		if (key >= CHUNK * CHUNKS) {
+			// e.g. a meter reporting free-form identifiers. Its readings aren't assigned anymore
+			if (!_full) {
+				print(log_warning, "Too many reading identifiers, ignoring new ones like %s", "", buffer);
+				_full = true;
+			}
+			pthread_mutex_unlock(&_mutex);
+			return 0;
+		}
+		if (!_chunks[key / CHUNK]) _chunks[key / CHUNK] = new ReadingIdentifier::Ptr[CHUNK];
+		_chunks[key / CHUNK][key % CHUNK] = rid;
+		_keys[name] = key;
+		_size.store(key + 1, std::memory_order_release); // publish the entry to lookup()
+	}
+	pthread_mutex_unlock(&_mutex);
+
+	return key;
+}
+
+ReadingIdentifier::Ptr ReadingIdentifierRegistry::lookup(uint32_t key) const {
+	if (key >= _size.load(std::memory_order_acquire)) return ReadingIdentifier::Ptr();
+	return _chunks[key / CHUNK][key % CHUNK];
+}
+
+size_t ReadingIdentifierRegistry::size() const {
+	return _size.load(std::memory_order_acquire) - 1;
+}
+
 bool ReadingIdentifier::operator==( ReadingIdentifier const &cmp) const {
 	return this->compare(this, &cmp);
 }
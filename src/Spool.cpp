@@ -0,0 +1,285 @@
+/**
+ * Durable spool for readings not yet acknowledged by the middleware
+ *
+ * @package vzlogger
+ * @copyright Copyright (c) 2011, The volkszaehler.org project
+ * @license http://www.gnu.org/licenses/gpl.txt GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <vector>
+
+#include "common.h"
+#include <VZException.hpp>
+#include "Spool.hpp"
+
+#define SPOOL_MAGIC 0x50535a56 /* "VZSP" */
+#define SPOOL_VERSION 1
+
+Spool::Spool(const std::string &dir, const std::string &name, size_t maxsize, int sync,
+			 size_t segment_size)
+		: _path(dir + "/" + name)
+		, _maxsize(maxsize)
+		, _sync(sync)
+		, _segment_size(segment_size)
+		, _last_sync(time(NULL))
+		, _dirty(false)
+{
+	if (_segment_size < sizeof(Header) + sizeof(Record)) {
+		throw vz::VZException("Spool segment size too small.");
+	}
+	_capacity = (_segment_size - sizeof(Header)) / sizeof(Record);
+
+	if ((mkdir(dir.c_str(), 0755) < 0 && errno != EEXIST) ||
+		(mkdir(_path.c_str(), 0755) < 0 && errno != EEXIST)) {
+		print(log_error, "Cannot create spool directory %s: %s", "spool", _path.c_str(), strerror(errno));
+		throw vz::VZException("Cannot create spool directory.");
+	}
+
+	// find existing segments
+	DIR *d = opendir(_path.c_str());
+	if (!d) {
+		print(log_error, "Cannot open spool directory %s: %s", "spool", _path.c_str(), strerror(errno));
+		throw vz::VZException("Cannot open spool directory.");
+	}
+	std::vector<uint64_t> seqs;
+	struct dirent *de;
+	while ((de = readdir(d)) != NULL) {
+		unsigned long long seq;
+		char ext[8];
+		if (sscanf(de->d_name, "%16llx.%7s", &seq, ext) == 2 && strcmp(ext, "seg") == 0) {
+			seqs.push_back(seq);
+		}
+	}
+	closedir(d);
+	std::sort(seqs.begin(), seqs.end());
+
+	for (std::vector<uint64_t>::const_iterator it = seqs.begin(); it != seqs.end(); it++) {
+		try {
+			_segments.push_back(open_segment(*it, false));
+		} catch (vz::VZException &e) {
+			print(log_warning, "Ignoring broken spool segment %s", "spool", filename(*it).c_str());
+		}
+	}
+
+	// remove segments already acknowledged completely
+	while (_segments.size() > 1 &&
+		   closed(_segments.front()) &&
+		   _segments.front().header()->acked >= _segments.front().written) {
+		drop_front();
+	}
+
+	if (_segments.empty()) {
+		_segments.push_back(open_segment(1, true));
+	}
+
+	print(log_debug, "Opened spool %s with %d segments and %d pending readings", "spool",
+		  _path.c_str(), _segments.size(), pending());
+}
+
+Spool::~Spool() {
+	sync();
+	for (std::deque<Segment>::iterator it = _segments.begin(); it != _segments.end(); it++) {
+		munmap(it->map, _segment_size);
+	}
+}
+
+std::string Spool::filename(uint64_t seq) const {
+	char name[32];
+	snprintf(name, sizeof(name), "/%016llx.seg", (unsigned long long)seq);
+	return _path + name;
+}
+
+Spool::Segment Spool::open_segment(uint64_t seq, bool create) {
+	const std::string file = filename(seq);
+	int fd = open(file.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT | O_EXCL : 0), 0644);
+	if (fd < 0) {
+		print(log_error, "Cannot open spool segment %s: %s", "spool", file.c_str(), strerror(errno));
+		throw vz::VZException("Cannot open spool segment.");
+	}
+
+	struct stat st;
+	if (!create && (fstat(fd, &st) < 0 || (size_t)st.st_size != _segment_size)) {
+		close(fd);
+		throw vz::VZException("Spool segment has wrong size.");
+	}
+
+	// reserve the blocks: writing to a sparse mapping on a full disk raises SIGBUS
+	int err = posix_fallocate(fd, 0, _segment_size);
+	if (err != 0 && create) {
+		print(log_error, "Cannot allocate spool segment %s: %s", "spool", file.c_str(), strerror(err));
+		close(fd);
+		unlink(file.c_str());
+		throw vz::VZException("Cannot allocate spool segment.");
+	}
+
+	void *map = mmap(NULL, _segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd); // the mapping keeps the file
+	if (map == MAP_FAILED) {
+		print(log_error, "Cannot map spool segment %s: %s", "spool", file.c_str(), strerror(errno));
+		throw vz::VZException("Cannot map spool segment.");
+	}
+
+	Segment seg;
+	seg.seq = seq;
+	seg.map = map;
+	seg.written = 0;
+	seg.writable = (err == 0);
+
+	if (create) {
+		seg.header()->magic = SPOOL_MAGIC;
+		seg.header()->version = SPOOL_VERSION;
+		seg.header()->acked = 0;
+		_dirty = true;
+	} else {
+		if (seg.header()->magic != SPOOL_MAGIC || seg.header()->version != SPOOL_VERSION) {
+			munmap(map, _segment_size);
+			throw vz::VZException("Invalid spool segment.");
+		}
+		// records are filled in order, the first free one ends the segment
+		while (seg.written < _capacity && seg.records()[seg.written].time_ms != 0) {
+			seg.written++;
+		}
+		if (seg.header()->acked > seg.written) {
+			seg.header()->acked = seg.written;
+		}
+		if (!seg.writable) {
+			// no records are appended, its pending ones are still replayed
+			print(log_warning, "Cannot allocate spool segment %s: %s", "spool", file.c_str(), strerror(err));
+		}
+	}
+
+	return seg;
+}
+
+/**
+ * @return number of unacknowledged readings dropped
+ */
+size_t Spool::drop_front() {
+	Segment &seg = _segments.front();
+	const size_t dropped = seg.written - seg.header()->acked;
+	munmap(seg.map, _segment_size);
+	if (unlink(filename(seg.seq).c_str()) < 0) {
+		print(log_warning, "Cannot remove spool segment %s: %s", "spool", filename(seg.seq).c_str(), strerror(errno));
+	}
+	_segments.pop_front();
+	return dropped;
+}
+
+size_t Spool::replay(std::list<Reading> &out) {
+	size_t n = 0;
+	for (std::deque<Segment>::const_iterator it = _segments.begin(); it != _segments.end(); it++) {
+		for (size_t i = it->header()->acked; i < it->written; i++) {
+			const Record &rec = it->records()[i];
+			struct timeval tv;
+			tv.tv_sec = rec.time_ms / 1000;
+			tv.tv_usec = (rec.time_ms % 1000) * 1000;
+			out.push_back(Reading(rec.value, tv, ReadingIdentifier::Ptr()));
+			n++;
+		}
+	}
+	return n;
+}
+
+size_t Spool::append(const Reading &rd) {
+	size_t dropped = 0;
+
+	if (closed(_segments.back())) {
+		const uint64_t seq = _segments.back().seq + 1;
+		try {
+			_segments.push_back(open_segment(seq, true));
+		} catch (vz::VZException &e) {
+			// disk full: make room by dropping the oldest readings, like the size limit
+			if (_segments.size() == 1) throw;
+			dropped += drop_front();
+			_segments.push_back(open_segment(seq, true));
+		}
+
+		// enforce the size limit by dropping the oldest readings
+		while (_segments.size() > 1 && _segments.size() * _segment_size > _maxsize) {
+			dropped += drop_front();
+		}
+		if (dropped) {
+			print(log_warning, "Spool %s full. Dropped %d oldest readings", "spool", _path.c_str(), dropped);
+		}
+	}
+
+	Segment &seg = _segments.back();
+	Record &rec = seg.records()[seg.written];
+	rec.value = rd.value();
+	__sync_synchronize(); // time_ms marks the record valid, so it has to be written last
+	rec.time_ms = rd.time_ms() ? rd.time_ms() : 1;
+	seg.written++;
+	_dirty = true;
+
+	maybe_sync();
+	return dropped;
+}
+
+void Spool::ack(size_t n) {
+	while (n > 0 && !_segments.empty()) {
+		Segment &seg = _segments.front();
+		size_t take = std::min<size_t>(n, seg.written - seg.header()->acked);
+		seg.header()->acked += take;
+		n -= take;
+		_dirty = true;
+
+		if (closed(seg) && seg.header()->acked == seg.written && _segments.size() > 1) {
+			drop_front();
+		} else if (take == 0) {
+			break; // nothing more to acknowledge
+		}
+	}
+	maybe_sync();
+}
+
+size_t Spool::pending() const {
+	size_t n = 0;
+	for (std::deque<Segment>::const_iterator it = _segments.begin(); it != _segments.end(); it++) {
+		n += it->written - it->header()->acked;
+	}
+	return n;
+}
+
+void Spool::maybe_sync() {
+	if (_sync <= 0 || time(NULL) - _last_sync >= _sync) {
+		sync();
+	}
+}
+
+void Spool::sync() {
+	if (_dirty) {
+		for (std::deque<Segment>::iterator it = _segments.begin(); it != _segments.end(); it++) {
+			if (msync(it->map, _segment_size, MS_SYNC) < 0) {
+				print(log_warning, "Cannot sync spool %s: %s", "spool", _path.c_str(), strerror(errno));
+			}
+		}
+		_dirty = false;
+	}
+	_last_sync = time(NULL);
+}
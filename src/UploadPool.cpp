@@ -0,0 +1,403 @@
+/**
+ * Shared pool of uploader threads
+ *
+ * @package vzlogger
+ * @copyright Copyright (c) 2011, The volkszaehler.org project
+ * @license http://www.gnu.org/licenses/gpl.txt GNU Public License
+ */
+/*
+ * This file is part of volkzaehler.org
+ *
+ * volkzaehler.org is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * volkzaehler.org is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "common.h"
+#include <VZException.hpp>
+#include "UploadPool.hpp"
+
+UploadPool *uploadPool = 0;
+
+UploadPool::UploadPool(size_t workers, size_t connections, int retry_pause, ApiFactory factory,
+					   int batch_window, int retry_max, unsigned int breaker)
+		: _connections(connections)
+		, _retry_pause(retry_pause)
+		, _factory(factory)
+		, _batch_window(batch_window)
+		, _retry_max(std::max(retry_max, retry_pause))
+		, _breaker(breaker)
+		, _random(time(NULL) ^ getpid()) // differs between loggers, so they don't retry in lockstep
+		, _running(true)
+{
+	pthread_mutex_init(&_mutex, NULL);
+
+	// retry timers use the monotonic clock, so they aren't affected by time adjustments
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&_cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	if (workers < 1) workers = 1;
+	for (size_t i = 0; i < workers; i++) {
+		pthread_t thread;
+		int ret = pthread_create(&thread, NULL, &UploadPool::worker, this);
+		if (ret) {
+			print(log_error, "Cannot create upload worker: %s", "upload", strerror(ret));
+			continue;
+		}
+		_threads.push_back(thread);
+	}
+	if (_threads.empty()) {
+		throw vz::VZException("Cannot create upload workers.");
+	}
+	print(log_debug, "Started %d upload workers", "upload", _threads.size());
+}
+
+UploadPool::~UploadPool() {
+	pthread_mutex_lock(&_mutex);
+	_running = false;
+	pthread_cond_broadcast(&_cond);
+	pthread_mutex_unlock(&_mutex);
+
+	for (std::vector<pthread_t>::iterator it = _threads.begin(); it != _threads.end(); it++) {
+		pthread_join(*it, NULL);
+	}
+
+	pthread_cond_destroy(&_cond);
+	pthread_mutex_destroy(&_mutex);
+}
+
+void UploadPool::attach(Channel::Ptr ch) {
+	std::vector<Entry::Ptr> entries;
+	for (size_t i = 0; i < ch->sinks(); i++) {
+		Entry::Ptr e(new Entry);
+		e->ch = ch;
+		e->sink = i;
+		e->api = _factory(ch, i);
+		e->batch = e->api->batch_key();
+		e->state = IDLE;
+		e->dirty = false;
+		e->canceled = false;
+
+		OptionList optlist;
+		try {
+			e->middleware = optlist.lookup_string(ch->sink(i).options, "middleware");
+		} catch (vz::OptionNotFoundException &ex) {
+			// no middleware, no limit
+		}
+		if (e->middleware.empty()) {
+			// backoff of its own
+			char key[48];
+			snprintf(key, sizeof(key), "channel:%p/%lu", (void *)ch.get(), (unsigned long)i);
+			e->endpoint = key;
+		} else {
+			e->endpoint = e->middleware;
+		}
+		entries.push_back(e);
+	}
+
+	pthread_mutex_lock(&_mutex);
+	for (std::vector<Entry::Ptr>::iterator it = entries.begin(); it != entries.end(); it++) {
+		_entries.insert(std::make_pair(ch.get(), *it));
+		if (ch->buffer()->newValues()) enqueue(*it);
+	}
+	pthread_mutex_unlock(&_mutex);
+}
+
+void UploadPool::cancel(const Channel *ch) {
+	pthread_mutex_lock(&_mutex);
+	std::pair<EntryMap::iterator, EntryMap::iterator> range = _entries.equal_range(ch);
+	for (EntryMap::iterator it = range.first; it != range.second; it++) {
+		// queued entries and timers are skipped by the workers
+		it->second->canceled = true;
+	}
+	pthread_mutex_unlock(&_mutex);
+}
+
+void UploadPool::join(const Channel *ch) {
+	pthread_mutex_lock(&_mutex);
+	std::pair<EntryMap::iterator, EntryMap::iterator> range = _entries.equal_range(ch);
+	for (EntryMap::iterator it = range.first; it != range.second; it++) {
+		Entry::Ptr e = it->second;
+		e->canceled = true;
+		while (e->state == BUSY) {
+			pthread_cond_wait(&_cond, &_mutex);
+		}
+	}
+	_entries.erase(ch);
+	pthread_mutex_unlock(&_mutex);
+}
+
+void UploadPool::ready(const Channel *ch) {
+	pthread_mutex_lock(&_mutex);
+	std::pair<EntryMap::iterator, EntryMap::iterator> range = _entries.equal_range(ch);
+	for (EntryMap::iterator it = range.first; it != range.second; it++) {
+		Entry::Ptr &e = it->second;
+		if (e->canceled) continue;
+		switch (e->state) {
+			case IDLE:
+				enqueue(e);
+				break;
+			case BUSY:
+				e->dirty = true; // send again when the worker is done
+				break;
+			default:
+				break; // already queued or waiting for a retry
+		}
+	}
+	pthread_mutex_unlock(&_mutex);
+}
+
+/**
+ * Call with _mutex locked
+ */
+void UploadPool::enqueue(const Entry::Ptr &e) {
+	if (e->batch.empty() || _batch_window <= 0) {
+		push_ready(e);
+		return;
+	}
+	// wait for the other channels of the batch, the first expiring window sends them all
+	e->state = QUEUED;
+	_timers.insert(std::make_pair(now_ms() + _batch_window, e));
+	pthread_cond_signal(&_cond);
+}
+
+/**
+ * Call with _mutex locked
+ */
+void UploadPool::push_ready(const Entry::Ptr &e) {
+	e->state = QUEUED;
+	_ready.push_back(e);
+	pthread_cond_signal(&_cond);
+}
+
+/**
+ * Move all queued entries with the batch key to batch, including those still
+ * waiting for their batch window. Call with _mutex locked
+ */
+void UploadPool::gather(const std::string &key, std::vector<Entry::Ptr> &batch) {
+	for (size_t i = 0; i < _ready.size(); ) {
+		if (_ready[i]->batch == key && !_ready[i]->canceled) {
+			batch.push_back(_ready[i]);
+			_ready.erase(_ready.begin() + i);
+		} else {
+			i++;
+		}
+	}
+	for (std::multimap<int64_t, Entry::Ptr>::iterator it = _timers.begin(); it != _timers.end(); ) {
+		const Entry::Ptr &e = it->second;
+		if (e->state == QUEUED && e->batch == key && !e->canceled) {
+			batch.push_back(e);
+			_timers.erase(it++);
+		} else {
+			++it;
+		}
+	}
+}
+
+/**
+ * Call with _mutex locked
+ */
+UploadPool::Entry::Ptr UploadPool::next() {
+	const int64_t now = now_ms();
+	for (size_t i = 0; i < _ready.size(); ) {
+		Entry::Ptr e = _ready[i];
+		if (e->canceled) {
+			e->state = IDLE;
+			_ready.erase(_ready.begin() + i);
+		} else if ((_connections == 0 || e->middleware.empty() || _active[e->middleware] < _connections)
+				   && admit(e, now)) {
+			_ready.erase(_ready.begin() + i);
+			return e;
+		} else {
+			i++; // middleware busy or paused, keep the order for it
+		}
+	}
+	return Entry::Ptr();
+}
+
+/**
+ * Call with _mutex locked
+ */
+bool UploadPool::admit(const Entry::Ptr &e, int64_t now) {
+	Endpoint &ep = _endpoints[e->endpoint];
+	if (ep.circuit == OPEN) {
+		if (now < ep.open_until) return false;
+		ep.circuit = HALF_OPEN;
+		ep.probing = false;
+	}
+	if (ep.circuit == HALF_OPEN) {
+		if (ep.probing) return false;
+		print(log_info, "Probing %s", e->ch->name(), e->endpoint.c_str());
+		ep.probing = true;
+	}
+	return true;
+}
+
+/**
+ * Call with _mutex locked
+ */
+int64_t UploadPool::failed(const std::string &endpoint) {
+	Endpoint &ep = _endpoints[endpoint];
+	const int64_t now = now_ms();
+
+	// channels failing while a retry round is pending join it, so they back off as one
+	if (now < ep.retry_at) return ep.retry_at - now;
+	ep.failures++;
+
+	// exponential backoff, with 25% jitter so loggers spread their retries
+	int64_t delay = (int64_t)_retry_pause * 1000;
+	for (unsigned int i = 1; i < ep.failures && delay < (int64_t)_retry_max * 1000; i++) delay *= 2;
+	delay = std::min(delay, (int64_t)_retry_max * 1000);
+	delay -= std::uniform_int_distribution<int64_t>(0, delay / 4)(_random);
+	ep.retry_at = now + delay;
+
+	if (ep.circuit == HALF_OPEN || (_breaker > 0 && ep.failures >= _breaker)) {
+		if (ep.circuit != OPEN) {
+			print(log_warning, "%s failed %d retry rounds in a row. Pausing all its channels for %lld ms",
+				  "upload", endpoint.c_str(), ep.failures, (long long)delay);
+		}
+		ep.circuit = OPEN;
+		ep.open_until = ep.retry_at;
+		ep.probing = false;
+	}
+	return delay;
+}
+
+/**
+ * Call with _mutex locked
+ */
+void UploadPool::succeeded(const std::string &endpoint) {
+	Endpoint &ep = _endpoints[endpoint];
+	if (ep.circuit != CLOSED) {
+		print(log_info, "%s is back. Resuming its channels", "upload", endpoint.c_str());
+	}
+	ep.circuit = CLOSED;
+	ep.failures = 0;
+	ep.retry_at = 0;
+	ep.probing = false;
+}
+
+/**
+ * Call with _mutex locked
+ */
+int64_t UploadPool::deadline() {
+	int64_t deadline = _timers.empty() ? 0 : _timers.begin()->first;
+	const int64_t now = now_ms();
+	for (std::map<std::string, Endpoint>::const_iterator it = _endpoints.begin(); it != _endpoints.end(); it++) {
+		if (it->second.circuit == OPEN && it->second.open_until > now
+				&& (deadline == 0 || it->second.open_until < deadline)) {
+			deadline = it->second.open_until;
+		}
+	}
+	return deadline;
+}
+
+int64_t UploadPool::now_ms() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void *UploadPool::worker(void *arg) {
+	static_cast<UploadPool *>(arg)->run();
+	return NULL;
+}
+
+void UploadPool::run() {
+	pthread_mutex_lock(&_mutex);
+	while (_running) {
+		// move channels whose retry delay or batch window is over to the ready queue
+		const int64_t now = now_ms();
+		while (!_timers.empty() && _timers.begin()->first <= now) {
+			Entry::Ptr e = _timers.begin()->second;
+			_timers.erase(_timers.begin());
+			if (e->canceled) {
+				e->state = IDLE;
+			} else {
+				push_ready(e);
+			}
+		}
+
+		Entry::Ptr e = next();
+		if (!e) {
+			const int64_t deadline = this->deadline();
+			if (deadline == 0) {
+				pthread_cond_wait(&_cond, &_mutex);
+			} else {
+				struct timespec ts;
+				ts.tv_sec = deadline / 1000;
+				ts.tv_nsec = (deadline % 1000) * 1000000;
+				pthread_cond_timedwait(&_cond, &_mutex, &ts);
+			}
+			continue;
+		}
+
+		// all channels of a batch share one request
+		std::vector<Entry::Ptr> batch(1, e);
+		if (!e->batch.empty()) gather(e->batch, batch);
+
+		std::vector<vz::ApiIF *> apis;
+		for (std::vector<Entry::Ptr>::iterator it = batch.begin(); it != batch.end(); it++) {
+			(*it)->state = BUSY;
+			(*it)->dirty = false;
+			apis.push_back((*it)->api.get());
+		}
+		_active[e->middleware]++;
+		pthread_mutex_unlock(&_mutex);
+
+		bool ok;
+		try {
+			for (std::vector<Entry::Ptr>::iterator it = batch.begin(); it != batch.end(); it++) {
+				(*it)->ch->buffer()->take_newValues();
+			}
+			ok = (batch.size() == 1) ? e->api->send() : e->api->send_batch(apis);
+		} catch (std::exception &ex) {
+			print(log_error, "Sending failed due to: %s", e->ch->name(), ex.what());
+			ok = false;
+		}
+
+		pthread_mutex_lock(&_mutex);
+		_active[e->middleware]--;
+		int64_t delay = 0;
+		if (ok) {
+			succeeded(e->endpoint);
+		} else {
+			delay = failed(e->endpoint);
+		}
+		for (std::vector<Entry::Ptr>::iterator it = batch.begin(); it != batch.end(); it++) {
+			const Entry::Ptr &b = *it;
+			if (b->canceled) {
+				b->state = IDLE;
+			} else if (!ok) {
+				print(log_info, "Retrying in %lld ms due to previous failure", b->ch->name(), (long long)delay);
+				b->state = RETRY;
+				_timers.insert(std::make_pair(now_ms() + delay, b));
+			} else if (b->dirty) {
+				enqueue(b);
+			} else {
+				b->state = IDLE;
+			}
+		}
+		// a middleware slot got free and join() may wait for this entry
+		pthread_cond_broadcast(&_cond);
+	}
+	pthread_mutex_unlock(&_mutex);
+}
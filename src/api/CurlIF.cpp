@@ -25,6 +25,8 @@
 
 #include <VZException.hpp>
 #include <api/CurlIF.hpp>
+#include "CurlMulti.hpp"
+#include "CurlShare.hpp"
 
 vz::api::CurlIF::CurlIF()
 		: _headers(0)
@@ -33,6 +35,7 @@ vz::api::CurlIF::CurlIF()
 	if (!_curl) {
 		throw vz::VZException("CURL: cannot create handle.");
 	}
+	if (curlShare) curlShare->apply(_curl);
 }
 
 vz::api::CurlIF::~CurlIF() {
@@ -54,3 +57,7 @@ void vz::api::CurlIF::commitHeader() {
 		curl_easy_setopt(handle(), CURLOPT_HTTPHEADER, _headers);
 }
 
+CURLcode vz::api::CurlIF::perform() {
+	return curlMulti ? curlMulti->perform(handle()) : curl_easy_perform(handle());
+}
+
@@ -136,13 +136,17 @@ vz::api::MySmartGrid::MySmartGrid(
 
   // set timeout to 5 sec. required if next router has an ip-change.
 	curl_easy_setopt(_curlIF.handle(), CURLOPT_TIMEOUT, curlTimeout);
+
+	_journal = channel()->journal();
+	_sink = _journal->attach();
 }
 
 vz::api::MySmartGrid::~MySmartGrid()
 {
+	_journal->detach(_sink);
 }
 
-void vz::api::MySmartGrid::send()
+bool vz::api::MySmartGrid::send()
 {
 	json_object *json_obj;
 	char digest[255];
@@ -157,7 +161,7 @@ void vz::api::MySmartGrid::send()
 	if (_first_ts>0) {
 		if ((now-first_ts()) < interval() ) {
 			print(log_debug, "api-MySmartGrid, skip message.", "");
-			return;
+			return true;
 		}
 	} else { // _first_ts = 0
 	}
@@ -174,7 +178,7 @@ void vz::api::MySmartGrid::send()
 	if (json_str == NULL || strcmp(json_str, "null")==0) {
 		print(log_debug, "JSON request body is null. Nothing to send now.", channel()->name());
 		json_object_put(json_obj); // TODO untested!
-		return;
+		return true;
 	}
 
 	print(log_debug, "JSON request body: '%s'", channel()->name(), json_str);
@@ -216,12 +220,7 @@ void vz::api::MySmartGrid::send()
 /* householding */
 	json_object_put(json_obj);
 
-	if (options.daemon() && (curl_code != CURLE_OK || http_code != 200)) {
-		print(log_info, "Waiting %i secs for next request due to previous failure",
-					channel()->name(), options.retry_pause());
-		sleep(options.retry_pause());
-	}
-//sleep(20);
+	return (curl_code == CURLE_OK && http_code == 200);
 }
 
 void vz::api::MySmartGrid::register_device() {
@@ -363,13 +362,9 @@ void vz::api::MySmartGrid::api_parse_exception(char *err, size_t n) {
 
 json_object *vz::api::MySmartGrid::_apiDevice(Buffer::Ptr buf) {
 
-	// copy all values to local buffer queue
-	buf->lock();
-	for (	Buffer::iterator it = buf->begin(); it != buf->end(); it++) {
-		it->mark_delete();
-	}
-	buf->unlock();
-	buf->clean();
+	// drop all values
+	_journal->fetch(*buf);
+	_journal->ack(_sink, _journal->pending(_sink));
 
 	if (_first_ts>0) { // send lifesign
 		_first_ts = time(NULL);
@@ -490,7 +485,7 @@ json_object * vz::api::MySmartGrid::_json_object_measurements(Buffer::Ptr buf) {
 //  measurements: [[<timestamp1>,<value1>], [<timestamp2>,<value2>], ... ,[<timestamp n>,<value n>]]
 	json_object *json_obj    = json_object_new_object();
 	json_object *json_tuples = json_object_new_array();
-	Buffer::iterator it;
+	std::vector<Reading>::const_iterator it;
 
 //long last_counter = 0;
 
@@ -504,21 +499,21 @@ json_object * vz::api::MySmartGrid::_json_object_measurements(Buffer::Ptr buf) {
 	}
 
 	// copy all values to local buffer queue
-	buf->lock();
-	for (it = buf->begin(); it != buf->end(); it++) {
+	_batch.clear();
+	_journal->fetch(*buf);
+	_journal->copy(_sink, _batch);
+	_journal->ack(_sink, _batch.size());
+	for (it = _batch.begin(); it != _batch.end(); it++) {
 		if (timestamp < it->time_s() /*&& value != (long)(it->value() * _scaler)*/ ) {
 			_values.push_back(*it);
 			timestamp = it->time_s();
 			value     = it->value() * _scaler;
 		}
-		it->mark_delete();
 	}
-	buf->unlock();
-	buf->clean();
 
 	//print(log_debug, "Valuescounter: %d", channel()->name(), _values.size());
 
-	for (it = _values.begin(); it != _values.end(); it++) {
+	for (std::list<Reading>::const_iterator it = _values.begin(); it != _values.end(); it++) {
 		timestamp = it->time_s();
 		value     = it->value() * _scaler;
 		print(log_debug, "==> %ld, %lf - %ld", channel()->name(), timestamp, it->value(), value);
@@ -528,7 +523,7 @@ json_object * vz::api::MySmartGrid::_json_object_measurements(Buffer::Ptr buf) {
 	}
 
 
-	for (it = _values.begin(); it != _values.end(); it++) {
+	for (std::list<Reading>::const_iterator it = _values.begin(); it != _values.end(); it++) {
 		struct json_object *json_tuple = json_object_new_array();
 
 		// TODO use long int of new json-c version
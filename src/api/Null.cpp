@@ -38,23 +38,22 @@ vz::api::Null::Null(
 	std::list<Option> pOptions
 	)
 	: ApiIF(ch)
+	, _journal(ch->journal())
+	, _sink(_journal->attach())
 {
 }
 
 vz::api::Null::~Null()
 {
+	_journal->detach(_sink);
 }
 
-void vz::api::Null::send()
+bool vz::api::Null::send()
 {
-	// we need to mark all elements as transmitted/deleted otherwise the Channel::Buffer keeps on growing
-	Buffer::Ptr buf = channel()->buffer();
-	buf->lock();
-	for (	Buffer::iterator it = buf->begin(); it != buf->end(); it++) {
-		it->mark_delete();
-	}
-	buf->unlock();
-	buf->clean();
+	// we need to drop all elements otherwise the Channel::Buffer keeps on growing
+	_journal->fetch(*channel()->buffer());
+	_journal->ack(_sink, _journal->pending(_sink));
+	return true;
 }
 
 void vz::api::Null::register_device()
@@ -34,21 +34,29 @@
 #include <sys/time.h>
 #include <math.h>
 #include <unistd.h>
+#include <algorithm>
+#include <limits>
+#include <sstream>
 
 #include <VZException.hpp>
 #include "Config_Options.hpp"
 #include <api/Volkszaehler.hpp>
 #include "CurlSessionProvider.hpp"
+#include "CurlMulti.hpp"
 
 extern Config_Options options;
 
+const size_t vz::api::Volkszaehler::CHUNK_MIN;
+const size_t vz::api::Volkszaehler::CHUNK_STEP;
+
 vz::api::Volkszaehler::Volkszaehler(
 	Channel::Ptr ch,
 	std::list<Option> pOptions
 	)
 	: ApiIF(ch)
-	, _last_timestamp(0)
-	, _lastReadingSent (0)
+	, _inflight(0)
+	, _multiUuid(true)
+	, _encodedHeaders(NULL)
 {
 	OptionList optlist;
 	char agent[255];
@@ -70,6 +78,62 @@ vz::api::Volkszaehler::Volkszaehler(
 		throw;
 	}
 
+	// limits for a single request, larger backlogs are sent in chunks
+	try {
+		int maxtuples = optlist.lookup_int(pOptions, "maxtuples");
+		if (maxtuples < 0) throw vz::VZException("maxtuples < 0 not allowed");
+		_maxTuples = maxtuples;
+	} catch (vz::OptionNotFoundException &e) {
+		_maxTuples = 1000;
+	}
+
+	try {
+		int maxbytes = optlist.lookup_int(pOptions, "maxbytes");
+		if (maxbytes < 0) throw vz::VZException("maxbytes < 0 not allowed");
+		_maxBytes = maxbytes;
+	} catch (vz::OptionNotFoundException &e) {
+		_maxBytes = 0; // no limit
+	}
+
+	try {
+		_adaptive = optlist.lookup_bool(pOptions, "adaptive");
+	} catch (vz::OptionNotFoundException &e) {
+		_adaptive = false;
+	}
+
+	try {
+		_batchUpload = optlist.lookup_bool(pOptions, "batch");
+	} catch (vz::OptionNotFoundException &e) {
+		_batchUpload = false;
+	}
+
+	// concurrent uploads to the middleware share one connection, if it supports HTTP/2
+	try {
+		_http2 = optlist.lookup_bool(pOptions, "http2");
+	} catch (vz::OptionNotFoundException &e) {
+		_http2 = false;
+	}
+
+	// compression of the request bodies, the middleware has to accept the encoding
+	try {
+		ContentEncoder::Encoding encoding = ContentEncoder::parse(optlist.lookup_string(pOptions, "encoding"));
+		int min_size = 1024;
+		try {
+			min_size = optlist.lookup_int(pOptions, "encodingmin");
+			if (min_size < 0) throw vz::VZException("encodingmin < 0 not allowed");
+		} catch (vz::OptionNotFoundException &e) {
+			// keep default
+		}
+		if (encoding != ContentEncoder::NONE) {
+			_encoder = ContentEncoder::Ptr(new ContentEncoder(encoding, min_size));
+		}
+	} catch (vz::OptionNotFoundException &e) {
+		// uncompressed
+	}
+
+	// adaptive mode starts small and grows up to maxtuples while requests succeed quickly
+	_chunk = _adaptive ? (_maxTuples ? std::min(_maxTuples, CHUNK_MIN) : CHUNK_MIN) : _maxTuples;
+
 	// prepare header, uuid & url
 	sprintf(agent, "User-Agent: %s/%s (%s)", PACKAGE, VERSION, curl_version());	// build user agent
 	_url = _middleware;
@@ -82,68 +146,178 @@ vz::api::Volkszaehler::Volkszaehler(
 	_api.headers = curl_slist_append(_api.headers, "Accept: application/json");
 	_api.headers = curl_slist_append(_api.headers, agent);
 
+	if (_encoder) {
+		for (struct curl_slist *h = _api.headers; h; h = h->next) {
+			_encodedHeaders = curl_slist_append(_encodedHeaders, h->data);
+		}
+		_encodedHeaders = curl_slist_append(_encodedHeaders, _encoder->header());
+	}
+
+	// the tuples only depend on the size limit, so sinks with the same limit share the chunks
+	std::ostringstream format;
+	format << "volkszaehler:" << _maxBytes;
+	_format = format.str();
+
+	_journal = channel()->journal();
+
+	// durable spool for readings not yet acknowledged by all sinks of the channel
+	if (!options.spool_dir().empty() && !_journal->spooled()) {
+		size_t n = _journal->spool(Spool::Ptr(new Spool(options.spool_dir(), channel()->uuid(),
+														options.spool_size(), options.spool_sync())));
+		if (n > 0) {
+			print(log_info, "Replaying %d unsent readings from spool", channel()->name(), n);
+		}
+	}
+
+	_sink = _journal->attach();
 }
 
 vz::api::Volkszaehler::~Volkszaehler()
 {
-	if (_lastReadingSent) delete _lastReadingSent;
+	_journal->detach(_sink);
+	curl_slist_free_all(_encodedHeaders);
 }
 
-void vz::api::Volkszaehler::send()
+bool vz::api::Volkszaehler::send()
 {
-	CURLresponse response;
-	json_object *json_obj;
+	const char *json_str = api_json_tuples(channel()->buffer());
+	if (json_str == NULL) {
+		print(log_debug, "JSON request body is null. Nothing to send now.", channel()->name());
+		return true;
+	}
 
-	const char *json_str;
-	long int http_code;
-	CURLcode curl_code;
+	// send the backlog chunk by chunk until it is empty or a request fails
+	bool ok;
+	do {
+		ok = send_chunk(json_str);
+		json_str = (ok && _journal->pending(_sink)) ? api_json_chunk() : NULL;
+	} while (json_str);
+
+	return ok;
+}
+
+bool vz::api::Volkszaehler::send_batch(const std::vector<ApiIF *> &apis)
+{
+	// the current chunk of each channel is kept in its _body
+	std::vector<Volkszaehler *> pending;
+	for (std::vector<ApiIF *>::const_iterator it = apis.begin(); it != apis.end(); it++) {
+		Volkszaehler *api = dynamic_cast<Volkszaehler *>(*it);
+		if (api && api->api_json_tuples(api->channel()->buffer())) {
+			pending.push_back(api);
+		}
+	}
+
+	bool ok = true;
+	while (ok && !pending.empty()) {
+		const bool multi = _multiUuid && pending.size() > 1;
+		bool rejected = false;
+		if (multi) {
+			ok = send_multi(pending, rejected);
+		}
+		if (!multi || rejected) {
+			// one request per channel, they reuse the connection of the session provider
+			bool single = true;
+			for (size_t i = 0; i < pending.size(); i++) {
+				single = pending[i]->send_chunk(pending[i]->_body->c_str()) && single;
+			}
+			if (multi && single) {
+				// rejected as batch but accepted per channel: the middleware lacks multi-UUID support
+				print(log_warning, "Middleware doesn't accept multi-UUID requests. Sending one request per channel",
+					  channel()->name());
+				for (size_t i = 0; i < pending.size(); i++) pending[i]->_multiUuid = false;
+			}
+			ok = single;
+		}
+
+		// channels with a larger backlog continue with their next chunk
+		std::vector<Volkszaehler *> more;
+		for (size_t i = 0; ok && i < pending.size(); i++) {
+			if (pending[i]->_journal->pending(pending[i]->_sink)) {
+				more.push_back(pending[i]);
+				pending[i]->api_json_chunk();
+			}
+		}
+		pending.swap(more);
+	}
+
+	return ok;
+}
+
+bool vz::api::Volkszaehler::send_multi(const std::vector<Volkszaehler *> &apis, bool &rejected)
+{
+	CURLresponse response;
+	long int http_code = 0;
+	double total_time = 0;
 
-	// initialize response
 	response.data = NULL;
 	response.size = 0;
 
-	json_obj = api_json_tuples(channel()->buffer());
-	json_str = json_object_to_json_string(json_obj);
-	if (json_str == NULL || strcmp(json_str, "null")==0) {
-		print(log_debug, "JSON request body is null. Nothing to send now.", channel()->name());
-		return;
-	}
+	const char *json_str = api_json_batch(apis);
 
-	_api.curl = curlSessionProvider ? curlSessionProvider->get_easy_session(_middleware) : 0; // TODO add option to use parallel sessions. Simply add uuid() to the key.
-	if (!_api.curl) {
-		throw vz::VZException("CURL: cannot create handle.");
+	print(log_debug, "JSON request body (%d channels): %s", channel()->name(), apis.size(), json_str);
+
+	const CURLcode curl_code = post(_middleware + "/data.json", json_str, &response, &http_code, &total_time);
+	const bool ok = (curl_code == CURLE_OK && http_code == 200);
+
+	if (ok) {
+		print(log_debug, "CURL Request succeeded with code: %i", channel()->name(), http_code);
+		for (size_t i = 0; i < apis.size(); i++) apis[i]->ack();
+	}
+	else if (curl_code != CURLE_OK) {
+		print(log_error, "CURL: %s", channel()->name(), curl_easy_strerror(curl_code));
+	}
+	else if (multi_rejected(http_code)) {
+		print(log_info, "Middleware rejected multi-UUID request with code %i", channel()->name(), http_code);
+		rejected = true;
+	}
+	else {
+		char err[255];
+		api_parse_exception(response, err, 255);
+		print(log_error, "CURL Error from middleware: %s", channel()->name(), err);
 	}
-	curl_easy_setopt(_api.curl, CURLOPT_URL, _url.c_str());
-	curl_easy_setopt(_api.curl, CURLOPT_HTTPHEADER, _api.headers);
-	curl_easy_setopt(_api.curl, CURLOPT_VERBOSE, options.verbosity());
-	curl_easy_setopt(_api.curl, CURLOPT_DEBUGFUNCTION, curl_custom_debug_callback);
-	curl_easy_setopt(_api.curl, CURLOPT_DEBUGDATA, channel().get());
 
-	// signal-handling in libcurl is NOT thread-safe. so force to deactivated them!
-	curl_easy_setopt(_api.curl, CURLOPT_NOSIGNAL, 1);
+	for (size_t i = 0; i < apis.size(); i++) apis[i]->adapt_chunk(curl_code, total_time);
 
-	// set timeout to 5 sec. required if next router has an ip-change.
-	curl_easy_setopt(_api.curl, CURLOPT_TIMEOUT, _curlTimeout);
+	free(response.data);
 
+	return ok;
+}
 
-	print(log_debug, "JSON request body: %s", channel()->name(), json_str);
+bool vz::api::Volkszaehler::multi_rejected(long http_code)
+{
+	switch (http_code) {
+		case 400: // Bad Request
+		case 404: // Not Found
+		case 405: // Method Not Allowed
+		case 415: // Unsupported Media Type
+			return true;
+		default:
+			return false;
+	}
+}
 
-	curl_easy_setopt(_api.curl, CURLOPT_POSTFIELDS, json_str);
-	curl_easy_setopt(_api.curl, CURLOPT_WRITEFUNCTION, curl_custom_write_callback);
-	curl_easy_setopt(_api.curl, CURLOPT_WRITEDATA, (void *) &response);
+bool vz::api::Volkszaehler::send_chunk(const char *json_str)
+{
+	CURLresponse response;
+	long int http_code = 0;
+	CURLcode curl_code;
+	double total_time = 0;
 
-	curl_code = curl_easy_perform(_api.curl);
-	curl_easy_getinfo(_api.curl, CURLINFO_RESPONSE_CODE, &http_code);
+	// initialize response
+	response.data = NULL;
+	response.size = 0;
 
-	if (curlSessionProvider)
-		curlSessionProvider->return_session(_middleware, _api.curl);
+	print(log_debug, "JSON request body (%d of %d tuples): %s", channel()->name(),
+		  _inflight, _journal->pending(_sink), json_str);
+
+	curl_code = post(_url, json_str, &response, &http_code, &total_time);
+
+	const bool ok = (curl_code == CURLE_OK && http_code == 200);
 
 	// check response
-	if (curl_code == CURLE_OK && http_code == 200) { // everything is ok
+	if (ok) { // everything is ok
 		print(log_debug, "CURL Request succeeded with code: %i", channel()->name(), http_code);
-		_values.clear();
-		// clear buffer-readings
-		//channel()->buffer.sent = last->next;
+		ack();
 	}
 	else { // error
 		if (curl_code != CURLE_OK) {
@@ -156,14 +330,76 @@ void vz::api::Volkszaehler::send()
 		}
 	}
 
+	adapt_chunk(curl_code, total_time);
+
 	// householding
 	free(response.data);
-	json_object_put(json_obj);
 
-	if (options.daemon() && (curl_code != CURLE_OK || http_code != 200)) {
-		print(log_info, "Waiting %i secs for next request due to previous failure",
-					channel()->name(), options.retry_pause());
-		sleep(options.retry_pause());
+	return ok;
+}
+
+CURLcode vz::api::Volkszaehler::post(const std::string &url, const char *body, CURLresponse *response,
+									  long *http_code, double *total_time)
+{
+	_api.curl = curlSessionProvider ? curlSessionProvider->get_easy_session(_middleware) : 0;
+	if (!_api.curl) {
+		throw vz::VZException("CURL: cannot create handle.");
+	}
+	curl_easy_setopt(_api.curl, CURLOPT_URL, url.c_str());
+	curl_easy_setopt(_api.curl, CURLOPT_VERBOSE, options.verbosity());
+	curl_easy_setopt(_api.curl, CURLOPT_DEBUGFUNCTION, curl_custom_debug_callback);
+	curl_easy_setopt(_api.curl, CURLOPT_DEBUGDATA, channel().get());
+
+	// signal-handling in libcurl is NOT thread-safe. so force to deactivated them!
+	curl_easy_setopt(_api.curl, CURLOPT_NOSIGNAL, 1);
+
+	// set timeout to 5 sec. required if next router has an ip-change.
+	curl_easy_setopt(_api.curl, CURLOPT_TIMEOUT, _curlTimeout);
+
+	const size_t len = strlen(body);
+	if (_encoder && _encoder->encode(body, len)) {
+		print(log_debug, "Compressed request body from %d to %d bytes", channel()->name(), len, _encoder->size());
+		curl_easy_setopt(_api.curl, CURLOPT_HTTPHEADER, _encodedHeaders);
+		curl_easy_setopt(_api.curl, CURLOPT_POSTFIELDSIZE, (long)_encoder->size());
+		curl_easy_setopt(_api.curl, CURLOPT_POSTFIELDS, _encoder->data());
+	} else {
+		curl_easy_setopt(_api.curl, CURLOPT_HTTPHEADER, _api.headers);
+		curl_easy_setopt(_api.curl, CURLOPT_POSTFIELDSIZE, (long)len);
+		curl_easy_setopt(_api.curl, CURLOPT_POSTFIELDS, body);
+	}
+	curl_easy_setopt(_api.curl, CURLOPT_WRITEFUNCTION, curl_custom_write_callback);
+	curl_easy_setopt(_api.curl, CURLOPT_WRITEDATA, (void *) response);
+
+	CurlMulti::multiplex(_api.curl, _http2);
+
+	CURLcode curl_code = curlMulti ? curlMulti->perform(_api.curl) : curl_easy_perform(_api.curl);
+	curl_easy_getinfo(_api.curl, CURLINFO_RESPONSE_CODE, http_code);
+	curl_easy_getinfo(_api.curl, CURLINFO_TOTAL_TIME, total_time);
+
+	if (curlSessionProvider)
+		curlSessionProvider->return_session(_middleware, _api.curl);
+
+	return curl_code;
+}
+
+void vz::api::Volkszaehler::ack() {
+	// the acknowledged prefix only
+	_journal->ack(_sink, _inflight);
+	_inflight = 0;
+	_body.reset(); // the storage can be reused for the next chunk
+}
+
+void vz::api::Volkszaehler::adapt_chunk(CURLcode curl_code, double total_time) {
+	if (!_adaptive) return;
+
+	const size_t max = _maxTuples ? _maxTuples : std::numeric_limits<size_t>::max();
+	if (curl_code == CURLE_OPERATION_TIMEDOUT) {
+		// multiplicative decrease
+		_chunk = std::max<size_t>(CHUNK_MIN, _chunk / 2);
+		print(log_info, "Request timed out. Reducing chunk size to %d tuples", channel()->name(), _chunk);
+	} else if (curl_code == CURLE_OK && total_time < _curlTimeout / 4.0) {
+		// additive increase while requests finish well within the timeout
+		_chunk = std::min(max, _chunk + CHUNK_STEP);
 	}
 }
 
@@ -171,69 +407,64 @@ void vz::api::Volkszaehler::register_device() {
 }
 
 
-json_object * vz::api::Volkszaehler::api_json_tuples(Buffer::Ptr buf) {
-
-	Buffer::iterator it;
-
-	print(log_debug, "==> number of tuples: %d", channel()->name(), buf->size());
-	int64_t timestamp = 1;
-	const int duplicates = channel()->duplicates();
-	const int duplicates_ms = duplicates * 1000;
-
-	// copy all values to local buffer queue
-	buf->lock();
-	for (it = buf->begin(); it != buf->end(); it++) {
-		timestamp = it->time_ms();
-		print(log_debug, "compare: %lld %lld", channel()->name(), _last_timestamp, timestamp);
-		// we can only add/consider a timestamp if the ms resolution is different than from previous one:
-		if (_last_timestamp < timestamp ) {
-			if (0 == duplicates) { // send all values
-				_values.push_back(*it);
-				_last_timestamp = timestamp;
-			} else {
-				const Reading &r = *it;
-				// duplicates should be ignored
-				// but send at least each <duplicates> seconds
-
-				if (!_lastReadingSent) { // first one from the duplicate consideration -> send it
-					_lastReadingSent = new Reading(r);
-					_values.push_back(r);
-					_last_timestamp = timestamp;
-				} else { // one reading sent already. compare
-					// a) timestamp
-					// b) duplicate value
-					if ((timestamp >= (_last_timestamp + duplicates_ms)) ||
-							(r.value() != _lastReadingSent->value())) {
-						// send the current one:
-						_values.push_back(r);
-						_last_timestamp = timestamp;
-						*_lastReadingSent = r;
-					} else {
-						// ignore it
-					}
-				}
-			}
-		}
-		it->mark_delete();
-	}
-	buf->unlock();
-	buf->clean();
+const char * vz::api::Volkszaehler::api_json_tuples(Buffer::Ptr buf) {
+	// readings not newer than the last one and duplicates are skipped by the journal
+	size_t n = _journal->fetch(*buf);
+	print(log_debug, "==> number of tuples: %d", channel()->name(), n);
 
-	if (_values.size() < 1 ) {
+	if (_journal->pending(_sink) < 1) {
 		return NULL;
 	}
 
-	json_object *json_tuples = json_object_new_array();
-	for (it = _values.begin(); it != _values.end(); it++) {
-		struct json_object *json_tuple = json_object_new_array();
+	return api_json_chunk();
+}
 
-		json_object_array_add(json_tuple, json_object_new_int64(it->time_ms()));
-		json_object_array_add(json_tuple, json_object_new_double(it->value()));
+const char * vz::api::Volkszaehler::api_json_chunk() {
+	const size_t max = _chunk ? _chunk : std::numeric_limits<size_t>::max();
+	const size_t maxbytes = _maxBytes;
+
+	_body = _journal->serialize(_sink, _format, max,
+		[maxbytes](const RingBuffer<Reading> &log, size_t first, size_t last, JsonWriter &json) {
+			return serialize_tuples(log, first, last, maxbytes, json);
+		}, _inflight);
+
+	return _body ? _body->c_str() : NULL;
+}
+
+size_t vz::api::Volkszaehler::serialize_tuples(const RingBuffer<Reading> &log, size_t first, size_t last,
+												size_t maxbytes, JsonWriter &json) {
+	size_t n = 0;
+	json.clear();
+	json.begin_array();
+	for (size_t i = first; i < last; i++) {
+		const size_t mark = json.size();
+		json.tuple(log[i].time_ms(), log[i].value());
+		// +1 for the closing bracket, at least one tuple is always sent
+		if (maxbytes && json.size() + 1 > maxbytes && n > 0) {
+			json.truncate(mark);
+			break;
+		}
+		n++;
+	}
+	json.end_array();
+
+	return n;
+}
 
-		json_object_array_add(json_tuples, json_tuple);
+const char * vz::api::Volkszaehler::api_json_batch(const std::vector<Volkszaehler *> &apis) {
+	_batchJson.clear();
+	_batchJson.begin_array();
+	for (size_t i = 0; i < apis.size(); i++) {
+		_batchJson.begin_object();
+		_batchJson.key("uuid");
+		_batchJson.string(apis[i]->channel()->uuid());
+		_batchJson.key("tuples");
+		_batchJson.raw(apis[i]->_body->c_str(), apis[i]->_body->size());
+		_batchJson.end_object();
 	}
+	_batchJson.end_array();
 
-	return json_tuples;
+	return _batchJson.c_str();
 }
 
 void vz::api::Volkszaehler::api_parse_exception(CURLresponse response, char *err, size_t n) {
@@ -260,7 +491,7 @@ void vz::api::Volkszaehler::api_parse_exception(CURLresponse response, char *err
 		  if (err_type == "UniqueConstraintViolationException") {
 			  if (err_message.find("Duplicate entry") ) {
 				  print(log_warning, "Middleware says duplicated value. Removing first entry!", channel()->name());
-				  _values.pop_front();
+				  _journal->ack(_sink, 1);
 			  }
 		  }
 	  }
@@ -23,105 +23,464 @@
  * along with volkszaehler.org. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <list>
 #include <map>
+#include <vector>
 
-#include <json-c/json.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
+#include <sys/time.h>
 
 #include "vzlogger.h"
 #include "Channel.hpp"
 #include "local.h"
+#include "JsonWriter.hpp"
+#include "LocalBuffer.hpp"
 #include <MeterMap.hpp>
 #include <VZException.hpp>
+#include <shared_ptr.hpp>
 #include <pthread.h>
 
 extern Config_Options options;
 
-class ChannelData
+// by Channel::local_id() and by uuid. Built by init_localbuffer() before the meters start,
+// read-only afterwards, so they need no lock
+std::vector<LocalBuffer::Ptr> localbuffers;
+std::map<std::string, int> localbuffer_index;
+
+static int64_t now_ms()
 {
-public:
-	ChannelData(const int64_t &t, const double &v) : _t(t), _v(v) {};
-	int64_t _t;
-	double _v;
-};
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+void init_localbuffer(MapContainer &mappings)
+{
+	for (MapContainer::iterator mapping = mappings.begin(); mapping!=mappings.end(); mapping++) {
+		// expected readings per channel within the time based buffer, it grows if there are more
+		const int period = std::max(1, mapping->meter()->aggtime() > 0 ?
+									mapping->meter()->aggtime() : mapping->meter()->interval());
+		size_t max = 0;
+		size_t capacity = std::min(options.buffer_length() / period + 1, 4096);
+		if (options.buffer_length() < 0) { // max size based localbuffer. keep max -buffer_length items
+			capacity = max = -options.buffer_length();
+		}
 
-typedef std::list<ChannelData> LIST_ChannelData;
-typedef std::map<std::string, LIST_ChannelData> MAP_UUID_ChannelData;
-pthread_mutex_t localbuffer_mutex = PTHREAD_MUTEX_INITIALIZER;
-MAP_UUID_ChannelData localbuffer;
+		for (MeterMap::iterator ch = mapping->begin(); ch!=mapping->end(); ch++) {
+			std::map<std::string, int>::const_iterator it = localbuffer_index.find((*ch)->uuid());
+			if (it != localbuffer_index.end()) { // same uuid, same readings
+				(*ch)->local_id(it->second);
+				continue;
+			}
+			(*ch)->local_id(localbuffers.size());
+			localbuffer_index[(*ch)->uuid()] = localbuffers.size();
+			localbuffers.push_back(LocalBuffer::Ptr(new LocalBuffer(capacity, max)));
+		}
+	}
 
-void shrink_localbuffer() // remove old data in the local buffer
+	// the readings are added as they are stored, not taken from the buffers the uploads drain
+	for (MapContainer::iterator mapping = mappings.begin(); mapping!=mappings.end(); mapping++) {
+		for (MeterMap::iterator ch = mapping->begin(); ch!=mapping->end(); ch++) {
+			(*ch)->buffer()->listener(&push_localbuffer, (*ch)->local_id());
+		}
+	}
+}
+
+void push_localbuffer(int id, const Reading &rd)
+{
+	if (id < 0 || id >= (int)localbuffers.size() || rd.deleted()) return;
+
+	LocalBuffer &lb = *localbuffers[id];
+	lb.lock();
+	lb.push(rd.time_ms(), rd.value());
+	lb.unlock();
+}
+
+/**
+ * @return the local buffer of the channel, NULL if unknown
+ */
+static LocalBuffer *find_localbuffer(const char *uuid)
+{
+	std::map<std::string, int>::const_iterator it = localbuffer_index.find(uuid);
+	return it != localbuffer_index.end() ? localbuffers[it->second].get() : NULL;
+}
+
+static LocalBuffer *find_localbuffer(Channel &ch)
+{
+	const int id = ch.local_id();
+	return id >= 0 && id < (int)localbuffers.size() ? localbuffers[id].get() : NULL;
+}
+
+/**
+ * Remove old data from the readings of a channel, call with the channel locked
+ *
+ * Only the channel written or read is expired, the others wait until they are used.
+ */
+static void expire_localbuffer(LocalBuffer &lb)
 {
 	if (options.buffer_length()>=0){ // time based localbuffer. keep buffer_length secs
-		Reading rnow;
-		rnow.time(); // sets to "now"
-		int64_t minT = rnow.time_ms() - (1000*options.buffer_length()); // now - time to keep in buffer
+		lb.expire(now_ms() - (1000*options.buffer_length())); // now - time to keep in buffer
+	}
+}
+
+/**
+ * @return timestamp of the newest reading of the channel, 0 if there is none
+ */
+static int64_t newest_localbuffer(const char *uuid)
+{
+	int64_t t = 0;
+	LocalBuffer *lb = find_localbuffer(uuid);
+	if (lb) {
+		lb->lock();
+		t = lb->newest();
+		lb->unlock();
+	}
+	return t;
+}
 
-		pthread_mutex_lock(&localbuffer_mutex);
+/**
+ * @return timestamp of the newest reading of all channels, 0 if there is none
+ */
+static int64_t newest_localbuffer()
+{
+	int64_t t = 0;
+	for (size_t i = 0; i < localbuffers.size(); i++) {
+		LocalBuffer &lb = *localbuffers[i];
+		lb.lock();
+		t = std::max(t, lb.newest());
+		lb.unlock();
+	}
+	return t;
+}
 
-		MAP_UUID_ChannelData::iterator it = localbuffer.begin();
-		for (;it!=localbuffer.end(); ++it) {
-			LIST_ChannelData &l = it->second;
-			LIST_ChannelData::iterator lit = l.begin();
+/**
+ * Comet request suspended until its channel gets new readings or the timeout expires
+ */
+class CometWaiter;
+typedef std::multimap<std::string, CometWaiter *> MAP_UUID_CometWaiter;
+typedef std::multimap<int64_t, CometWaiter *> MAP_Deadline_CometWaiter;
 
-			while (lit!=l.end() && ((lit->_t) < minT))
-				lit = l.erase(lit);
+class CometWaiter
+{
+public:
+	CometWaiter(struct MHD_Connection *connection, int64_t since)
+		: _connection(connection), _since(since), _suspended(false) {};
+
+	struct MHD_Connection *_connection;
+	int64_t _since;			// timestamp of the last reading seen by the client
+	bool _suspended;		// registered in comet_waiters and comet_deadlines
+	MAP_UUID_CometWaiter::iterator _waiting;
+	MAP_Deadline_CometWaiter::iterator _deadline;
+};
+
+// suspended requests by uuid, "" for the channel index waiting for any channel
+pthread_mutex_t comet_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t comet_cond = PTHREAD_COND_INITIALIZER;
+MAP_UUID_CometWaiter comet_waiters;
+MAP_Deadline_CometWaiter comet_deadlines;
+pthread_t comet_thread;
+bool comet_running = false;
+bool comet_stopped = false;
+
+/**
+ * Let MHD continue with the request, call with comet_mutex locked
+ */
+static void comet_resume(CometWaiter *w)
+{
+	comet_waiters.erase(w->_waiting);
+	comet_deadlines.erase(w->_deadline);
+	w->_suspended = false;
+	MHD_resume_connection(w->_connection);
+}
+
+/**
+ * Resume the requests whose timeout expired
+ */
+static void *comet_timeout_thread(void *arg)
+{
+	pthread_mutex_lock(&comet_mutex);
+	while (!comet_stopped) {
+		if (comet_deadlines.empty()) {
+			pthread_cond_wait(&comet_cond, &comet_mutex);
+		} else {
+			const int64_t deadline = comet_deadlines.begin()->first;
+			struct timespec ts;
+			ts.tv_sec = deadline / 1000;
+			ts.tv_nsec = (deadline % 1000) * 1000000;
+			pthread_cond_timedwait(&comet_cond, &comet_mutex, &ts);
 		}
 
-		pthread_mutex_unlock(&localbuffer_mutex);
+		const int64_t now = now_ms();
+		while (!comet_deadlines.empty() && comet_deadlines.begin()->first <= now) {
+			comet_resume(comet_deadlines.begin()->second);
+		}
 	}
+	pthread_mutex_unlock(&comet_mutex);
+	return NULL;
 }
 
-void add_ch_to_localbuffer(Channel &ch)
+/**
+ * Suspend a comet request unless the channel has readings newer than since
+ *
+ * @param uuid of the channel, "" for any channel
+ * @param since last timestamp seen by the client, <0 to wait for the next readings
+ * @return the waiter if the request got suspended, NULL to answer immediately
+ */
+static CometWaiter *comet_wait(struct MHD_Connection *connection, const std::string &uuid, int64_t since)
 {
-	pthread_mutex_lock(&localbuffer_mutex);
-	LIST_ChannelData &l = localbuffer[ch.uuid()];
+	CometWaiter *w = NULL;
 
-	// now add all not-deleted items to the localbuffer:
-	Buffer::Ptr buf = ch.buffer();
-	Buffer::iterator it;
-	for (it = buf->begin(); it != buf->end(); ++it) {
-		Reading &r = *it;
-		if (!r.deleted()) {
-			l.push_back(ChannelData(r.time_ms(), r.value()));
+	// locked before looking at the readings, so no wakeup is lost
+	pthread_mutex_lock(&comet_mutex);
+	const int64_t newest = uuid.empty() ? newest_localbuffer() : newest_localbuffer(uuid.c_str());
+	if (since < 0) since = newest;
+
+	if (newest <= since && !comet_stopped) {
+		if (!comet_running) {
+			if (pthread_create(&comet_thread, NULL, &comet_timeout_thread, NULL) == 0) {
+				comet_running = true;
+			}
+		}
+		if (comet_running) {
+			w = new CometWaiter(connection, since);
+			w->_waiting = comet_waiters.insert(std::make_pair(uuid, w));
+			w->_deadline = comet_deadlines.insert(std::make_pair(now_ms() + 1000 * options.comet_timeout(), w));
+			w->_suspended = true;
+			if (w->_deadline == comet_deadlines.begin()) {
+				pthread_cond_signal(&comet_cond); // earlier than the one the thread waits for
+			}
+			MHD_suspend_connection(connection);
 		}
 	}
-	if (options.buffer_length()<0) { // max size based localbuffer. keep max -buffer_length items
-		while (l.size() > static_cast<unsigned int> (-(options.buffer_length())))
-			l.pop_front();
+	pthread_mutex_unlock(&comet_mutex);
+
+	return w;
+}
+
+/**
+ * Resume the requests waiting for a channel and those waiting for any channel
+ */
+static void comet_wakeup(const char *uuid)
+{
+	pthread_mutex_lock(&comet_mutex);
+	const std::string keys[2] = { uuid, "" };
+	for (int i = 0; i < 2; i++) {
+		std::pair<MAP_UUID_CometWaiter::iterator, MAP_UUID_CometWaiter::iterator> range =
+			comet_waiters.equal_range(keys[i]);
+		while (range.first != range.second) {
+			comet_resume((range.first++)->second);
+		}
 	}
+	pthread_mutex_unlock(&comet_mutex);
+}
 
-	pthread_mutex_unlock(&localbuffer_mutex);
+/**
+ * Client of the /stream endpoint receiving the new readings as Server-Sent Events
+ */
+class StreamClient
+{
+public:
+	StreamClient(struct MHD_Connection *connection, const char *uuid)
+		: _connection(connection), _uuid(uuid ? uuid : ""), _suspended(false) {};
+
+	struct MHD_Connection *_connection;
+	std::string _uuid;		// only events of this channel, "" for all
+	std::string _pending;	// events not yet taken by MHD
+	bool _suspended;		// no events pending, the connection waits in stream_localbuffer()
+};
+
+typedef std::list<StreamClient *> LIST_StreamClient;
+pthread_mutex_t stream_mutex = PTHREAD_MUTEX_INITIALIZER;
+LIST_StreamClient stream_clients;
+bool stream_stopped = false;
+
+static const size_t stream_max_pending = 64 * 1024; // per client, events are dropped while it is exceeded
+
+/**
+ * Call with stream_mutex locked
+ */
+static void stream_resume(StreamClient *c)
+{
+	if (c->_suspended) {
+		c->_suspended = false;
+		MHD_resume_connection(c->_connection);
+	}
 }
 
-json_object * api_json_tuples(const char *uuid) {
+/**
+ * MHD_ContentReaderCallback of a stream
+ */
+static ssize_t stream_reader(void *cls, uint64_t pos, char *buf, size_t max)
+{
+	StreamClient *c = static_cast<StreamClient *>(cls);
+	ssize_t n = 0;
+
+	pthread_mutex_lock(&stream_mutex);
+	if (!c->_pending.empty()) {
+		n = std::min(max, c->_pending.size());
+		memcpy(buf, c->_pending.data(), n);
+		c->_pending.erase(0, n);
+	}
+	else if (stream_stopped) {
+		n = MHD_CONTENT_READER_END_OF_STREAM;
+	}
+	else {
+		// nothing to send: don't keep the worker busy until the next readings arrive
+		c->_suspended = true;
+		MHD_suspend_connection(c->_connection);
+	}
+	pthread_mutex_unlock(&stream_mutex);
 
-	if (!uuid) return NULL;
-	pthread_mutex_lock(&localbuffer_mutex);
-	LIST_ChannelData &l = localbuffer[uuid];
+	return n;
+}
 
-	print(log_debug, "==> number of tuples: %d", uuid, l.size());
+/**
+ * MHD_ContentReaderFreeCallback of a stream, the connection is closed
+ */
+static void stream_free(void *cls)
+{
+	StreamClient *c = static_cast<StreamClient *>(cls);
 
-	if (l.size() < 1 ) {
-		pthread_mutex_unlock(&localbuffer_mutex);
-		return NULL;
+	pthread_mutex_lock(&stream_mutex);
+	stream_clients.remove(c);
+	pthread_mutex_unlock(&stream_mutex);
+
+	delete c;
+}
+
+void stream_localbuffer(Channel &ch)
+{
+	LocalBuffer *lb = find_localbuffer(ch);
+	if (!lb) return;
+
+	pthread_mutex_lock(&stream_mutex);
+	const bool listening = !stream_clients.empty();
+	pthread_mutex_unlock(&stream_mutex);
+
+	// the event is formatted once for all clients
+	JsonWriter json;
+	lb->lock();
+	const RING_ChannelData &l = lb->_data;
+	if (listening) {
+		size_t i = lb->after(lb->_streamed);
+		if (i < l.size()) {
+			json.begin_object();
+			json.key("uuid");
+			json.string(ch.uuid());
+			json.key("tuples");
+			json.begin_array();
+			for (; i < l.size(); i++) {
+				json.tuple(l[i]._t, l[i]._v);
+			}
+			json.end_array();
+			json.end_object();
+		}
 	}
+	lb->_streamed = std::max(lb->_streamed, lb->newest());
+	lb->unlock();
+
+	if (json.size() == 0) return;
+
+	pthread_mutex_lock(&stream_mutex);
+	for (LIST_StreamClient::iterator it = stream_clients.begin(); it != stream_clients.end() && !stream_stopped; ++it) {
+		StreamClient *c = *it;
+		if (!c->_uuid.empty() && c->_uuid != ch.uuid()) continue;
+		if (c->_pending.size() > stream_max_pending) {
+			print(log_debug, "Stream client too slow, dropping event", ch.uuid());
+			continue;
+		}
+		c->_pending.append("event: reading\ndata: ");
+		c->_pending.append(json.c_str(), json.size());
+		c->_pending.append("\n\n");
+		stream_resume(c);
+	}
+	pthread_mutex_unlock(&stream_mutex);
+}
 
-	json_object *json_tuples = json_object_new_array();
-	for (LIST_ChannelData::const_iterator cit = l.cbegin(); cit != l.cend(); ++cit) {
-		struct json_object *json_tuple = json_object_new_array();
+void stop_local_requests()
+{
+	pthread_mutex_lock(&comet_mutex);
+	comet_stopped = true;
+	// MHD requires all connections to be resumed before it is stopped
+	while (!comet_deadlines.empty()) {
+		comet_resume(comet_deadlines.begin()->second);
+	}
+	pthread_cond_signal(&comet_cond);
+	pthread_mutex_unlock(&comet_mutex);
 
-		json_object_array_add(json_tuple, json_object_new_int64(cit->_t));
-		json_object_array_add(json_tuple, json_object_new_double(cit->_v));
+	if (comet_running) {
+		pthread_join(comet_thread, NULL);
+		comet_running = false;
+	}
 
-		json_object_array_add(json_tuples, json_tuple);
+	pthread_mutex_lock(&stream_mutex);
+	stream_stopped = true;
+	for (LIST_StreamClient::iterator it = stream_clients.begin(); it != stream_clients.end(); ++it) {
+		stream_resume(*it); // ends the stream
 	}
-	pthread_mutex_unlock(&localbuffer_mutex);
+	pthread_mutex_unlock(&stream_mutex);
+}
 
-	return json_tuples;
+void request_completed(
+	void *cls
+	, struct MHD_Connection *connection
+	, void **con_cls
+	, enum MHD_RequestTerminationCode toe
+	) {
+	CometWaiter *w = static_cast<CometWaiter *>(*con_cls);
+	if (w) {
+		pthread_mutex_lock(&comet_mutex);
+		if (w->_suspended) {
+			comet_waiters.erase(w->_waiting);
+			comet_deadlines.erase(w->_deadline);
+		}
+		pthread_mutex_unlock(&comet_mutex);
+		delete w;
+		*con_cls = NULL;
+	}
+}
+
+void expire_ch_localbuffer(Channel &ch)
+{
+	LocalBuffer *lb = find_localbuffer(ch);
+	if (!lb) return;
+
+	lb->lock();
+	expire_localbuffer(*lb);
+	lb->unlock();
+
+	comet_wakeup(ch.uuid());
+}
+
+/**
+ * Add the buffered tuples of a channel as "tuples" member, if there are any
+ */
+void api_json_tuples(JsonWriter &json, Channel &ch, const TupleQuery &query) {
+
+	LocalBuffer *lb = find_localbuffer(ch);
+	if (!lb) return;
+
+	std::vector<size_t> selected;
+	lb->lock();
+	expire_localbuffer(*lb); // in case the channel returns very few/seldom data
+	lb->select(query, selected);
+
+	print(log_debug, "==> number of tuples: %d", ch.uuid(), selected.size());
+
+	if (!selected.empty()) {
+		const RING_ChannelData &l = lb->_data;
+		json.key("tuples");
+		json.begin_array();
+		for (size_t i = 0; i < selected.size(); i++) {
+			json.tuple(l[selected[i]]._t, l[selected[i]]._v);
+		}
+		json.end_array();
+	}
+	lb->unlock();
 }
 
 
@@ -142,78 +501,135 @@ int handle_request(
 	// mapping between meters and channels
 	MapContainer *mappings = static_cast<MapContainer*>(cls);
 
-	struct MHD_Response *response;
+	struct MHD_Response *response = NULL;
 	const char *mode = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "mode");
+	const char *since_str = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "since");
+	const char *from_str = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "from");
+	const char *to_str = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "to");
+	const char *limit_str = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "limit");
+	const char *points_str = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "points");
+
+	// called again after a suspended comet request got resumed
+	CometWaiter *waiter = static_cast<CometWaiter *>(*con_cls);
+	*con_cls = NULL;
 
 	try {
 		print(log_info, "Local request received: method=%s url=%s mode=%s",
 					"http", method, url, mode);
 
-		if (strcmp(method, "GET") == 0) {
+		if (strcmp(method, "GET") == 0 && strcmp(url, "/stream") == 0) {
+			if (options.local_workers() > 0) {
+				// Server-Sent Events for each new reading, optionally of a single channel
+				StreamClient *c = new StreamClient(connection,
+					MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "uuid"));
+				c->_pending = ": vzlogger\n\n";
+
+				pthread_mutex_lock(&stream_mutex);
+				stream_clients.push_back(c);
+				pthread_mutex_unlock(&stream_mutex);
+
+				response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, 1024, &stream_reader, c, &stream_free);
+				response_code = MHD_HTTP_OK;
+
+				MHD_add_response_header(response, "Content-type", "text/event-stream");
+				MHD_add_response_header(response, "Cache-Control", "no-cache");
+			}
+			else {
+				char *response_str = strdup("streaming requires local workers\n");
+
+				response = MHD_create_response_from_data(strlen(response_str), (void *) response_str, TRUE, FALSE);
+				response_code = MHD_HTTP_SERVICE_UNAVAILABLE;
+
+				MHD_add_response_header(response, "Content-type", "text/text");
+			}
+		}
+		else if (strcmp(method, "GET") == 0) {
 
-			struct json_object *json_obj = json_object_new_object();
-			struct json_object *json_data = json_object_new_array();
-			struct json_object *json_exception = NULL;
+			JsonWriter json;
 
 			const char *uuid = url + 1; // strip leading slash
-			const char *json_str;
 			int show_all = 0;
+			bool index_disabled = false;
 
 			if (strcmp(url, "/") == 0) {
 				if (options.channel_index()) {
 					show_all = TRUE;
 				}
 				else {
-					json_exception = json_object_new_object();
+					index_disabled = true;
+				}
+			}
 
-					json_object_object_add(json_exception, "message", json_object_new_string("channel index is disabled"));
-					json_object_object_add(json_exception, "code", json_object_new_int(0));
+			// only readings newer than the last timestamp seen by the client
+			int64_t since = since_str ? strtoll(since_str, NULL, 10) : 0;
+
+			if (waiter) {
+				since = waiter->_since;
+				delete waiter;
+			}
+			else if (mode && strcmp(mode, "comet") == 0 && !index_disabled
+					 && options.comet_timeout() > 0 && options.local_workers() > 0) {
+				// blocking until new data arrives (comet-like blocking of HTTP response)
+				// without holding a worker: the connection is suspended until then
+				waiter = comet_wait(connection, show_all ? "" : uuid, since_str ? since : -1);
+				if (waiter) {
+					*con_cls = waiter;
+					return MHD_YES;
 				}
 			}
 
-			shrink_localbuffer(); // in case the channel return very few/seldom data
+			// range and size of the tuples
+			TupleQuery query;
+			if (from_str) query._from = strtoll(from_str, NULL, 10);
+			if (to_str) query._to = strtoll(to_str, NULL, 10);
+			if (limit_str) query._limit = std::max(0ll, strtoll(limit_str, NULL, 10));
+			if (points_str) query._points = std::max(0ll, strtoll(points_str, NULL, 10));
+			query._from = std::max(query._from, since + 1);
+
+			json.begin_object();
+			json.key("version");
+			json.string(VERSION);
+			json.key("generator");
+			json.string(PACKAGE);
+			json.key("data");
+			json.begin_array();
 
 			for (MapContainer::iterator mapping = mappings->begin(); mapping!=mappings->end(); mapping++) {
 				for (MeterMap::iterator ch = mapping->begin(); ch!=mapping->end(); ch++) {
 					if (strcmp((*ch)->uuid(), uuid) == 0 || show_all) {
 						response_code = MHD_HTTP_OK;
 
-// blocking until new data arrives (comet-like blocking of HTTP response)
-						if (mode && strcmp(mode, "comet") == 0) {
-// TODO wait only options.comet_timeout()!
-//							gettimeofday(&tp, NULL);
-//							ts.tv_sec  = tp.tv_sec + options.comet_timeout();
-//							ts.tv_nsec = tp.tv_usec * 1000;
+						json.begin_object();
+						json.key("uuid");
+						json.string((*ch)->uuid());
+						json.key("last");
+						json.integer((*ch)->time_ms()); // return here in ms as well
+						json.key("interval");
+						json.integer(mapping->meter()->interval());
+						json.key("protocol");
+						json.string(meter_get_details(mapping->meter()->protocolId())->name);
 
-//							(*ch)->wait(); // TODO not usefull with show_all! Wait only if this channel empty?
-						}
+						api_json_tuples(json, *(*ch), query);
 
-						struct json_object *json_ch = json_object_new_object();
-
-						json_object_object_add(json_ch, "uuid", json_object_new_string((*ch)->uuid()));
-						json_object_object_add(json_ch, "last", json_object_new_int64((*ch)->time_ms())); // return here in ms as well
-						json_object_object_add(json_ch, "interval", json_object_new_int(mapping->meter()->interval()));
-						json_object_object_add(json_ch, "protocol", json_object_new_string(meter_get_details(mapping->meter()->protocolId())->name));
-
-						struct json_object *json_tuples = api_json_tuples((*ch)->uuid());
-						if (json_tuples) json_object_object_add(json_ch, "tuples", json_tuples);
-
-						json_object_array_add(json_data, json_ch);
+						json.end_object();
 					}
 				}
 			}
 
-			json_object_object_add(json_obj, "version", json_object_new_string(VERSION));
-			json_object_object_add(json_obj, "generator", json_object_new_string(PACKAGE));
-			json_object_object_add(json_obj, "data", json_data);
+			json.end_array();
 
-			if (json_exception) {
-				json_object_object_add(json_obj, "exception", json_exception);
+			if (index_disabled) {
+				json.key("exception");
+				json.begin_object();
+				json.key("message");
+				json.string("channel index is disabled");
+				json.key("code");
+				json.integer(0);
+				json.end_object();
 			}
+			json.end_object();
 
-			json_str = json_object_to_json_string(json_obj);
-			response = MHD_create_response_from_data(strlen(json_str), (void *) json_str, FALSE, TRUE);
-			json_object_put(json_obj);
+			response = MHD_create_response_from_data(json.size(), (void *) json.c_str(), FALSE, TRUE);
 
 			MHD_add_response_header(response, "Content-type", "application/json");
 		}
@@ -226,6 +642,12 @@ int handle_request(
 			MHD_add_response_header(response, "Content-type", "text/text");
 		}
 	} catch (std::exception &e) {
+		print(log_error, "Local request failed: %s", "http", e.what());
+		if (response) MHD_destroy_response(response);
+
+		char *response_str = strdup("internal error\n");
+		response = MHD_create_response_from_data(strlen(response_str), (void *) response_str, TRUE, FALSE);
+		response_code = MHD_HTTP_INTERNAL_SERVER_ERROR;
 	}
 
 	status = MHD_queue_response(connection, response_code, response);
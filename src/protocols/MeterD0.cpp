@@ -701,8 +701,7 @@ ssize_t MeterD0::read(std::vector<Reading>& rds, size_t max_readings) {
 
 					try {
 						Obis obis(obis_code);
-						ReadingIdentifier *rid(new ObisIdentifier(obis));
-						rds[number_of_tuples].identifier(rid);
+						rds[number_of_tuples].key(_keys.key(obis));
 						rds[number_of_tuples].time();
 						number_of_tuples++;
 					} catch (vz::VZException &e) {
@@ -163,8 +163,7 @@ ssize_t MeterFile::read(std::vector<Reading> &rds, size_t n) {
 
 
 			rds[i].value(value);
-			ReadingIdentifier *rid(new StringIdentifier(string ? string : "<null>"));
-			rds[i].identifier(rid);
+			rds[i].key(_keys.key(string ? string : "<null>"));
 			if (found >= 1) {
 				if (timestamp >=0.0)
 					rds[i].time_from_double(timestamp);
@@ -180,8 +179,7 @@ ssize_t MeterFile::read(std::vector<Reading> &rds, size_t n) {
 		else { // just reading a value per line
 			rds[i].value(strtod(line, &endptr));
 			rds[i].time();
-			ReadingIdentifier* rid(new StringIdentifier(""));
-			rds[i].identifier(rid);
+			rds[i].key(_keys.key(""));
 
 			if (endptr != line) {
 				i++; // read successfully
@@ -99,16 +99,14 @@ ssize_t MeterFluksoV2::read(std::vector<Reading> &rds, size_t n) {
 		int channel = atoi(strsep(&cursor, " \t")) + 1; /* increment by 1 to distinguish between +0 and -0 */
 
 		/* consumption - gets negative channel id as identifier! */
-		ReadingIdentifier *rid1(new ChannelIdentifier(-channel));
 		rds[i].time(time);
-		rds[i].identifier(rid1);
+		rds[i].key(_keys.key(-channel));
 		rds[i].value(atoi(strsep(&cursor, " \t")));
 		i++;
 
 		/* power - gets positive channel id as identifier! */
-		ReadingIdentifier *rid2(new ChannelIdentifier(channel));
 		rds[i].time(time);
-		rds[i].identifier(rid2);
+		rds[i].key(_keys.key(channel));
 		rds[i].value(atoi(strsep(&cursor, " \t")));
 		i++;
 	}
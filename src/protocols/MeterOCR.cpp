@@ -1459,14 +1459,14 @@ ssize_t MeterOCR::read(std::vector<Reading> &rds, size_t max_reads) {
 				} else {
 					rds[i].value(r.value);
 				}
-				rds[i].identifier(new StringIdentifier(it->first));
+				rds[i].key(_keys.key(it->first));
 				rds[i].time();
 				i++;
 				if (i>=max_reads) break;
 			} else wasNAN = true;
 			if (r.conf_id.length()>0){
 				rds[i].value(r.min_conf);
-				rds[i].identifier(new StringIdentifier(r.conf_id));
+				rds[i].key(_keys.key(r.conf_id));
 				rds[i].time();
 				i++;
 				if (i>=max_reads) break;
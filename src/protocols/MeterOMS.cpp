@@ -134,6 +134,10 @@ MeterOMS::MeterOMS(const std::list<Option> &options, OMSHWif *hwif) :
   , _aes_key(0)
   , _mbus_debug(false)
   , _last_timestamp(0.0)
+  , _key_1_8_0(ReadingIdentifierRegistry::instance().intern(ReadingIdentifier::Ptr(new ObisIdentifier("1.8.0"))))
+  , _key_2_8_0(ReadingIdentifierRegistry::instance().intern(ReadingIdentifier::Ptr(new ObisIdentifier("2.8.0"))))
+  , _key_1_7_0(ReadingIdentifierRegistry::instance().intern(ReadingIdentifier::Ptr(new ObisIdentifier("1.7.0"))))
+  , _key_2_7_0(ReadingIdentifierRegistry::instance().intern(ReadingIdentifier::Ptr(new ObisIdentifier("2.7.0"))))
 {
 	OptionList optlist;
 	// todo parse from options for tcp or uart... if (!_hwif) ->
@@ -340,7 +344,7 @@ ssize_t MeterOMS::read(std::vector<Reading> &rds, size_t n)
 												  get_record_value(record),
 												  mbus_vib_unit_lookup(&(record->drh.vib)));
 											if (ret<n) {
-												rds[ret].identifier(new ObisIdentifier("1.8.0"));
+												rds[ret].key(_key_1_8_0);
 												rds[ret].value(get_record_value(record));
 												if (timeFromMeter>1.0)
 													rds[ret].time_from_double(timeFromMeter);
@@ -356,7 +360,7 @@ ssize_t MeterOMS::read(std::vector<Reading> &rds, size_t n)
 												  get_record_value(record),
 												  mbus_vib_unit_lookup(&(record->drh.vib)));
 											if (ret < n) {
-												rds[ret].identifier(new ObisIdentifier("2.8.0"));
+												rds[ret].key(_key_2_8_0);
 												rds[ret].value(get_record_value(record));
 												if (timeFromMeter>1.0)
 													rds[ret].time_from_double(timeFromMeter);
@@ -372,7 +376,7 @@ ssize_t MeterOMS::read(std::vector<Reading> &rds, size_t n)
 												  get_record_value(record),
 												  mbus_vib_unit_lookup(&(record->drh.vib)));
 											if (ret < n) {
-												rds[ret].identifier(new ObisIdentifier("1.7.0"));
+												rds[ret].key(_key_1_7_0);
 												rds[ret].value(get_record_value(record));
 												if (timeFromMeter>1.0)
 													rds[ret].time_from_double(timeFromMeter);
@@ -388,7 +392,7 @@ ssize_t MeterOMS::read(std::vector<Reading> &rds, size_t n)
 												  get_record_value(record),
 												  mbus_vib_unit_lookup(&(record->drh.vib)));
 											if (ret < n) {
-												rds[ret].identifier(new ObisIdentifier("2.7.0"));
+												rds[ret].key(_key_2_7_0);
 												rds[ret].value(get_record_value(record));
 												if (timeFromMeter>1.0)
 													rds[ret].time_from_double(timeFromMeter);
@@ -37,6 +37,7 @@
 
 MeterRandom::MeterRandom(std::list<Option> options)
 		: Protocol("random")
+		, _key(ReadingIdentifierRegistry::instance().intern(ReadingIdentifier::Ptr(new NilIdentifier())))
 {
 	OptionList optlist;
 
@@ -90,7 +91,7 @@ ssize_t MeterRandom::read(std::vector<Reading> &rds, size_t n) {
 
 	rds[0].value(_last);
 	rds[0].time();
-	rds[0].identifier(new NilIdentifier());
+	rds[0].key(_key);
 
 	return 1;
 }
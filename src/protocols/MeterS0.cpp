@@ -46,6 +46,10 @@ MeterS0::MeterS0(std::list<Option> options, HWIF *hwif, HWIF *hwif_dir)
 		, _debounce_delay_ms(0)
 		, _nonblocking_delay_ns(1e5)
 		, _first_impulse(true)
+		, _key_power(ReadingIdentifierRegistry::instance().intern(ReadingIdentifier::Ptr(new StringIdentifier("Power"))))
+		, _key_impulse(ReadingIdentifierRegistry::instance().intern(ReadingIdentifier::Ptr(new StringIdentifier("Impulse"))))
+		, _key_power_neg(ReadingIdentifierRegistry::instance().intern(ReadingIdentifier::Ptr(new StringIdentifier("Power_neg"))))
+		, _key_impulse_neg(ReadingIdentifierRegistry::instance().intern(ReadingIdentifier::Ptr(new StringIdentifier("Impulse_neg"))))
 {
 	OptionList optlist;
 
@@ -323,12 +327,12 @@ ssize_t MeterS0::read(std::vector<Reading> &rds, size_t n) {
 	if (_send_zero || t_imp > 0) {
 		if (!_first_impulse) {
 			double value = (3600000 / ((t2-t1) * _resolution)) * t_imp;
-			rds[ret].identifier(new StringIdentifier("Power"));
+			rds[ret].key(_key_power);
 			rds[ret].time(req);
 			rds[ret].value(value);
 			++ret;
 		}
-		rds[ret].identifier(new StringIdentifier("Impulse"));
+		rds[ret].key(_key_impulse);
 		rds[ret].time(req);
 		rds[ret].value(t_imp);
 		++ret;
@@ -337,12 +341,12 @@ ssize_t MeterS0::read(std::vector<Reading> &rds, size_t n) {
 	if (_send_zero || t_imp_neg > 0) {
 		if (!_first_impulse) {
 			double value = (3600000 / ((t2-t1) * _resolution)) * t_imp_neg;
-			rds[ret].identifier(new StringIdentifier("Power_neg"));
+			rds[ret].key(_key_power_neg);
 			rds[ret].time(req);
 			rds[ret].value(value);
 			++ret;
 		}
-		rds[ret].identifier(new StringIdentifier("Impulse_neg"));
+		rds[ret].key(_key_impulse_neg);
 		rds[ret].time(req);
 		rds[ret].value(t_imp_neg);
 		++ret;
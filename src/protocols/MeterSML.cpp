@@ -260,8 +260,7 @@ bool MeterSML::_parse(sml_list *entry, Reading *rd) {
 			rd->value(sml_value_to_double(entry->value) * pow(10, scaler));
 		}
 
-		ReadingIdentifier *rid(new ObisIdentifier(obis));
-		rd->identifier(rid);
+		rd->key(_keys.key(obis));
 
 		// TODO handle SML_TIME_SEC_INDEX or time by SML File/Message
 		struct timeval tv;
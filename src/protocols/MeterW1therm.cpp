@@ -134,7 +134,7 @@ ssize_t MeterW1therm::read(std::vector<Reading> &rds, size_t n)
 		double value;
 		if (_hwif->readTemp(*it, value)) {
 			print(log_finest, "reading w1 device %s returned %f", name().c_str(), (*it).c_str(), value);
-			rds[ret].identifier(new StringIdentifier(*it));
+			rds[ret].key(_keys.key(*it));
 			rds[ret].time();
 			rds[ret].value(value);
 			++ret;
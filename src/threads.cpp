@@ -95,37 +95,28 @@ void * reading_thread(void *arg) {
 //				}
 
 				/* insert readings into channel queues */
-				if (n>0)
-				for (MeterMap::iterator ch = mapping->begin(); ch!=mapping->end(); ch++) {
-					Reading *add = NULL;
+				for (size_t i = 0; i < n; i++) {
+					const std::vector<Channel::Ptr> *channels = mapping->channels(rds[i].key());
+					if (channels == NULL) continue; // no channel uses this identifier
 
-					//print(log_debug, "Check channel %s, n=%d", mtr->name(), ch->name(), n);
+					for (std::vector<Channel::Ptr>::const_iterator ch = channels->begin(); ch != channels->end(); ch++) {
+						if ((*ch)->time_ms() < rds[i].time_ms()) {
+							(*ch)->last(&rds[i]);
+						}
 
-					for (size_t i = 0; i < n; i++) {
-						if (*rds[i].identifier().get() == *(*ch)->identifier().get()) {
-							//print(log_debug, "found channel", mtr->name());
-							if ((*ch)->time_ms() < rds[i].time_ms()) {
-								(*ch)->last(&rds[i]);
-							}
-
-							print(log_info, "Adding reading to queue (value=%.2f ts=%lld)", (*ch)->name(),
-									rds[i].value(), rds[i].time_ms());
-							(*ch)->push(rds[i]);
-
-							// provide data to push data server:
-							if (pushDataList) {
-								const std::string uuid = (*ch)->uuid();
-								pushDataList->add(uuid, rds[i].time_ms(), rds[i].value());
-								print(log_finest, "added to uuid %s", "push", uuid.c_str());
-							}
-
-							if (add == NULL) {
-								add = &rds[i]; /* remember first reading which has been added to the buffer */
-							}
+						print(log_info, "Adding reading to queue (value=%.2f ts=%lld)", (*ch)->name(),
+								rds[i].value(), rds[i].time_ms());
+						(*ch)->push(rds[i]);
+
+						// provide data to push data server:
+						if (pushDataList) {
+							if ((*ch)->push_id() < 0)
+								(*ch)->push_id(pushDataList->id((*ch)->uuid()));
+							pushDataList->add((*ch)->push_id(), rds[i].time_ms(), rds[i].value());
+							print(log_finest, "added to uuid %s", "push", (*ch)->uuid());
 						}
 					}
-
-				} // channel loop
+				} // reading loop
 			} while((mtr->aggtime() > 0) && (time(NULL) < aggIntEnd)); /* default aggtime is -1 */
 
 			for (MeterMap::iterator ch = mapping->begin(); ch!=mapping->end(); ch++) {
@@ -139,8 +130,7 @@ void * reading_thread(void *arg) {
 				(*ch)->buffer()->clean();
 #ifdef LOCAL_SUPPORT
 				if (options.local()) {
-					shrink_localbuffer(); // remove old/outdated data in the local buffer
-					add_ch_to_localbuffer(*(*ch)); // add this ch data to the local buffer
+					expire_ch_localbuffer(*(*ch)); // the readings were added as stored, removes the outdated ones
 				}
 #endif
 				/* notify webserver and logging thread */
@@ -186,56 +176,35 @@ void * reading_thread(void *arg) {
 	}
 
 	print(log_debug, "Stopped reading. ", mtr->name());
+
+	// the compressor may still hold back the last reading
+	for (MeterMap::iterator ch = mapping->begin(); ch != mapping->end(); ch++) {
+		if ((*ch)->buffer()->flush()) {
+			(*ch)->buffer()->have_newValues();
+			(*ch)->notify();
+		}
+	}
 	//pthread_cleanup_pop(1);
 
 	pthread_exit(0);
 	return NULL;
 }
 
-void logging_thread_cleanup(/*void *arg*/) {
-//	api_handle_t *api = (api_handle_t *) arg;
-
-//	api_free(api);
-}
-
-void * logging_thread(void *arg) {
-	Channel::Ptr ch;
-	ch.reset(static_cast<Channel *>(arg)); /* casting argument */
-	print(log_debug, "Start logging thread for %s-api. Running as daemon: %s", ch->name(),
-				ch->apiProtocol().c_str(), options.daemon() ? "yes" : "no");
-
+vz::ApiIF::Ptr create_api(Channel::Ptr ch, size_t sink) {
 	// create configured api interfaces
-	// NOTE: if additional APIs are introduced both threads.cpp and MeterMap.cpp need to be updated
 	vz::ApiIF::Ptr api;
-	if (ch->apiProtocol() == "mysmartgrid") {
-		api =  vz::ApiIF::Ptr(new vz::api::MySmartGrid(ch, ch->options()));
+	const Channel::Sink &s = ch->sink(sink);
+	if (s.api == "mysmartgrid") {
+		api =  vz::ApiIF::Ptr(new vz::api::MySmartGrid(ch, s.options));
 		print(log_debug, "Using MySmartGrid api.", ch->name());
 	}
-	else if (ch->apiProtocol() == "null") {
-		api =  vz::ApiIF::Ptr(new vz::api::Null(ch, ch->options()));
+	else if (s.api == "null") {
+		api =  vz::ApiIF::Ptr(new vz::api::Null(ch, s.options));
 		print(log_debug, "Using null api- meter data available via local httpd if enabled.", ch->name());
 	} else {
 		// default == volkszaehler
-		api =  vz::ApiIF::Ptr(new vz::api::Volkszaehler(ch, ch->options()));
+		api =  vz::ApiIF::Ptr(new vz::api::Volkszaehler(ch, s.options));
 		print(log_debug, "Using default volkszaehler api.", ch->name());
 	}
-
-	//pthread_cleanup_push(&logging_thread_cleanup, &api);
-
-	do { /* start thread mainloop */
-		try {
-			ch->wait();
-			api->send();
-		}
-		catch (std::exception &e) {
-			print(log_error, "Logging thread failed due to: %s", ch->name(), e.what());
-		}
-
-	} while (options.logging());
-
-	print(log_debug, "Stopped logging. (daemon=%d)", ch->name(), options.daemon());
-	pthread_exit(0);
-	//pthread_cleanup_pop(1);
-
-	return NULL;
+	return api;
 }
@@ -38,6 +38,7 @@
 #include <fcntl.h>
 
 #include <list>
+#include <set>
 
 #include <Config_Options.hpp>
 #include <Meter.hpp>
@@ -46,6 +47,9 @@
 #include "Channel.hpp"
 #include "threads.h"
 #include "CurlSessionProvider.hpp"
+#include "CurlMulti.hpp"
+#include "CurlShare.hpp"
+#include "UploadPool.hpp"
 #include "PushData.hpp"
 
 #ifdef LOCAL_SUPPORT
@@ -376,7 +380,8 @@ int main(int argc, char *argv[]) {
 
 	print(log_error, "log level is %d", "main", options.verbosity());
 
-	curlSessionProvider = new CurlSessionProvider();
+	curlShare = new CurlShare();
+	curlSessionProvider = new CurlSessionProvider(options.upload_connections());
 
 	// Register vzlogger
 	if (options.doRegistration()) {
@@ -415,8 +420,35 @@ int main(int argc, char *argv[]) {
 		return EXIT_FAILURE;
 	}
 
+	// asynchronous transport shared by all apis (has to be started after daemonizing)
+	try {
+		curlMulti = new CurlMulti(options.upload_connections());
+	} catch (std::exception &e) {
+		print(log_error, "Startup failed: %s", "", e.what());
+		return EXIT_FAILURE;
+	}
+
+	if (options.upload_prewarm() && options.logging()) {
+		// open the connections to all middlewares, so the first uploads don't pay for the handshakes
+		std::set<std::string> middlewares;
+		for (MapContainer::iterator it = mappings.begin(); it != mappings.end(); it++) {
+			if (!it->meter()->isEnabled()) continue;
+			for (MeterMap::iterator ch = it->begin(); ch != it->end(); ch++) {
+				for (size_t i = 0; i < (*ch)->sinks(); i++) {
+					try {
+						const Channel::Sink &sink = (*ch)->sink(i);
+						if (sink.api != "null") {
+							middlewares.insert(OptionList().lookup_string(sink.options, "middleware"));
+						}
+					} catch (vz::VZException &e) { }
+				}
+			}
+		}
+		curlShare->prewarm(std::list<std::string>(middlewares.begin(), middlewares.end()));
+	}
+
 	if (options.pushDataServer()) {
-		pushDataList = new PushDataList();
+		pushDataList = new PushDataList(options.push_buffer_size(), options.push_buffer_policy());
 		int ret = pthread_create(&_pushdata_thread, NULL, push_data_thread, (void *)options.pushDataServer()); // todo error handling?
 		if (ret)
 			print(log_error, "Error %d creating pushdata_thread!", "push", ret);
@@ -428,6 +460,20 @@ int main(int argc, char *argv[]) {
 
 	print(log_debug, "===> Start meters", "");
 	try {
+		// shared upload threads for all channels
+		if (options.logging()) {
+			uploadPool = new UploadPool(options.upload_workers(), options.upload_connections(),
+										options.retry_pause(), &create_api, options.upload_batch_window(),
+										options.upload_retry_max(), options.upload_breaker());
+		}
+
+#ifdef LOCAL_SUPPORT
+		// the buffers of the local interface are indexed before the meters add readings
+		if (options.local()) {
+			init_localbuffer(mappings);
+		}
+#endif /* LOCAL_SUPPORT */
+
 		// open connection meters & start threads
 		for (MapContainer::iterator it = mappings.begin(); it != mappings.end(); it++) {
 			it->start();
@@ -446,13 +492,58 @@ int main(int argc, char *argv[]) {
 		// start webserver for local interface
 		if (options.local()) {
 			print(log_info, "Starting local interface HTTPd on port %i", "http", options.port());
+
+			// a pool of event driven workers instead of a thread per connection
+			struct MHD_OptionItem httpd_options[4];
+			int n = 0;
+			unsigned int flags = MHD_USE_THREAD_PER_CONNECTION;
+			unsigned int fallback = MHD_USE_SELECT_INTERNALLY;
+			if (options.local_workers() > 0) {
+				// comet requests are suspended until their channel has new readings
+				flags = LOCAL_EPOLL_FLAGS | LOCAL_SUSPEND_FLAGS;
+				fallback |= LOCAL_SUSPEND_FLAGS;
+				httpd_options[n].option = MHD_OPTION_THREAD_POOL_SIZE;
+				httpd_options[n].value = options.local_workers();
+				httpd_options[n++].ptr_value = NULL;
+			}
+			if (options.local_connections() > 0) {
+				httpd_options[n].option = MHD_OPTION_CONNECTION_LIMIT;
+				httpd_options[n].value = options.local_connections();
+				httpd_options[n++].ptr_value = NULL;
+			}
+			httpd_options[n].option = MHD_OPTION_NOTIFY_COMPLETED;
+			httpd_options[n].value = (intptr_t) &request_completed;
+			httpd_options[n++].ptr_value = NULL;
+			httpd_options[n].option = MHD_OPTION_END;
+			httpd_options[n].value = 0;
+			httpd_options[n].ptr_value = NULL;
+
 			httpd_handle = MHD_start_daemon(
-				MHD_USE_THREAD_PER_CONNECTION,
+				flags,
 				options.port(),
 				NULL, NULL,
 				&handle_request, (void*)&mappings,
+				MHD_OPTION_ARRAY, httpd_options,
 				MHD_OPTION_END
 				);
+			if (httpd_handle == NULL && flags != MHD_USE_THREAD_PER_CONNECTION) {
+				print(log_warning, "epoll not available, falling back to select", "http");
+				httpd_handle = MHD_start_daemon(
+					fallback,
+					options.port(),
+					NULL, NULL,
+					&handle_request, (void*)&mappings,
+					MHD_OPTION_ARRAY, httpd_options,
+					MHD_OPTION_END
+					);
+			}
+			if (httpd_handle == NULL) {
+				print(log_error, "Cannot start local interface HTTPd on port %i", "http", options.port());
+			} else {
+				print(log_debug, "Local interface HTTPd: %d workers, max. %d connections", "http",
+					  options.local_workers(), options.local_connections());
+				Channel::listener(&stream_localbuffer);
+			}
 		}
 #endif /* LOCAL_SUPPORT */
 	} catch (std::exception &e) {
@@ -474,10 +565,19 @@ int main(int argc, char *argv[]) {
 	}
 	print(log_debug, "Server stopped.", "");
 
+	if (uploadPool) {
+		print(log_finest, "Waiting for upload workers to stop...", "");
+		delete uploadPool;
+		uploadPool = 0;
+		print(log_finest, "upload workers stopped", "");
+	}
+
 #ifdef LOCAL_SUPPORT
 	/* stop webserver */
 	if (httpd_handle) {
 		print(log_finest, "Waiting for httpd to stop...", "");
+		Channel::listener(NULL);
+		stop_local_requests();
 		MHD_stop_daemon(httpd_handle);
 		print(log_finest, "httpd stopped", "");
 	}
@@ -500,13 +600,33 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
+	if (curlMulti) {
+		print(log_finest, "Waiting for curl transport to stop...", "");
+		delete curlMulti;
+		curlMulti = 0;
+		print(log_finest, "curl transport stopped", "");
+	}
+
+	if (options.pushDataServer()) {
+		// its own curl handles use curlShare, the server itself is deleted with the options
+		options.pushDataServer()->release();
+	}
+
 	if (curlSessionProvider) {
+		CurlSessionProvider::Stats stats = curlSessionProvider->stats();
+		print(log_debug, "curl sessions: %d created, %d evicted, %d waits (%.3fs total, %.3fs max)", "main",
+			  stats.created, stats.evicted, stats.waits, stats.wait_total, stats.wait_max);
 		print(log_finest, "Trying to delete curlSessionProvider...", "");
 		delete curlSessionProvider;
 		curlSessionProvider = 0;
 		print(log_finest, "deleted curlSessionProvider", "");
 	}
 
+	if (curlShare) {
+		delete curlShare;
+		curlShare = 0;
+	}
+
 	/* close logfile */
 	if (options.logfd()) {
 		fclose(options.logfd());
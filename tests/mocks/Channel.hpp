@@ -7,13 +7,18 @@
 #include "Options.hpp"
 #include "Reading.hpp"
 #include "Buffer.hpp"
+#include "Journal.hpp"
 
 class Channel
 {
 public:
 	typedef vz::shared_ptr<Channel> Ptr;
-	Channel() : mock_buf(new Buffer()){};
-	Channel(const std::list<Option> &pOptions, const std::string api, const std::string pUuid, ReadingIdentifier::Ptr pIdentifier) : mock_buf(new Buffer()){};
+	struct Sink {
+		std::string api;
+		std::list<Option> options;
+	};
+	Channel() : mock_buf(new Buffer()), mock_journal(new Journal()){};
+	Channel(const std::list<Option> &pOptions, const std::string api, const std::string pUuid, ReadingIdentifier::Ptr pIdentifier) : mock_buf(new Buffer()), mock_journal(new Journal()){};
 	MOCK_METHOD0( start, void());
 	MOCK_METHOD0( join, void());
 	MOCK_METHOD0( cancel, void());
@@ -21,21 +26,31 @@ public:
 	MOCK_METHOD0( options, std::list<Option> &());
 	MOCK_METHOD0( apiProtocol, const std::string());
 	MOCK_METHOD0( buffer, Buffer::Ptr());
+	MOCK_METHOD0( journal, Journal::Ptr());
+	MOCK_CONST_METHOD0( sinks, size_t ());
+	MOCK_CONST_METHOD1( sink, const Sink &(size_t i));
+	MOCK_METHOD1( sinks, void (const std::vector<Sink> &sinks));
 	MOCK_METHOD0( identifier, ReadingIdentifier::Ptr());
+	MOCK_CONST_METHOD0( identifier_key, uint32_t ());
 	MOCK_CONST_METHOD0( time_ms, int64_t ());
 	MOCK_METHOD1( last, void (Reading *rd));
 	MOCK_METHOD1( push, void (const Reading &rd));
 	MOCK_METHOD0( notify, void ());
 	MOCK_METHOD2( dump, char* (char *dump, size_t len));
 	MOCK_CONST_METHOD0( size, size_t ());
-	MOCK_METHOD0( wait, void ());
 	MOCK_METHOD0( uuid, const char* ());
 	MOCK_CONST_METHOD0( duplicates, int ());
+	MOCK_CONST_METHOD0( push_id, int ());
+	MOCK_METHOD1( push_id, void (int id));
+	MOCK_CONST_METHOD0( local_id, int ());
+	MOCK_METHOD1( local_id, void (int id));
 
 	ReadingIdentifier::Ptr &real_id() {return mock_id;}
 	ReadingIdentifier::Ptr mock_id;
 	Buffer::Ptr mock_buf;
 	Buffer::Ptr &real_buf() {return mock_buf;}
+	Journal::Ptr mock_journal;
+	Journal::Ptr &real_journal() {return mock_journal;}
 };
 
 #endif
@@ -92,7 +92,7 @@ TEST(mock_metermap, one_channel)
 	MeterMap m (mtr);
 	Channel *ch = new Channel();
 	EXPECT_CALL(*ch, name()).Times(AtLeast(1));
-	EXPECT_CALL(*ch, identifier()).Times(AtLeast(1)).WillRepeatedly(Return(ReadingIdentifier::Ptr()));
+	EXPECT_CALL(*ch, identifier_key()).Times(AtLeast(1)).WillRepeatedly(Return(0u));
 	EXPECT_CALL(*ch, buffer()).Times(AtLeast(1)).WillRepeatedly(Invoke(ch, &Channel::real_buf));
 	EXPECT_CALL(*ch, notify()).Times(AtLeast(0)); // can be called 0 or sometimes
 	{
@@ -111,6 +111,34 @@ TEST(mock_metermap, one_channel)
 	EXPECT_FALSE(m.stopped()); // TODO this looks like a bug!
 }
 
+// the dispatch table maps each identifier key to all channels using it:
+TEST(mock_metermap, dispatch_table)
+{
+	std::list<Option> o;
+	o.push_back((Option("protocol", "random")));
+	MeterMap m(new mock_meter(o));
+
+	uint32_t k1 = ReadingIdentifierRegistry::instance().intern(ReadingIdentifier::Ptr(new ChannelIdentifier(1)));
+	uint32_t k2 = ReadingIdentifierRegistry::instance().intern(ReadingIdentifier::Ptr(new ChannelIdentifier(2)));
+	uint32_t k3 = ReadingIdentifierRegistry::instance().intern(ReadingIdentifier::Ptr(new ChannelIdentifier(3)));
+
+	Channel *ch1 = new Channel();
+	Channel *ch2 = new Channel();
+	EXPECT_CALL(*ch1, identifier_key()).WillRepeatedly(Return(k1));
+	EXPECT_CALL(*ch2, identifier_key()).WillRepeatedly(Return(k2));
+	m.push_back(Channel::Ptr(ch1));
+	m.push_back(Channel::Ptr(ch2));
+
+	ASSERT_TRUE(m.channels(k1) != NULL);
+	ASSERT_EQ(1u, m.channels(k1)->size());
+	EXPECT_EQ(ch1, (*m.channels(k1))[0].get());
+	ASSERT_TRUE(m.channels(k2) != NULL);
+	EXPECT_EQ(ch2, (*m.channels(k2))[0].get());
+	EXPECT_TRUE(m.channels(k3) == NULL);
+	EXPECT_TRUE(m.channels(0) == NULL);
+	EXPECT_TRUE(m.channels(k3 + 100) == NULL);
+}
+
 // test whether the read data get's only into the proper channels: (two channel can have same id)
 size_t return_read(std::vector<Reading> &rds, size_t n)
 {
@@ -134,9 +162,9 @@ TEST(mock_metermap, reading_in_proper_channel)
 	Channel *ch3 = new Channel();
 
 	// assign ids: 1 2 1 (so ch1.id == ch3.id)
-	EXPECT_CALL(*ch1, identifier()).Times(AtLeast(1)).WillRepeatedly(Return(ReadingIdentifier::Ptr(new ChannelIdentifier(1))));
-	EXPECT_CALL(*ch2, identifier()).Times(AtLeast(1)).WillRepeatedly(Return(ReadingIdentifier::Ptr(new ChannelIdentifier(2))));
-	EXPECT_CALL(*ch3, identifier()).Times(AtLeast(1)).WillRepeatedly(Return(ReadingIdentifier::Ptr(new ChannelIdentifier(1))));
+	EXPECT_CALL(*ch1, identifier_key()).Times(AtLeast(1)).WillRepeatedly(Return(ReadingIdentifierRegistry::instance().intern(ReadingIdentifier::Ptr(new ChannelIdentifier(1)))));
+	EXPECT_CALL(*ch2, identifier_key()).Times(AtLeast(1)).WillRepeatedly(Return(ReadingIdentifierRegistry::instance().intern(ReadingIdentifier::Ptr(new ChannelIdentifier(2)))));
+	EXPECT_CALL(*ch3, identifier_key()).Times(AtLeast(1)).WillRepeatedly(Return(ReadingIdentifierRegistry::instance().intern(ReadingIdentifier::Ptr(new ChannelIdentifier(1)))));
 
 	// make sure the channels have a real buffer:
 	EXPECT_CALL(*ch1, buffer()).Times(AtLeast(1)).WillRepeatedly(Invoke(ch1, &Channel::real_buf));
@@ -0,0 +1,93 @@
+/*
+ * unit tests for ContentEncoder.cpp
+ */
+
+#include <string.h>
+#include <string>
+#include <zlib.h>
+#include "gtest/gtest.h"
+
+#include "ContentEncoder.hpp"
+#include <VZException.hpp>
+
+static std::string body(int tuples) {
+	std::string s("[");
+	char tuple[64];
+	for (int i = 0; i < tuples; i++) {
+		snprintf(tuple, sizeof(tuple), "%s[%lld,%.17g]", i ? "," : "", 1500000000000LL + i * 1000LL, 230.0 + (i % 7) * 0.1);
+		s += tuple;
+	}
+	return s + "]";
+}
+
+// inflate with automatic gzip/zlib header detection
+static std::string inflate_all(const char *data, size_t len) {
+	z_stream zs;
+	memset(&zs, 0, sizeof(zs));
+	EXPECT_EQ(Z_OK, inflateInit2(&zs, 15 + 32));
+	std::string out;
+	char buf[4096];
+	zs.next_in = (Bytef *)data;
+	zs.avail_in = len;
+	int ret;
+	do {
+		zs.next_out = (Bytef *)buf;
+		zs.avail_out = sizeof(buf);
+		ret = inflate(&zs, Z_NO_FLUSH);
+		out.append(buf, sizeof(buf) - zs.avail_out);
+	} while (ret == Z_OK);
+	EXPECT_EQ(Z_STREAM_END, ret);
+	inflateEnd(&zs);
+	return out;
+}
+
+TEST(ContentEncoder, parse)
+{
+	ASSERT_EQ(ContentEncoder::NONE, ContentEncoder::parse("none"));
+	ASSERT_EQ(ContentEncoder::GZIP, ContentEncoder::parse("gzip"));
+	ASSERT_EQ(ContentEncoder::DEFLATE, ContentEncoder::parse("deflate"));
+	ASSERT_THROW(ContentEncoder::parse("br"), vz::VZException);
+}
+
+TEST(ContentEncoder, gzip_roundtrip)
+{
+	ContentEncoder enc(ContentEncoder::GZIP, 1024);
+	ASSERT_STREQ("Content-Encoding: gzip", enc.header());
+
+	const std::string s = body(1000);
+	ASSERT_TRUE(enc.encode(s.data(), s.size()));
+	ASSERT_LT(enc.size() * 5, s.size()); // tuple arrays compress well
+	ASSERT_EQ('\x1f', enc.data()[0]); // gzip magic
+	ASSERT_EQ(s, inflate_all(enc.data(), enc.size()));
+
+	// the stream is reused for the next body
+	const std::string s2 = body(500);
+	ASSERT_TRUE(enc.encode(s2.data(), s2.size()));
+	ASSERT_EQ(s2, inflate_all(enc.data(), enc.size()));
+}
+
+TEST(ContentEncoder, deflate_roundtrip)
+{
+	ContentEncoder enc(ContentEncoder::DEFLATE, 0);
+	ASSERT_STREQ("Content-Encoding: deflate", enc.header());
+
+	const std::string s = body(100);
+	ASSERT_TRUE(enc.encode(s.data(), s.size()));
+	ASSERT_EQ(s, inflate_all(enc.data(), enc.size()));
+}
+
+TEST(ContentEncoder, skip_small)
+{
+	ContentEncoder enc(ContentEncoder::GZIP, 1024);
+	const std::string s = body(10);
+	ASSERT_LT(s.size(), 1024u);
+	ASSERT_FALSE(enc.encode(s.data(), s.size()));
+
+	// incompressible bodies are sent as is
+	ContentEncoder all(ContentEncoder::GZIP, 0);
+	ASSERT_FALSE(all.encode("[]", 2));
+
+	ContentEncoder none(ContentEncoder::NONE);
+	const std::string l = body(1000);
+	ASSERT_FALSE(none.encode(l.data(), l.size()));
+}
@@ -0,0 +1,92 @@
+/*
+ * unit tests for CurlMulti.cpp
+ * uses file:// urls, so no network is needed
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include "gtest/gtest.h"
+
+#include "CurlMulti.hpp"
+
+static size_t count_write_callback(void *ptr, size_t size, size_t nmemb, void *data) {
+	*static_cast<size_t *>(data) += size * nmemb;
+	return size * nmemb;
+}
+
+static CURL *file_handle(const std::string &file, size_t *received) {
+	CURL *eh = curl_easy_init();
+	std::string url = "file://" + file;
+	curl_easy_setopt(eh, CURLOPT_URL, url.c_str());
+	curl_easy_setopt(eh, CURLOPT_WRITEFUNCTION, count_write_callback);
+	curl_easy_setopt(eh, CURLOPT_WRITEDATA, received);
+	return eh;
+}
+
+TEST(CurlMulti, perform)
+{
+	char tmpl[] = "/tmp/vzlogger_curlmulti_XXXXXX";
+	int fd = mkstemp(tmpl);
+	ASSERT_NE(-1, fd);
+	ASSERT_EQ(5, write(fd, "hello", 5));
+	close(fd);
+
+	ASSERT_TRUE(curlMulti == 0);
+	CurlMulti transport;
+
+	size_t received = 0;
+	CURL *eh = file_handle(tmpl, &received);
+	ASSERT_EQ(CURLE_OK, transport.perform(eh));
+	ASSERT_EQ(5u, received);
+
+	// handles can be reused
+	received = 0;
+	ASSERT_EQ(CURLE_OK, transport.perform(eh));
+	ASSERT_EQ(5u, received);
+	curl_easy_cleanup(eh);
+
+	// errors are reported
+	eh = file_handle("/nonexistent/vzlogger", &received);
+	ASSERT_EQ(CURLE_FILE_COULDNT_READ_FILE, transport.perform(eh));
+	curl_easy_cleanup(eh);
+
+	unlink(tmpl);
+}
+
+TEST(CurlMulti, submit_callbacks)
+{
+	char tmpl[] = "/tmp/vzlogger_curlmulti_XXXXXX";
+	int fd = mkstemp(tmpl);
+	ASSERT_NE(-1, fd);
+	ASSERT_EQ(3, write(fd, "abc", 3));
+	close(fd);
+
+	CurlMulti transport;
+	const int n = 20;
+	CURL *eh[n];
+	size_t received[n];
+	std::atomic<int> done(0);
+	std::atomic<int> failed(0);
+
+	for (int i = 0; i < n; i++) {
+		received[i] = 0;
+		eh[i] = file_handle(tmpl, &received[i]);
+		transport.submit(eh[i], [&done, &failed](CURL *, CURLcode result) {
+			if (result != CURLE_OK) failed++;
+			done++;
+		});
+	}
+
+	for (int i = 0; i < 200 && done < n; i++) usleep(10000);
+	ASSERT_EQ(n, done);
+	ASSERT_EQ(0, failed);
+	ASSERT_EQ(0u, transport.active());
+	for (int i = 0; i < n; i++) {
+		ASSERT_EQ(3u, received[i]);
+		curl_easy_cleanup(eh[i]);
+	}
+
+	unlink(tmpl);
+}
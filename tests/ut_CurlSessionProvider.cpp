@@ -1,3 +1,5 @@
+#include <unistd.h>
+#include <vector>
 #include "gtest/gtest.h"
 
 #include "CurlSessionProvider.hpp"
@@ -39,3 +41,107 @@ TEST(CurlSessionProvider, single1)
 
     // TODO create that that's spanws a thread and tests blocking on a shared session
 }
+
+TEST(CurlSessionProvider, parallel)
+{
+    CurlSessionProvider csp(2);
+
+    CURL *eh1 = csp.get_easy_session("1");
+    CURL *eh2 = csp.get_easy_session("1");
+    ASSERT_TRUE(0 != eh1);
+    ASSERT_TRUE(0 != eh2);
+    ASSERT_TRUE(eh1 != eh2);
+    ASSERT_EQ(2u, csp.stats("1").in_use);
+
+    // the third one times out as both handles are in use
+    ASSERT_EQ(0, csp.get_easy_session("1", 1));
+    ASSERT_EQ(1u, csp.stats("1").waits);
+    ASSERT_GE(csp.stats("1").wait_max, 0.9);
+
+    // other keys are independent
+    CURL *eh3 = csp.get_easy_session("2");
+    ASSERT_TRUE(0 != eh3);
+    csp.return_session("2", eh3);
+
+    // returned handles are reused
+    CURL *old = eh1;
+    csp.return_session("1", eh1);
+    eh1 = csp.get_easy_session("1");
+    ASSERT_EQ(old, eh1);
+    ASSERT_EQ(2u, csp.stats("1").created);
+
+    csp.return_session("1", eh1);
+    csp.return_session("1", eh2);
+    CurlSessionProvider::Stats s = csp.stats();
+    ASSERT_EQ(3u, s.created);
+    ASSERT_EQ(0u, s.in_use);
+    ASSERT_EQ(3u, s.idle);
+}
+
+struct Waiter {
+    CurlSessionProvider *csp;
+    int id;
+    std::vector<int> *order;
+    pthread_mutex_t *mutex;
+};
+
+static void *waiter_thread(void *arg)
+{
+    Waiter *w = static_cast<Waiter *>(arg);
+    CURL *eh = w->csp->get_easy_session("1");
+    pthread_mutex_lock(w->mutex);
+    w->order->push_back(w->id);
+    pthread_mutex_unlock(w->mutex);
+    usleep(10000);
+    w->csp->return_session("1", eh);
+    return NULL;
+}
+
+TEST(CurlSessionProvider, fifo)
+{
+    CurlSessionProvider csp(1);
+    CURL *eh = csp.get_easy_session("1");
+
+    // waiters get the handle in the order they asked for it
+    std::vector<int> order;
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    const int n = 4;
+    pthread_t threads[n];
+    Waiter w[n];
+    for (int i = 0; i < n; i++) {
+        w[i].csp = &csp;
+        w[i].id = i;
+        w[i].order = &order;
+        w[i].mutex = &mutex;
+        ASSERT_EQ(0, pthread_create(&threads[i], NULL, &waiter_thread, &w[i]));
+        usleep(20000); // make sure they queue up in order
+    }
+
+    csp.return_session("1", eh);
+    for (int i = 0; i < n; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    ASSERT_EQ((size_t)n, order.size());
+    for (int i = 0; i < n; i++) {
+        ASSERT_EQ(i, order[i]);
+    }
+    ASSERT_EQ(1u, csp.stats("1").created);
+    ASSERT_EQ((size_t)n, csp.stats("1").waits);
+}
+
+TEST(CurlSessionProvider, idle_eviction)
+{
+    CurlSessionProvider csp(2, 1);
+
+    CURL *eh1 = csp.get_easy_session("1");
+    CURL *eh2 = csp.get_easy_session("1");
+    csp.return_session("1", eh1);
+    csp.return_session("1", eh2);
+    ASSERT_EQ(2u, csp.stats("1").idle);
+
+    sleep(2);
+    eh1 = csp.get_easy_session("1"); // cleans up the idle ones first
+    ASSERT_EQ(2u, csp.stats("1").evicted);
+    ASSERT_EQ(3u, csp.stats("1").created);
+    csp.return_session("1", eh1);
+}
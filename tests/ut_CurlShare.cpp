@@ -0,0 +1,63 @@
+/*
+ * unit tests for CurlShare.cpp
+ * uses file:// urls, so no network is needed
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <list>
+#include <string>
+#include "gtest/gtest.h"
+
+#include "CurlShare.hpp"
+#include "CurlMulti.hpp"
+#include "CurlSessionProvider.hpp"
+
+static size_t discard(void *, size_t size, size_t nmemb, void *) {
+	return size * nmemb;
+}
+
+TEST(CurlShare, shared_handles)
+{
+	char tmpl[] = "/tmp/vzlogger_curlshare_XXXXXX";
+	int fd = mkstemp(tmpl);
+	ASSERT_NE(-1, fd);
+	close(fd);
+	std::string url = std::string("file://") + tmpl;
+
+	ASSERT_TRUE(curlShare == 0);
+	curlShare = new CurlShare();
+	{
+		CurlMulti transport;
+		CurlSessionProvider csp(4);
+
+		// handles from the session provider use the share, concurrently
+		CURL *eh[4];
+		for (int i = 0; i < 4; i++) {
+			eh[i] = csp.get_easy_session("1");
+			ASSERT_TRUE(0 != eh[i]);
+			curl_easy_setopt(eh[i], CURLOPT_URL, url.c_str());
+			curl_easy_setopt(eh[i], CURLOPT_WRITEFUNCTION, discard);
+		}
+		for (int n = 0; n < 10; n++) {
+			for (int i = 0; i < 4; i++) {
+				ASSERT_EQ(CURLE_OK, transport.perform(eh[i]));
+			}
+		}
+		for (int i = 0; i < 4; i++) {
+			csp.return_session("1", eh[i]);
+		}
+
+		// prewarming reports errors but doesn't fail
+		std::list<std::string> urls;
+		urls.push_back(url);
+		urls.push_back("file:///nonexistent/vzlogger");
+		curlMulti = &transport;
+		curlShare->prewarm(urls, 1);
+		curlMulti = 0;
+	}
+	delete curlShare;
+	curlShare = 0;
+
+	unlink(tmpl);
+}
@@ -0,0 +1,147 @@
+/*
+ * unit tests for Journal.cpp
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "Journal.hpp"
+
+static Reading reading(int t, double v) {
+	struct timeval tv;
+	tv.tv_sec = t;
+	tv.tv_usec = 0;
+	return Reading(v, tv, ReadingIdentifier::Ptr());
+}
+
+static int serialized = 0;
+
+static size_t tuples(const RingBuffer<Reading> &log, size_t first, size_t last, JsonWriter &json) {
+	serialized++;
+	json.clear();
+	json.begin_array();
+	for (size_t i = first; i < last; i++) {
+		json.tuple(log[i].time_ms(), log[i].value());
+	}
+	json.end_array();
+	return last - first;
+}
+
+TEST(Journal, independent_sinks)
+{
+	Journal j;
+	size_t a = j.attach();
+	size_t b = j.attach();
+	ASSERT_NE(a, b);
+
+	for (int i = 1; i <= 4; i++) {
+		ASSERT_TRUE(j.append(reading(i, i)));
+	}
+	ASSERT_EQ(4u, j.pending(a));
+	ASSERT_EQ(4u, j.pending(b));
+
+	// readings are kept until every sink acknowledged them
+	j.ack(a, 3);
+	ASSERT_EQ(1u, j.pending(a));
+	ASSERT_EQ(4u, j.pending(b));
+	ASSERT_EQ(4u, j.size());
+
+	j.ack(b, 2);
+	ASSERT_EQ(2u, j.pending(b));
+	ASSERT_EQ(2u, j.size());
+
+	std::vector<Reading> rds;
+	j.copy(a, rds);
+	ASSERT_EQ(1u, rds.size());
+	ASSERT_EQ(4000, rds[0].time_ms());
+
+	// a detached sink doesn't hold back the others
+	j.detach(b);
+	ASSERT_EQ(1u, j.size());
+	j.ack(a, 1);
+	ASSERT_EQ(0u, j.size());
+}
+
+TEST(Journal, filter)
+{
+	Journal j(10);
+	j.attach();
+
+	ASSERT_TRUE(j.append(reading(1, 1.0)));
+	ASSERT_FALSE(j.append(reading(1, 2.0)));	// same timestamp
+	ASSERT_FALSE(j.append(reading(5, 1.0)));	// duplicate value
+	ASSERT_TRUE(j.append(reading(6, 2.0)));
+	ASSERT_TRUE(j.append(reading(16, 2.0)));	// duplicate, but <duplicates> seconds later
+	ASSERT_EQ(3u, j.size());
+}
+
+TEST(Journal, serialize_once)
+{
+	Journal j;
+	size_t a = j.attach();
+	size_t b = j.attach();
+	for (int i = 1; i <= 5; i++) {
+		j.append(reading(i, i));
+	}
+	serialized = 0;
+
+	size_t na, nb;
+	Journal::Body ba = j.serialize(a, "test", 3, &tuples, na);
+	Journal::Body bb = j.serialize(b, "test", 3, &tuples, nb);
+	ASSERT_EQ(1, serialized);
+	ASSERT_EQ(3u, na);
+	ASSERT_EQ(3u, nb);
+	ASSERT_EQ(ba.get(), bb.get());
+	ASSERT_STREQ("[[1000,1],[2000,2],[3000,3]]", ba->c_str());
+
+	// another format is serialized separately
+	size_t nc;
+	Journal::Body bc = j.serialize(b, "other", 3, &tuples, nc);
+	ASSERT_EQ(2, serialized);
+	ASSERT_NE(ba.get(), bc.get());
+
+	// once the sinks diverge each gets its own body
+	j.ack(a, na);
+	ba = j.serialize(a, "test", 3, &tuples, na);
+	ASSERT_EQ(3, serialized);
+	ASSERT_EQ(2u, na);
+	ASSERT_STREQ("[[4000,4],[5000,5]]", ba->c_str());
+	ASSERT_STREQ("[[1000,1],[2000,2],[3000,3]]", bb->c_str());
+
+	// nothing pending
+	j.ack(a, na);
+	ba = j.serialize(a, "test", 3, &tuples, na);
+	ASSERT_FALSE((bool)ba);
+	ASSERT_EQ(0u, na);
+}
+
+TEST(Journal, spool_failure)
+{
+	char tmpl[] = "/tmp/vzlogger_journal_XXXXXX";
+	ASSERT_TRUE(mkdtemp(tmpl) != NULL);
+	const std::string dir(tmpl);
+
+	Journal j;
+	size_t a = j.attach();
+	// two readings per segment
+	j.spool(Spool::Ptr(new Spool(dir, "ch", 1024 * 1024, 0, 16 + 2 * 16)));
+	ASSERT_TRUE(j.append(reading(1, 1)));
+	ASSERT_TRUE(j.append(reading(2, 2)));
+
+	// the next segment can't be created anymore
+	unlink((dir + "/ch/0000000000000001.seg").c_str());
+	rmdir((dir + "/ch").c_str());
+	rmdir(dir.c_str());
+
+	// the reading is kept in memory and the journal stays usable
+	ASSERT_TRUE(j.append(reading(3, 3)));
+	ASSERT_EQ(3u, j.size());
+	ASSERT_EQ(3u, j.pending(a));
+	j.ack(a, 3);
+	ASSERT_EQ(0u, j.size());
+	ASSERT_TRUE(j.append(reading(4, 4)));
+	ASSERT_EQ(1u, j.pending(a));
+}
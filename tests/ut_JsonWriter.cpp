@@ -0,0 +1,83 @@
+/*
+ * unit tests for JsonWriter.cpp
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string>
+#include <json-c/json.h>
+#include "gtest/gtest.h"
+
+#include "JsonWriter.hpp"
+
+static std::string number(double v) {
+	char out[32];
+	return std::string(out, JsonWriter::format_number(out, v));
+}
+
+static std::string integer(int64_t v) {
+	char out[24];
+	return std::string(out, JsonWriter::format_integer(out, v));
+}
+
+TEST(JsonWriter, format_integer)
+{
+	ASSERT_EQ("0", integer(0));
+	ASSERT_EQ("-1", integer(-1));
+	ASSERT_EQ("1500000000123", integer(1500000000123LL));
+	ASSERT_EQ("9223372036854775807", integer(INT64_MAX));
+	ASSERT_EQ("-9223372036854775808", integer(INT64_MIN));
+}
+
+TEST(JsonWriter, format_number)
+{
+	ASSERT_EQ("0", number(0.0));
+	ASSERT_EQ("42", number(42.0));
+	ASSERT_EQ("-3", number(-3.0));
+	ASSERT_EQ("1.1", number(1.1));
+	ASSERT_EQ("0.1", number(0.1));
+	ASSERT_EQ("230.4", number(230.4));
+	ASSERT_EQ("null", number(NAN));
+	ASSERT_EQ("null", number(INFINITY));
+
+	// shortest representation which parses back to the same value
+	const double values[] = { 0.1 + 0.2, 1.0 / 3, 1e-7, 123456.789e10, 5e-324, 1.7976931348623157e308 };
+	for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+		ASSERT_EQ(values[i], strtod(number(values[i]).c_str(), NULL)) << number(values[i]);
+	}
+	ASSERT_EQ("0.30000000000000004", number(0.1 + 0.2));
+}
+
+TEST(JsonWriter, document)
+{
+	JsonWriter w;
+	w.begin_object();
+	w.key("uuid");
+	w.string("a\"b\\c\n");
+	w.key("tuples");
+	w.begin_array();
+	w.tuple(1000, 1.5);
+	w.tuple(2000, -2);
+	w.end_array();
+	w.key("empty");
+	w.begin_array();
+	w.end_array();
+	w.key("raw");
+	w.raw("[1,2]", 5);
+	w.end_object();
+	ASSERT_STREQ("{\"uuid\":\"a\\\"b\\\\c\\u000a\",\"tuples\":[[1000,1.5],[2000,-2]],\"empty\":[],\"raw\":[1,2]}", w.c_str());
+
+	json_object *j = json_tokener_parse(w.c_str());
+	ASSERT_TRUE(j != NULL);
+	json_object_put(j);
+
+	// the buffer is reused for the next document
+	w.clear();
+	w.begin_array();
+	w.tuple(1, 1);
+	const size_t mark = w.size();
+	w.tuple(2, 2);
+	w.truncate(mark);
+	w.end_array();
+	ASSERT_STREQ("[[1,1]]", w.c_str());
+}
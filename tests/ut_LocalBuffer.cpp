@@ -0,0 +1,177 @@
+/*
+ * unit tests for LocalBuffer.cpp
+ */
+
+#include <algorithm>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "LocalBuffer.hpp"
+
+TEST(LocalBuffer, push)
+{
+	LocalBuffer lb(4, 0);
+	ASSERT_EQ(0, lb.newest());
+
+	lb.push(1000, 1.0);
+	lb.push(2000, 2.0);
+	lb.push(2000, 3.0); // not newer, skipped
+	lb.push(1500, 4.0);
+	ASSERT_EQ(2u, lb._data.size());
+	ASSERT_EQ(2000, lb.newest());
+	ASSERT_EQ(2.0, lb._data.back()._v);
+
+	// a time based buffer grows
+	for (int i = 3; i <= 10; i++) lb.push(i * 1000, i);
+	ASSERT_EQ(10u, lb._data.size());
+
+	// a count based one keeps the newest max readings
+	LocalBuffer count(3, 3);
+	for (int i = 1; i <= 10; i++) count.push(i * 1000, i);
+	ASSERT_EQ(3u, count._data.size());
+	ASSERT_EQ(8000, count._data.front()._t);
+	ASSERT_EQ(10000, count.newest());
+}
+
+TEST(LocalBuffer, after)
+{
+	LocalBuffer lb(8, 0);
+	ASSERT_EQ(0u, lb.after(0));
+
+	for (int i = 1; i <= 5; i++) lb.push(i * 1000, i);
+	ASSERT_EQ(0u, lb.after(0));
+	ASSERT_EQ(0u, lb.after(999));
+	ASSERT_EQ(1u, lb.after(1000)); // strictly newer
+	ASSERT_EQ(1u, lb.after(1999));
+	ASSERT_EQ(4u, lb.after(4000));
+	ASSERT_EQ(5u, lb.after(5000));
+	ASSERT_EQ(5u, lb.after(9000));
+}
+
+TEST(LocalBuffer, expire)
+{
+	LocalBuffer lb(4, 0);
+	for (int i = 1; i <= 10; i++) lb.push(i * 1000, i); // wraps the ring
+
+	lb.expire(1000); // nothing older
+	ASSERT_EQ(10u, lb._data.size());
+
+	lb.expire(3000); // readings at the boundary are kept
+	ASSERT_EQ(8u, lb._data.size());
+	ASSERT_EQ(3000, lb._data.front()._t);
+
+	lb.expire(3001);
+	ASSERT_EQ(7u, lb._data.size());
+	ASSERT_EQ(4000, lb._data.front()._t);
+	ASSERT_EQ(6u, lb.after(9000));
+
+	lb.expire(20000);
+	ASSERT_TRUE(lb._data.empty());
+	ASSERT_EQ(0, lb.newest());
+}
+
+TEST(LocalBuffer, select_range)
+{
+	LocalBuffer lb(16, 0);
+	for (int i = 1; i <= 10; i++) lb.push(i * 1000, i);
+	std::vector<size_t> selected;
+
+	TupleQuery all;
+	lb.select(all, selected);
+	ASSERT_EQ(10u, selected.size());
+
+	// from and to are inclusive
+	TupleQuery q;
+	q._from = 3000;
+	q._to = 6000;
+	lb.select(q, selected);
+	ASSERT_EQ(4u, selected.size());
+	ASSERT_EQ(3000, lb._data[selected.front()]._t);
+	ASSERT_EQ(6000, lb._data[selected.back()]._t);
+
+	q._from = 3001;
+	q._to = 5999;
+	lb.select(q, selected);
+	ASSERT_EQ(2u, selected.size());
+	ASSERT_EQ(4000, lb._data[selected.front()]._t);
+
+	// empty and reversed ranges
+	q._from = 11000;
+	q._to = 20000;
+	lb.select(q, selected);
+	ASSERT_TRUE(selected.empty());
+	q._from = 6000;
+	q._to = 3000;
+	lb.select(q, selected);
+	ASSERT_TRUE(selected.empty());
+}
+
+TEST(LocalBuffer, select_limit)
+{
+	LocalBuffer lb(16, 0);
+	for (int i = 1; i <= 10; i++) lb.push(i * 1000, i);
+	std::vector<size_t> selected;
+
+	// the newest tuples of the range are kept
+	TupleQuery q;
+	q._to = 8000;
+	q._limit = 3;
+	lb.select(q, selected);
+	ASSERT_EQ(3u, selected.size());
+	ASSERT_EQ(6000, lb._data[selected[0]]._t);
+	ASSERT_EQ(7000, lb._data[selected[1]]._t);
+	ASSERT_EQ(8000, lb._data[selected[2]]._t);
+
+	q._limit = 20;
+	lb.select(q, selected);
+	ASSERT_EQ(8u, selected.size());
+}
+
+TEST(LocalBuffer, select_points)
+{
+	LocalBuffer lb(128, 0);
+	for (int i = 0; i < 100; i++) lb.push(i * 1000, i == 42 ? 100.0 : 1.0);
+	std::vector<size_t> selected;
+
+	// exactly points tuples, with the first, the last and the peak
+	TupleQuery q;
+	q._points = 10;
+	lb.select(q, selected);
+	ASSERT_EQ(10u, selected.size());
+	ASSERT_EQ(0u, selected.front());
+	ASSERT_EQ(99u, selected.back());
+	ASSERT_NE(selected.end(), std::find(selected.begin(), selected.end(), 42u));
+	for (size_t i = 1; i < selected.size(); i++) {
+		ASSERT_LT(selected[i - 1], selected[i]);
+	}
+
+	q._points = 3;
+	lb.select(q, selected);
+	ASSERT_EQ(3u, selected.size());
+	ASSERT_EQ(42u, selected[1]);
+
+	// the newest tuple, or the first and the last one
+	q._points = 1;
+	lb.select(q, selected);
+	ASSERT_EQ(1u, selected.size());
+	ASSERT_EQ(99u, selected[0]);
+
+	q._points = 2;
+	lb.select(q, selected);
+	ASSERT_EQ(2u, selected.size());
+	ASSERT_EQ(0u, selected[0]);
+	ASSERT_EQ(99u, selected[1]);
+
+	// fewer tuples than points are returned as they are
+	q._points = 200;
+	lb.select(q, selected);
+	ASSERT_EQ(100u, selected.size());
+
+	// downsampling applies to the range after the limit
+	q._points = 2;
+	q._limit = 10;
+	lb.select(q, selected);
+	ASSERT_EQ(2u, selected.size());
+	ASSERT_EQ(90u, selected[0]);
+	ASSERT_EQ(99u, selected[1]);
+}
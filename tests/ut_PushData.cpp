@@ -1,5 +1,12 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 #include "gtest/gtest.h"
 #include "PushData.hpp"
+#include "CurlMulti.hpp"
 
 // dirty hack until we find a better solution:
 #include "../src/PushData.cpp"
@@ -18,14 +25,22 @@ TEST(PushData, PDL_basic_add)
     // let pdl destroy it
 }
 
+// number of tuples for uuid in data
+static size_t count(PushDataList &pdl, const PushDataList::Data *data, const std::string &uuid)
+{
+    size_t n = 0;
+    for (auto it = data->begin(); it != data->end(); ++it)
+        if (pdl.uuid(it->id) == uuid) n++;
+    return n;
+}
+
 TEST(PushData, PDL_basic_waitForData)
 {
     PushDataList pdl;
     pdl.add("0", 1, 1.0);
-    PushDataList::DataMap *dm = pdl.waitForData();
+    const PushDataList::Data *dm = pdl.waitForData();
     ASSERT_TRUE(0!=dm);
     ASSERT_EQ(1ul, dm->size());
-    delete dm;
 }
 
 TEST(PushData, PDL_basic_waitForData2)
@@ -33,11 +48,10 @@ TEST(PushData, PDL_basic_waitForData2)
     PushDataList pdl;
     pdl.add("0", 1, 1.0);
     pdl.add("0", 2, 2.0);
-    PushDataList::DataMap *dm = pdl.waitForData();
+    const PushDataList::Data *dm = pdl.waitForData();
     ASSERT_TRUE(0!=dm);
-    ASSERT_EQ(1ul, dm->size()); // still one uuid
-    ASSERT_EQ(2ul, dm->operator[]("0").size());
-    delete dm;
+    ASSERT_EQ(1ul, pdl.ids()); // still one uuid
+    ASSERT_EQ(2ul, count(pdl, dm, "0"));
 }
 
 TEST(PushData, PDL_basic_waitForData3)
@@ -46,28 +60,96 @@ TEST(PushData, PDL_basic_waitForData3)
     pdl.add("0", 1, 1.0);
     pdl.add("0", 2, 2.0);
     pdl.add("1", 3, 3.0);
-    PushDataList::DataMap *dm = pdl.waitForData();
+    const PushDataList::Data *dm = pdl.waitForData();
     ASSERT_TRUE(0!=dm);
-    ASSERT_EQ(2ul, dm->size()); // now two uuids
-    ASSERT_EQ(2ul, dm->operator[]("0").size());
-    ASSERT_EQ(1ul, dm->operator[]("1").size());
-    delete dm;
+    ASSERT_EQ(2ul, pdl.ids()); // now two uuids
+    ASSERT_EQ(2ul, count(pdl, dm, "0"));
+    ASSERT_EQ(1ul, count(pdl, dm, "1"));
 }
 
 TEST(PushData, PDL_basic_waitForData4)
 {
     PushDataList pdl;
     pdl.add("0", 1, 1.0);
-    PushDataList::DataMap *dm = pdl.waitForData();
+    const PushDataList::Data *dm = pdl.waitForData();
     ASSERT_TRUE(0!=dm);
     ASSERT_EQ(1ul, dm->size());
-    delete dm;
     pdl.add("1", 4, 4.4);
+    const PushDataList::Data *dm2 = pdl.waitForData();
+    ASSERT_TRUE(0!=dm2);
+    ASSERT_NE(dm, dm2); // double buffered
+    ASSERT_EQ(1ul, dm2->size());
+    ASSERT_EQ(4.4, dm2->back().value);
+    ASSERT_EQ(pdl.id("1"), dm2->back().id);
+    pdl.add("0", 5, 5.5);
+    ASSERT_EQ(dm, pdl.waitForData()); // buffers are reused
+    ASSERT_EQ(1ul, dm->size());
+}
+
+TEST(PushData, PDL_intern)
+{
+    PushDataList pdl;
+    PushDataList::Id a = pdl.id("a");
+    PushDataList::Id b = pdl.id("b");
+    ASSERT_NE(a, b);
+    ASSERT_EQ(a, pdl.id("a"));
+    ASSERT_EQ("b", pdl.uuid(b));
+}
+
+TEST(PushData, PDL_drop_oldest)
+{
+    PushDataList pdl(3 * sizeof(PushDataList::DataTuple), PushDataList::DROP_OLDEST);
+    ASSERT_EQ(3ul, pdl.capacity());
+    for (int i = 1; i <= 5; i++)
+        pdl.add("0", i, i);
+    const PushDataList::Data *dm = pdl.waitForData();
+    ASSERT_TRUE(0!=dm);
+    ASSERT_EQ(3ul, dm->size());
+    ASSERT_EQ(3, (*dm)[0].time_ms);
+    ASSERT_EQ(5, (*dm)[2].time_ms);
+    ASSERT_EQ(2ul, pdl.dropped());
+    ASSERT_EQ(4ul, dm->capacity()); // preallocated, rounded to a power of two
+}
+
+TEST(PushData, PDL_drop_newest)
+{
+    PushDataList pdl(3 * sizeof(PushDataList::DataTuple), PushDataList::DROP_NEWEST);
+    for (int i = 1; i <= 5; i++)
+        pdl.add("0", i, i);
+    const PushDataList::Data *dm = pdl.waitForData();
+    ASSERT_TRUE(0!=dm);
+    ASSERT_EQ(3ul, dm->size());
+    ASSERT_EQ(1, (*dm)[0].time_ms);
+    ASSERT_EQ(3, (*dm)[2].time_ms);
+    ASSERT_EQ(2ul, pdl.dropped());
+}
+
+TEST(PushData, PDL_coalesce)
+{
+    PushDataList pdl(2 * sizeof(PushDataList::DataTuple), PushDataList::COALESCE);
+    pdl.add("0", 1, 1.0);
+    pdl.add("1", 2, 2.0);
+    pdl.add("0", 3, 3.0);
+    pdl.add("1", 4, 4.0);
+    pdl.add("0", 5, 5.0);
+    const PushDataList::Data *dm = pdl.waitForData();
+    ASSERT_TRUE(0!=dm);
+    ASSERT_EQ(2ul, dm->size()); // latest value per channel
+    ASSERT_EQ(5, (*dm)[0].time_ms);
+    ASSERT_EQ(4, (*dm)[1].time_ms);
+    ASSERT_EQ(0ul, pdl.dropped());
+
+    // more channels than capacity: the oldest channel gets dropped
+    pdl.add("0", 6, 6.0);
+    pdl.add("1", 7, 7.0);
+    pdl.add("2", 8, 8.0);
+    pdl.add("1", 9, 9.0);
     dm = pdl.waitForData();
     ASSERT_TRUE(0!=dm);
-    ASSERT_EQ(1ul, dm->size());
-    ASSERT_EQ(4.4, dm->operator[]("1").back().second);
-    delete dm;
+    ASSERT_EQ(2ul, dm->size());
+    ASSERT_EQ(9, (*dm)[0].time_ms);
+    ASSERT_EQ(8, (*dm)[1].time_ms);
+    ASSERT_EQ(1ul, pdl.dropped());
 }
 
 // todo if we'd provide a timeout to waitForData we could test here the case with empty data
@@ -76,8 +158,16 @@ class PushDataServerTest
 {
 public:
     PushDataServerTest(PushDataServer &pds) : _pds(pds) {};
-    std::string generateJson(PushDataList::DataMap &dataMap) { return _pds.generateJson(dataMap); }
+    std::string generateJson(const PushDataList::Data &data) { return _pds.generateJson(data); }
     size_t size() { return _pds._middlewareList.size(); };
+    size_t queued(size_t i) {
+        auto it = _pds._middlewareList.begin();
+        std::advance(it, i);
+        pthread_mutex_lock(&_pds._mutex);
+        size_t n = it->queue.size() + (it->busy ? 1 : 0);
+        pthread_mutex_unlock(&_pds._mutex);
+        return n;
+    }
 	PushDataServer &_pds;
 };
 
@@ -92,11 +182,22 @@ TEST(PushData, PDS_constructor)
     PushDataServerTest pt(pds);
 
     PushDataList pdl;
+    pushDataList = &pdl;
     pdl.add("0", 1, 1.1);
-    PushDataList::DataMap *dm = pdl.waitForData();
+    const PushDataList::Data *dm = pdl.waitForData();
     ASSERT_TRUE(0!=dm);
     std::string str = pt.generateJson(*dm);
-    // todo fix the comparision! 1.10000 vs. 1.10000001, ... ASSERT_EQ("{ \"data\": [ { \"uuid\": \"0\", \"tuples\": [ [ 1, 1.100000 ] ] } ] }", str);
+    ASSERT_EQ("{\"data\":[{\"uuid\":\"0\",\"tuples\":[[1,1.1]]}]}", str);
+
+    // tuples grouped by channel
+    pdl.add("1", 2, 2.0);
+    pdl.add("0", 3, 3.0);
+    pdl.add("1", 4, 4.0);
+    dm = pdl.waitForData();
+    ASSERT_TRUE(0!=dm);
+    str = pt.generateJson(*dm);
+    pushDataList = 0;
+    ASSERT_EQ("{\"data\":[{\"uuid\":\"0\",\"tuples\":[[3,3]]},{\"uuid\":\"1\",\"tuples\":[[2,2],[4,4]]}]}", str);
 }
 
 TEST(PushData, PDS_fail_middleware)
@@ -119,3 +220,103 @@ TEST(PushData, PDS_fail_middleware)
     curlSessionProvider = 0;
 
 }
+
+// minimal http server on 127.0.0.1, either answering each request with 200 or never (stalled)
+class PushTarget
+{
+public:
+    PushTarget(bool stalled) : _stalled(stalled), _requests(0), _running(true) {
+        _fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        bind(_fd, (struct sockaddr *)&addr, sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(_fd, (struct sockaddr *)&addr, &len);
+        _port = ntohs(addr.sin_port);
+        listen(_fd, 16); // a stalled target accepts in the kernel only
+        if (!_stalled)
+            pthread_create(&_thread, NULL, &PushTarget::serve, this);
+    }
+    ~PushTarget() {
+        _running = false;
+        shutdown(_fd, SHUT_RDWR);
+        if (!_stalled)
+            pthread_join(_thread, NULL);
+        close(_fd);
+    }
+    std::string url() const { return "http://127.0.0.1:" + std::to_string(_port) + "/push.json"; }
+    int requests() const { return _requests; }
+
+private:
+    static void *serve(void *arg) {
+        PushTarget *t = static_cast<PushTarget *>(arg);
+        while (t->_running) {
+            int c = accept(t->_fd, NULL, NULL);
+            if (c < 0) break;
+            // read header and body
+            std::string req;
+            char buf[1024];
+            size_t want = std::string::npos;
+            while (req.size() < want) {
+                ssize_t r = read(c, buf, sizeof(buf));
+                if (r <= 0) break;
+                req.append(buf, r);
+                size_t eoh = req.find("\r\n\r\n");
+                size_t cl = req.find("Content-Length: ");
+                if (eoh != std::string::npos && cl != std::string::npos)
+                    want = eoh + 4 + atoi(req.c_str() + cl + 16);
+            }
+            const char *resp = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            if (write(c, resp, strlen(resp)) > 0)
+                t->_requests++;
+            close(c);
+        }
+        return 0;
+    }
+
+    bool _stalled;
+    volatile int _requests;
+    volatile bool _running;
+    int _fd;
+    int _port;
+    pthread_t _thread;
+};
+
+TEST(PushData, PDS_parallel_targets)
+{
+    PushTarget stalled(true);
+    PushTarget healthy(false);
+
+    ASSERT_EQ(0, curlMulti);
+    curlMulti = new CurlMulti();
+    {
+        std::string cfg = "[{\"url\": \"" + stalled.url() + "\", \"timeout\": 2, \"queue\": 2}, "
+            "{\"url\": \"" + healthy.url() + "\"}]";
+        struct json_object *jso = json_tokener_parse(cfg.c_str());
+        PushDataServer pds(jso);
+        json_object_put(jso);
+        PushDataServerTest pt(pds);
+        ASSERT_EQ(2ul, pt.size());
+
+        PushDataList pdl;
+        pushDataList = &pdl;
+        for (int i = 1; i <= 5; i++) {
+            pdl.add("0", i, 1.1 * i);
+            ASSERT_TRUE(pds.waitAndSendOnceToAll());
+            // the healthy target gets each batch without waiting for the stalled one
+            for (int n = 0; n < 100 && healthy.requests() < i; n++)
+                usleep(10000);
+            ASSERT_EQ(i, healthy.requests());
+        }
+        pushDataList = 0;
+
+        // stalled target: one in flight and its queue limit, the older ones got dropped
+        EXPECT_EQ(3ul, pt.queued(0));
+        EXPECT_EQ(0ul, pt.queued(1));
+    } // waits until the stalled requests timed out
+    delete curlMulti;
+    curlMulti = 0;
+}
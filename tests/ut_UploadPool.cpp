@@ -0,0 +1,245 @@
+/*
+ * unit tests for UploadPool.cpp
+ */
+
+#include <unistd.h>
+#include <atomic>
+#include "gtest/gtest.h"
+
+#include "UploadPool.hpp"
+
+static std::atomic<int> sends(0);
+static std::atomic<int> active(0);
+static std::atomic<int> max_active(0);
+static std::atomic<bool> fail(false);
+static std::atomic<int> batches(0);
+static std::atomic<int> batched(0);
+
+class TestApi : public vz::ApiIF {
+	public:
+	TestApi(Channel::Ptr ch) : ApiIF(ch) {}
+	bool send() {
+		int n = ++active;
+		int m = max_active;
+		while (n > m && !max_active.compare_exchange_weak(m, n)) {}
+		usleep(100000);
+		--active;
+		sends++;
+		return !fail;
+	}
+	void register_device() {}
+};
+
+class BatchApi : public TestApi {
+	public:
+	BatchApi(Channel::Ptr ch) : TestApi(ch) {}
+	std::string batch_key() const { return "batch"; }
+	bool send_batch(const std::vector<vz::ApiIF *> &apis) {
+		batches++;
+		batched += apis.size();
+		return send();
+	}
+};
+
+static vz::ApiIF::Ptr test_api(Channel::Ptr ch, size_t) {
+	return vz::ApiIF::Ptr(new TestApi(ch));
+}
+
+static vz::ApiIF::Ptr batch_api(Channel::Ptr ch, size_t) {
+	return vz::ApiIF::Ptr(new BatchApi(ch));
+}
+
+static Channel::Ptr test_channel(const char *middleware) {
+	std::list<Option> options;
+	options.push_back(Option("middleware", middleware));
+	ReadingIdentifier::Ptr pRid;
+	return Channel::Ptr(new Channel(options, std::string("test"), std::string("uuid"), pRid));
+}
+
+static bool wait_for_sends(int n, int timeout_ms) {
+	for (int i = 0; i < timeout_ms / 10 && sends < n; i++) usleep(10000);
+	return sends >= n;
+}
+
+static void reset() {
+	sends = 0;
+	active = 0;
+	max_active = 0;
+	fail = false;
+	batches = 0;
+	batched = 0;
+}
+
+TEST(UploadPool, notify_sends)
+{
+	reset();
+	UploadPool pool(2, 2, 1, &test_api);
+	uploadPool = &pool;
+
+	Channel::Ptr ch = test_channel("http://a");
+	ch->start();
+	ASSERT_TRUE(ch->running());
+	usleep(50000);
+	ASSERT_EQ(0, sends); // nothing to send yet
+
+	ch->buffer()->have_newValues();
+	ch->notify();
+	ASSERT_TRUE(wait_for_sends(1, 1000));
+	ASSERT_FALSE(ch->buffer()->newValues());
+
+	// notifications while sending are merged into one more send
+	ch->buffer()->have_newValues();
+	ch->notify();
+	usleep(20000);
+	ch->buffer()->have_newValues();
+	ch->notify();
+	ch->notify();
+	ASSERT_TRUE(wait_for_sends(3, 1000));
+	usleep(300000);
+	ASSERT_LE(sends, 3);
+
+	ch->cancel();
+	ch->join();
+	ASSERT_FALSE(ch->running());
+	uploadPool = 0;
+}
+
+TEST(UploadPool, retry_timer)
+{
+	reset();
+	fail = true;
+	UploadPool pool(1, 0, 1, &test_api);
+	uploadPool = &pool;
+
+	Channel::Ptr ch = test_channel("http://a");
+	ch->start();
+	ch->buffer()->have_newValues();
+	ch->notify();
+	ASSERT_TRUE(wait_for_sends(1, 1000));
+
+	// no new readings, but the failed channel is retried after the retry pause
+	fail = false;
+	usleep(500000);
+	ASSERT_EQ(1, sends);
+	ASSERT_TRUE(wait_for_sends(2, 1500));
+	usleep(1200000);
+	ASSERT_EQ(2, sends); // succeeded, no more retries
+
+	ch->cancel();
+	ch->join();
+	uploadPool = 0;
+}
+
+TEST(UploadPool, middleware_limit)
+{
+	reset();
+	UploadPool pool(4, 1, 1, &test_api);
+	uploadPool = &pool;
+
+	Channel::Ptr ch[3] = { test_channel("http://a"), test_channel("http://a"), test_channel("http://a") };
+	for (int i = 0; i < 3; i++) {
+		ch[i]->start();
+		ch[i]->buffer()->have_newValues();
+		ch[i]->notify();
+	}
+	ASSERT_TRUE(wait_for_sends(3, 2000));
+	ASSERT_EQ(1, max_active); // one request at a time to the same middleware
+
+	// different middlewares are sent in parallel
+	reset();
+	Channel::Ptr other = test_channel("http://b");
+	other->start();
+	other->buffer()->have_newValues();
+	ch[0]->buffer()->have_newValues();
+	ch[0]->notify();
+	other->notify();
+	ASSERT_TRUE(wait_for_sends(2, 2000));
+	ASSERT_EQ(2, max_active);
+
+	for (int i = 0; i < 3; i++) {
+		ch[i]->cancel();
+		ch[i]->join();
+	}
+	other->cancel();
+	other->join();
+	uploadPool = 0;
+}
+
+TEST(UploadPool, batch_window)
+{
+	reset();
+	UploadPool pool(4, 2, 1, &batch_api, 200);
+	uploadPool = &pool;
+
+	Channel::Ptr ch[3] = { test_channel("http://a"), test_channel("http://a"), test_channel("http://a") };
+	for (int i = 0; i < 3; i++) {
+		ch[i]->start();
+	}
+	// channels getting ready within the batch window are sent in one request
+	for (int i = 0; i < 3; i++) {
+		ch[i]->buffer()->have_newValues();
+		ch[i]->notify();
+		usleep(20000);
+	}
+	usleep(100000);
+	ASSERT_EQ(0, sends); // still waiting for the window
+	ASSERT_TRUE(wait_for_sends(1, 1000));
+	usleep(300000);
+	ASSERT_EQ(1, sends);
+	ASSERT_EQ(1, batches);
+	ASSERT_EQ(3, batched);
+
+	// a single channel is sent alone
+	ch[1]->buffer()->have_newValues();
+	ch[1]->notify();
+	ASSERT_TRUE(wait_for_sends(2, 1000));
+	ASSERT_EQ(1, batches);
+
+	for (int i = 0; i < 3; i++) {
+		ch[i]->cancel();
+		ch[i]->join();
+	}
+	uploadPool = 0;
+}
+
+TEST(UploadPool, circuit_breaker)
+{
+	reset();
+	fail = true;
+	UploadPool pool(4, 0, 1, &test_api, 0, 4, 2);
+	uploadPool = &pool;
+
+	Channel::Ptr ch[3] = { test_channel("http://a"), test_channel("http://a"), test_channel("http://a") };
+	for (int i = 0; i < 3; i++) {
+		ch[i]->start();
+	}
+
+	// channels failing together count as one retry round and are retried together after 1s
+	ch[0]->buffer()->have_newValues();
+	ch[0]->notify();
+	ch[1]->buffer()->have_newValues();
+	ch[1]->notify();
+	ASSERT_TRUE(wait_for_sends(2, 1000));
+	ASSERT_TRUE(wait_for_sends(4, 1300));
+
+	// the second round in a row opens the circuit for 2s (minus jitter)
+	usleep(50000);
+	fail = false;
+
+	// all channels of the middleware wait, including the retries
+	ch[2]->buffer()->have_newValues();
+	ch[2]->notify();
+	usleep(1200000);
+	ASSERT_EQ(4, sends);
+
+	// a single probe closes the circuit again, then the others follow
+	ASSERT_TRUE(wait_for_sends(7, 3000));
+	usleep(300000);
+	ASSERT_EQ(7, sends);
+
+	for (int i = 0; i < 3; i++) {
+		ch[i]->cancel();
+		ch[i]->join();
+	}
+	uploadPool = 0;
+}
@@ -16,8 +16,35 @@ class Volkszaehler_Test
 	public:
 		static void api_parse_exception(vz::api::Volkszaehler &v, vz::api::CURLresponse &r, 
 		char *&err, size_t &n){ v.api_parse_exception(r, err, n);} 
-		static std::list<Reading> &values(Volkszaehler &v) {return v._values;}
-		static json_object * api_json_tuples(Volkszaehler &v, Buffer::Ptr buf) { return v.api_json_tuples(buf);};
+		// the pending readings of the api in its channel journal
+		class Pending {
+			public:
+			Pending(Volkszaehler &v) : _j(v._journal), _sink(v._sink) {}
+			size_t size() { return _j->pending(_sink); }
+			Reading front() { std::vector<Reading> rds; _j->copy(_sink, rds); return rds.front(); }
+			Reading back() { std::vector<Reading> rds; _j->copy(_sink, rds); return rds.back(); }
+			void pop_front() { _j->ack(_sink, 1); }
+			void push_front(const Reading &rd) { _j->append(rd); }
+			void push_back(const Reading &rd) { _j->append(rd); }
+			private:
+			Journal::Ptr _j;
+			size_t _sink;
+		};
+		static Pending values(Volkszaehler &v) { return Pending(v); }
+		// parse the serialized tuples again for easier checks
+		static json_object * api_json_tuples(Volkszaehler &v, Buffer::Ptr buf) {
+			const char *s = v.api_json_tuples(buf);
+			return s ? json_tokener_parse(s) : 0;
+		}
+		static json_object * api_json_chunk(Volkszaehler &v) { return json_tokener_parse(v.api_json_chunk());};
+		static const char * api_json_chunk_str(Volkszaehler &v) { return v.api_json_chunk();};
+		static size_t inflight(Volkszaehler &v) { return v._inflight;}
+		static size_t chunk(Volkszaehler &v) { return v._chunk;}
+		static void adapt_chunk(Volkszaehler &v, CURLcode c, double t) { v.adapt_chunk(c, t);}
+		static const char * api_json_batch(Volkszaehler &v, const std::vector<Volkszaehler *> &apis) {
+			return v.api_json_batch(apis);
+		}
+		static bool multi_rejected(long http_code) { return Volkszaehler::multi_rejected(http_code); }
 };
 }
 }
@@ -99,7 +126,10 @@ using namespace vz::api;
 	resp.size = strlen(resp.data);
 	// todo bug: crashes with double free if _values is empty! Volkszaehler_Test::api_parse_exception(v, resp, err, n);
 	//ASSERT_STREQ("'UniqueConstraintViolationException': '2 Duplicate entry'", err);	
-	Volkszaehler_Test::values(v).push_front(Reading());
+	struct timeval t0;
+	t0.tv_sec = 1;
+	t0.tv_usec = 0;
+	Volkszaehler_Test::values(v).push_front(Reading(1.0, t0, pRid));
 	Volkszaehler_Test::api_parse_exception(v, resp, err, n);
 	ASSERT_TRUE(0 == Volkszaehler_Test::values(v).size());
 	ASSERT_STREQ("'UniqueConstraintViolationException': '2 Duplicate entry'", err);	
@@ -280,3 +310,154 @@ using namespace vz::api;
 
 
 }
+
+TEST(api_Volkszaehler, api_json_chunk) {
+using namespace vz::api;
+	std::list<Option> options;
+	options.push_front(Option("middleware", (char*)"bla_middleware"));
+	options.push_front(Option("maxtuples", 3));
+	ReadingIdentifier::Ptr pRid;
+	Channel *ch = new Channel(options, std::string("bla_api"), std::string("bla_uuid"), pRid);
+	Channel::Ptr chp(ch);
+	Volkszaehler v(chp, options);
+
+	struct timeval t;
+	t.tv_usec = 0;
+	for (t.tv_sec = 1; t.tv_sec <= 7; t.tv_sec++) {
+		Volkszaehler_Test::values(v).push_back(Reading(1.0, t, pRid));
+	}
+
+	// only maxtuples are sent in one request
+	json_object *j = Volkszaehler_Test::api_json_chunk(v);
+	ASSERT_TRUE(j != 0);
+	ASSERT_EQ(3, json_object_array_length(j));
+	ASSERT_EQ(3u, Volkszaehler_Test::inflight(v));
+	ASSERT_EQ(7u, Volkszaehler_Test::values(v).size());
+	json_object_put(j);
+
+	// the last chunk holds the rest
+	for (int i = 0; i < 6; i++) {
+		Volkszaehler_Test::values(v).pop_front();
+	}
+	j = Volkszaehler_Test::api_json_chunk(v);
+	ASSERT_EQ(1, json_object_array_length(j));
+	json_object_put(j);
+}
+
+TEST(api_Volkszaehler, api_json_chunk_maxbytes) {
+using namespace vz::api;
+	std::list<Option> options;
+	options.push_front(Option("middleware", (char*)"bla_middleware"));
+	options.push_front(Option("maxbytes", 64));
+	ReadingIdentifier::Ptr pRid;
+	Channel *ch = new Channel(options, std::string("bla_api"), std::string("bla_uuid"), pRid);
+	Channel::Ptr chp(ch);
+	Volkszaehler v(chp, options);
+
+	struct timeval t;
+	t.tv_usec = 0;
+	for (t.tv_sec = 1; t.tv_sec <= 10; t.tv_sec++) {
+		Volkszaehler_Test::values(v).push_back(Reading(1.5, t, pRid));
+	}
+
+	const char *s = Volkszaehler_Test::api_json_chunk_str(v);
+	ASSERT_LE(strlen(s), 64u);
+	json_object *j = json_tokener_parse(s);
+	ASSERT_GT(json_object_array_length(j), 0);
+	ASSERT_LT(json_object_array_length(j), 10);
+	ASSERT_EQ((size_t)json_object_array_length(j), Volkszaehler_Test::inflight(v));
+	json_object_put(j);
+
+	// the body is filled up to the limit, each tuple takes 12 bytes
+	ASSERT_EQ(5u, Volkszaehler_Test::inflight(v));
+	ASSERT_STREQ("[[1000,1.5],[2000,1.5],[3000,1.5],[4000,1.5],[5000,1.5]]", s);
+}
+
+TEST(api_Volkszaehler, adaptive_chunk) {
+using namespace vz::api;
+	std::list<Option> options;
+	options.push_front(Option("middleware", (char*)"bla_middleware"));
+	options.push_front(Option("maxtuples", 250));
+	options.push_front(Option("adaptive", true));
+	ReadingIdentifier::Ptr pRid;
+	Channel *ch = new Channel(options, std::string("bla_api"), std::string("bla_uuid"), pRid);
+	Channel::Ptr chp(ch);
+	Volkszaehler v(chp, options);
+
+	ASSERT_EQ(10u, Volkszaehler_Test::chunk(v));
+	// grows while requests are fast, up to maxtuples
+	Volkszaehler_Test::adapt_chunk(v, CURLE_OK, 0.1);
+	ASSERT_EQ(110u, Volkszaehler_Test::chunk(v));
+	Volkszaehler_Test::adapt_chunk(v, CURLE_OK, 0.1);
+	Volkszaehler_Test::adapt_chunk(v, CURLE_OK, 0.1);
+	ASSERT_EQ(250u, Volkszaehler_Test::chunk(v));
+	// slow requests keep the size
+	Volkszaehler_Test::adapt_chunk(v, CURLE_OK, 20.0);
+	ASSERT_EQ(250u, Volkszaehler_Test::chunk(v));
+	// timeouts halve it
+	Volkszaehler_Test::adapt_chunk(v, CURLE_OPERATION_TIMEDOUT, 30.0);
+	ASSERT_EQ(125u, Volkszaehler_Test::chunk(v));
+	for (int i = 0; i < 10; i++) {
+		Volkszaehler_Test::adapt_chunk(v, CURLE_OPERATION_TIMEDOUT, 30.0);
+	}
+	ASSERT_EQ(10u, Volkszaehler_Test::chunk(v));
+}
+
+TEST(api_Volkszaehler, api_json_batch) {
+using namespace vz::api;
+	std::list<Option> options;
+	options.push_front(Option("middleware", (char*)"bla_middleware"));
+	ReadingIdentifier::Ptr pRid;
+	Channel::Ptr ch1(new Channel(options, std::string("bla_api"), std::string("uuid_1"), pRid));
+	Channel::Ptr ch2(new Channel(options, std::string("bla_api"), std::string("uuid_2"), pRid));
+	Volkszaehler v1(ch1, options);
+	ASSERT_EQ("", v1.batch_key()); // batching is off by default
+
+	options.push_front(Option("batch", true));
+	Volkszaehler v2(ch2, options);
+	ASSERT_EQ("bla_middleware", v2.batch_key());
+
+	struct timeval t;
+	t.tv_usec = 0;
+	for (t.tv_sec = 1; t.tv_sec <= 3; t.tv_sec++) {
+		Volkszaehler_Test::values(v1).push_back(Reading(1.0, t, pRid));
+	}
+	t.tv_sec = 5;
+	Volkszaehler_Test::values(v2).push_back(Reading(2.0, t, pRid));
+
+	std::vector<Volkszaehler *> apis;
+	apis.push_back(&v1);
+	apis.push_back(&v2);
+	Volkszaehler_Test::api_json_chunk_str(v1);
+	Volkszaehler_Test::api_json_chunk_str(v2);
+
+	// one {uuid, tuples} object per channel
+	json_object *j = json_tokener_parse(Volkszaehler_Test::api_json_batch(v2, apis));
+	ASSERT_EQ(2, json_object_array_length(j));
+	json_object *uuid, *tuples;
+	ASSERT_TRUE(json_object_object_get_ex(json_object_array_get_idx(j, 0), "uuid", &uuid));
+	ASSERT_STREQ("uuid_1", json_object_get_string(uuid));
+	ASSERT_TRUE(json_object_object_get_ex(json_object_array_get_idx(j, 0), "tuples", &tuples));
+	ASSERT_EQ(3, json_object_array_length(tuples));
+	ASSERT_TRUE(json_object_object_get_ex(json_object_array_get_idx(j, 1), "uuid", &uuid));
+	ASSERT_STREQ("uuid_2", json_object_get_string(uuid));
+	ASSERT_TRUE(json_object_object_get_ex(json_object_array_get_idx(j, 1), "tuples", &tuples));
+	ASSERT_EQ(1, json_object_array_length(tuples));
+	json_object_put(j);
+}
+
+TEST(api_Volkszaehler, multi_rejected) {
+using namespace vz::api;
+	// the middleware doesn't understand the request
+	ASSERT_TRUE(Volkszaehler_Test::multi_rejected(400));
+	ASSERT_TRUE(Volkszaehler_Test::multi_rejected(404));
+	ASSERT_TRUE(Volkszaehler_Test::multi_rejected(405));
+	ASSERT_TRUE(Volkszaehler_Test::multi_rejected(415));
+
+	// temporary failures are retried as multi-UUID request
+	ASSERT_FALSE(Volkszaehler_Test::multi_rejected(401));
+	ASSERT_FALSE(Volkszaehler_Test::multi_rejected(429));
+	ASSERT_FALSE(Volkszaehler_Test::multi_rejected(500));
+	ASSERT_FALSE(Volkszaehler_Test::multi_rejected(502));
+	ASSERT_FALSE(Volkszaehler_Test::multi_rejected(503));
+}
@@ -3,6 +3,8 @@
  * Author: Matthias Behr, 2014
  */
 
+#include <math.h>
+#include <vector>
 #include "gtest/gtest.h"
 
 #include "Buffer.hpp"
@@ -63,6 +65,109 @@ TEST(buffer, buffer_agg_avg)
     }
 }
 
+TEST(buffer, buffer_agg_max_sum)
+{
+	ReadingIdentifier::Ptr pRid;
+	struct timeval t1;
+	t1.tv_usec = 0;
+
+	Buffer max;
+	max.set_aggmode(Buffer::MAX);
+	Buffer sum;
+	sum.set_aggmode(Buffer::SUM);
+
+	for (int i = 1; i <= 300; i++) {
+		t1.tv_sec = i;
+		max.push(Reading(-1.0 * i, t1, pRid));
+		sum.push(Reading(1.0, t1, pRid));
+	}
+	// readings are folded into the accumulators, nothing is stored until the period is closed:
+	ASSERT_EQ((size_t)0, max.size());
+	ASSERT_EQ((size_t)0, sum.size());
+
+	max.aggregate(60, true);
+	sum.aggregate(0, false);
+
+	ASSERT_EQ((size_t)1, max.size());
+	EXPECT_EQ(-1.0, max.begin()->value());
+	EXPECT_EQ(300000, max.begin()->time_ms()); // latest timestamp, already on the 60s grid
+
+	ASSERT_EQ((size_t)1, sum.size());
+	EXPECT_EQ(300.0, sum.begin()->value());
+	EXPECT_EQ(300000, sum.begin()->time_ms());
+
+	// empty period doesn't add anything:
+	sum.aggregate(0, false);
+	ASSERT_EQ((size_t)1, sum.size());
+
+	// next period starts from scratch:
+	t1.tv_sec = 301;
+	sum.push(Reading(5.0, t1, pRid));
+	sum.aggregate(0, false);
+	ASSERT_EQ((size_t)2, sum.size());
+	EXPECT_EQ(5.0, (*(++sum.begin())).value());
+}
+
+static double agg_one_period(Buffer::aggmode mode, const double *values, size_t n)
+{
+	Buffer buf;
+	buf.set_aggmode(mode);
+	ReadingIdentifier::Ptr pRid;
+	struct timeval t1;
+	t1.tv_usec = 0;
+	for (size_t i = 0; i < n; i++) {
+		t1.tv_sec = 10 * (i + 1);
+		buf.push(Reading(values[i], t1, pRid));
+	}
+	buf.aggregate(0, false);
+	EXPECT_EQ((size_t)1, buf.size());
+	return buf.begin()->value();
+}
+
+TEST(buffer, buffer_agg_extended)
+{
+	const double v[] = { 4.0, -2.0, 8.0, 6.0 };
+
+	EXPECT_EQ(-2.0, agg_one_period(Buffer::MIN, v, 4));
+	EXPECT_EQ(4.0, agg_one_period(Buffer::COUNT, v, 4));
+	// mean 4, squared diffs 0+36+16+4=56 -> sqrt(56/4)
+	EXPECT_DOUBLE_EQ(sqrt(14.0), agg_one_period(Buffer::STDDEV, v, 4));
+	// 10s each: 4*10 + -2*10 + 8*10 = 100 Ws (last value has no time yet)
+	EXPECT_DOUBLE_EQ(100.0/3600.0, agg_one_period(Buffer::INTEGRAL, v, 4));
+	// less than 5 values: exact interpolated quantile
+	EXPECT_DOUBLE_EQ(5.0, agg_one_period(Buffer::P50, v, 4));
+}
+
+TEST(buffer, buffer_agg_quantile)
+{
+	// 1..1000 in a scrambled order
+	double v[1000];
+	for (int i = 0; i < 1000; i++) {
+		v[i] = ((i * 379) % 1000) + 1;
+	}
+	EXPECT_NEAR(500.0, agg_one_period(Buffer::P50, v, 1000), 20.0);
+	EXPECT_NEAR(950.0, agg_one_period(Buffer::P95, v, 1000), 20.0);
+	EXPECT_NEAR(990.0, agg_one_period(Buffer::P99, v, 1000), 20.0);
+}
+
+TEST(buffer, buffer_agg_integral_periods)
+{
+	// constant 3600 W for two 10s periods gives 10 Wh each (starting point kept across periods)
+	Buffer buf;
+	buf.set_aggmode(Buffer::INTEGRAL);
+	ReadingIdentifier::Ptr pRid;
+	struct timeval t1;
+	t1.tv_usec = 0;
+	for (int i = 0; i <= 20; i++) {
+		t1.tv_sec = i;
+		buf.push(Reading(3600.0, t1, pRid));
+		if (i == 10 || i == 20) buf.aggregate(0, false);
+	}
+	ASSERT_EQ((size_t)2, buf.size());
+	EXPECT_DOUBLE_EQ(10.0, buf.begin()->value());
+	EXPECT_DOUBLE_EQ(10.0, (*(++buf.begin())).value());
+}
+
 TEST(buffer, clean)
 {
 	// call clean on empty buffer:
@@ -97,3 +202,133 @@ TEST(buffer, clean)
 	ASSERT_EQ(0ul, buf.size());
 
 }
+
+TEST(buffer, ringbuffer_wrap)
+{
+	RingBuffer<int> rb(4);
+	ASSERT_EQ(4ul, rb.capacity());
+
+	// fill, drain partially and refill so that the content wraps around the end of the array:
+	for (int i = 0; i < 4; i++) rb.push_back(i);
+	rb.pop_front();
+	rb.pop_front();
+	rb.push_back(4);
+	rb.push_back(5);
+	ASSERT_EQ(4ul, rb.size());
+	ASSERT_EQ(4ul, rb.capacity());
+
+	int expect = 2;
+	for (RingBuffer<int>::iterator it = rb.begin(); it != rb.end(); it++) {
+		ASSERT_EQ(expect++, *it);
+	}
+
+	// growing has to keep the order:
+	rb.push_back(6);
+	ASSERT_EQ(8ul, rb.capacity());
+	ASSERT_EQ(5ul, rb.size());
+	for (size_t i = 0; i < rb.size(); i++) {
+		ASSERT_EQ((int)i + 2, rb[i]);
+	}
+
+	// erase_if keeps the order of the remaining ones:
+	rb.erase_if([](const int &v) { return v % 2 == 0; });
+	ASSERT_EQ(2ul, rb.size());
+	ASSERT_EQ(3, rb.front());
+	ASSERT_EQ(5, rb.back());
+
+	// dropping several at once wraps like single pops:
+	for (int i = 6; i < 12; i++) rb.push_back(i);
+	rb.pop_front(5);
+	ASSERT_EQ(3ul, rb.size());
+	ASSERT_EQ(9, rb.front());
+	ASSERT_EQ(11, rb.back());
+}
+
+TEST(buffer, steady_state_no_growth)
+{
+	Buffer buf;
+	ReadingIdentifier::Ptr pRid;
+	struct timeval t1;
+	t1.tv_usec = 0;
+
+	// readings are consumed (marked deleted and cleaned) after each period
+	// like the logging thread does. The storage must not grow beyond the first period.
+	size_t cap = 0;
+	for (int period = 0; period < 100; period++) {
+		for (int i = 0; i < 20; i++) {
+			t1.tv_sec = period * 20 + i;
+			buf.push(Reading(i, t1, pRid));
+		}
+		if (period == 0) cap = buf.capacity();
+		ASSERT_EQ(20ul, buf.size());
+		for (Buffer::iterator it = buf.begin(); it != buf.end(); it++) {
+			it->mark_delete();
+		}
+		buf.clean();
+		ASSERT_EQ(0ul, buf.size());
+	}
+	ASSERT_EQ(cap, buf.capacity());
+}
+
+TEST(buffer, take)
+{
+	Buffer buf;
+	ReadingIdentifier::Ptr pRid;
+	struct timeval t1;
+	t1.tv_usec = 0;
+
+	RingBuffer<Reading> batch;
+	for (int i = 0; i < 3; i++) {
+		t1.tv_sec = i;
+		buf.push(Reading(i, t1, pRid));
+	}
+	buf.take(batch);
+	ASSERT_EQ((size_t)0, buf.size());
+	ASSERT_EQ((size_t)3, batch.size());
+	ASSERT_EQ(0.0, batch.front().value());
+	ASSERT_EQ(2.0, batch.back().value());
+
+	// the next take drops the old batch:
+	t1.tv_sec = 3;
+	buf.push(Reading(3, t1, pRid));
+	buf.take(batch);
+	ASSERT_EQ((size_t)0, buf.size());
+	ASSERT_EQ((size_t)1, batch.size());
+	ASSERT_EQ(3.0, batch.front().value());
+}
+
+static std::vector<std::pair<int, double> > listened;
+static void buffer_listener(int id, const Reading &rd) { listened.push_back(std::make_pair(id, rd.value())); }
+
+TEST(buffer, listener)
+{
+	Buffer buf;
+	ReadingIdentifier::Ptr pRid;
+	struct timeval t1;
+	t1.tv_usec = 0;
+	RingBuffer<Reading> batch;
+
+	// each stored reading, whether the consumer took the buffer or not
+	listened.clear();
+	buf.listener(&buffer_listener, 7);
+	for (int i = 0; i < 3; i++) {
+		t1.tv_sec = i;
+		buf.push(Reading(i, t1, pRid));
+		if (i == 1) buf.take(batch);
+	}
+	ASSERT_EQ((size_t)3, listened.size());
+	ASSERT_EQ(7, listened[0].first);
+	ASSERT_EQ(2.0, listened[2].second);
+
+	// the aggregated reading only
+	listened.clear();
+	buf.set_aggmode(Buffer::MAX);
+	for (int i = 3; i < 6; i++) {
+		t1.tv_sec = i;
+		buf.push(Reading(i, t1, pRid));
+	}
+	ASSERT_TRUE(listened.empty());
+	buf.aggregate(0, false);
+	ASSERT_EQ((size_t)1, listened.size());
+	ASSERT_EQ(5.0, listened[0].second);
+}
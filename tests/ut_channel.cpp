@@ -0,0 +1,28 @@
+/*
+ * unit tests for Channel.cpp
+ */
+
+#include "gtest/gtest.h"
+
+#include "Channel.hpp"
+#include "UploadPool.hpp"
+
+// (already in ut_api_volkszaehler.cpp) #include "../src/Channel.cpp"
+
+TEST(channel, start_without_pool)
+{
+	std::list<Option> options;
+	ReadingIdentifier::Ptr pRid;
+	Channel::Ptr ch(new Channel(options, std::string("null"), std::string("uuid"), pRid));
+
+	ASSERT_TRUE(uploadPool == 0);
+	ASSERT_THROW(ch->start(), vz::VZException);
+	ASSERT_FALSE(ch->running());
+
+	// not attached: notify, cancel and join do nothing
+	ch->buffer()->have_newValues();
+	ch->notify();
+	ch->cancel();
+	ch->join();
+	ASSERT_TRUE(ch->buffer()->newValues());
+}
@@ -0,0 +1,133 @@
+/*
+ * unit tests for Compressor.cpp
+ */
+
+#include <math.h>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "Compressor.hpp"
+
+static Reading reading(int t, double v) {
+	struct timeval tv;
+	tv.tv_sec = t;
+	tv.tv_usec = 0;
+	return Reading(v, tv, ReadingIdentifier::Ptr());
+}
+
+TEST(compressor, none)
+{
+	Compressor c;
+	Reading out;
+	for (int i = 0; i < 10; i++) {
+		ASSERT_TRUE(c.add(reading(i, 1.0), out));
+		ASSERT_EQ(i * 1000, out.time_ms());
+	}
+}
+
+TEST(compressor, deadband)
+{
+	Compressor c;
+	c.configure(Compressor::DEADBAND, 0.5, 0.0, 0);
+	Reading out;
+
+	ASSERT_TRUE(c.add(reading(0, 20.0), out)); // first one is always kept
+	ASSERT_FALSE(c.add(reading(1, 20.3), out));
+	ASSERT_FALSE(c.add(reading(2, 19.6), out));
+	ASSERT_TRUE(c.add(reading(3, 20.6), out));
+	ASSERT_EQ(20.6, out.value());
+	ASSERT_FALSE(c.add(reading(4, 20.2), out)); // compared with the last kept one
+
+	// relative: 10% of 100
+	c.configure(Compressor::DEADBAND, 0.0, 0.1, 0);
+	ASSERT_TRUE(c.add(reading(10, 100.0), out));
+	ASSERT_FALSE(c.add(reading(11, 109.0), out));
+	ASSERT_TRUE(c.add(reading(12, 111.0), out));
+
+	// heartbeat
+	c.configure(Compressor::DEADBAND, 1.0, 0.0, 60);
+	ASSERT_TRUE(c.add(reading(100, 5.0), out));
+	ASSERT_FALSE(c.add(reading(130, 5.0), out));
+	ASSERT_TRUE(c.add(reading(160, 5.0), out));
+	ASSERT_EQ(160000, out.time_ms());
+}
+
+TEST(compressor, swingingdoor)
+{
+	Compressor c;
+	c.configure(Compressor::SWINGINGDOOR, 0.5, 0.0, 0);
+	Reading out;
+
+	ASSERT_TRUE(c.add(reading(0, 0.0), out));
+	// a straight line is covered completely by its end points:
+	for (int i = 1; i <= 10; i++) {
+		ASSERT_FALSE(c.add(reading(i, i * 1.0), out)) << i;
+	}
+	// turning point: the last reading of the line is kept
+	ASSERT_TRUE(c.add(reading(11, 5.0), out));
+	ASSERT_EQ(10000, out.time_ms());
+	ASSERT_EQ(10.0, out.value());
+
+	// small noise around the new line falling by 5 per second doesn't close the door
+	ASSERT_FALSE(c.add(reading(12, 0.2), out));
+	ASSERT_FALSE(c.add(reading(13, -4.8), out));
+}
+
+TEST(compressor, swingingdoor_error_bound)
+{
+	Compressor c;
+	const double dev = 0.25;
+	c.configure(Compressor::SWINGINGDOOR, dev, 0.0, 0);
+
+	// keep readings of a sine-like curve and check that linear interpolation
+	// of the kept ones reproduces all original readings within dev
+	std::vector<Reading> all, kept;
+	Reading out;
+	for (int i = 0; i < 200; i++) {
+		Reading r = reading(i, 10.0 * sin(i / 10.0));
+		all.push_back(r);
+		if (c.add(r, out)) kept.push_back(out);
+	}
+	ASSERT_TRUE(c.flush(out)); // still held by the compressor
+	ASSERT_EQ(all.back().time_ms(), out.time_ms());
+	kept.push_back(out);
+	ASSERT_LT(kept.size(), all.size() / 3);
+
+	size_t k = 0;
+	for (size_t i = 0; i < all.size(); i++) {
+		int64_t t = all[i].time_ms();
+		while (k + 1 < kept.size() && kept[k + 1].time_ms() < t) k++;
+		if (k + 1 >= kept.size()) break;
+		double v = kept[k].value() + (kept[k + 1].value() - kept[k].value()) *
+			(t - kept[k].time_ms()) / (double)(kept[k + 1].time_ms() - kept[k].time_ms());
+		ASSERT_NEAR(all[i].value(), v, dev + 1e-9) << i;
+	}
+}
+
+TEST(compressor, swingingdoor_constant)
+{
+	// a flat signal never closes the door, so only maxtime sends it
+	Compressor c;
+	c.configure(Compressor::SWINGINGDOOR, 0.5, 0.0, Compressor::SWINGINGDOOR_MAXTIME);
+	Reading out;
+	std::vector<Reading> kept;
+	for (int i = 0; i <= 1000; i++) {
+		if (c.add(reading(i, 20.0), out)) kept.push_back(out);
+	}
+	ASSERT_EQ(4u, kept.size());
+	for (size_t k = 0; k < kept.size(); k++) {
+		EXPECT_EQ(20.0, kept[k].value());
+		if (k > 0) EXPECT_LE(kept[k].time_ms() - kept[k - 1].time_ms(), Compressor::SWINGINGDOOR_MAXTIME * 1000);
+	}
+
+	// the last reading is held until the meter stops
+	ASSERT_TRUE(c.flush(out));
+	EXPECT_EQ(1000000, out.time_ms());
+	EXPECT_EQ(20.0, out.value());
+	ASSERT_FALSE(c.flush(out));
+
+	// the next reading continues from the flushed one
+	ASSERT_FALSE(c.add(reading(1001, 20.0), out));
+	ASSERT_TRUE(c.flush(out));
+	EXPECT_EQ(1001000, out.time_ms());
+}
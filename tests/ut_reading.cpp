@@ -0,0 +1,121 @@
+/*
+ * unit tests for Reading.cpp
+ */
+
+#include <thread>
+#include "gtest/gtest.h"
+
+#include "Reading.hpp"
+
+// (already in MeterD0.cpp) #include "../src/Reading.cpp"
+
+TEST(reading, identifier_registry)
+{
+	ReadingIdentifierRegistry &reg = ReadingIdentifierRegistry::instance();
+
+	// no identifier:
+	ASSERT_EQ(0u, reg.intern(ReadingIdentifier::Ptr()));
+	ASSERT_FALSE(reg.lookup(0));
+
+	uint32_t k1 = reg.intern(ReadingIdentifier::Ptr(new ObisIdentifier(Obis(1, 0, 1, 8, 0, 255))));
+	uint32_t k2 = reg.intern(ReadingIdentifier::Ptr(new ObisIdentifier(Obis(1, 0, 1, 8, 0, 255))));
+	uint32_t k3 = reg.intern(ReadingIdentifier::Ptr(new ObisIdentifier(Obis(1, 0, 2, 8, 0, 255))));
+	EXPECT_NE(0u, k1);
+	EXPECT_EQ(k1, k2);
+	EXPECT_NE(k1, k3);
+
+	// same text but different type:
+	uint32_t s1 = reg.intern(ReadingIdentifier::Ptr(new StringIdentifier("1-0:1.8.0*255")));
+	EXPECT_NE(k1, s1);
+	EXPECT_EQ(s1, reg.intern(ReadingIdentifier::Ptr(new StringIdentifier("1-0:1.8.0*255"))));
+
+	EXPECT_NE(reg.intern(ReadingIdentifier::Ptr(new ChannelIdentifier(1))),
+			  reg.intern(ReadingIdentifier::Ptr(new ChannelIdentifier(-1))));
+
+	// lookup returns the registered identifier:
+	ObisIdentifier *o = dynamic_cast<ObisIdentifier*>(reg.lookup(k1).get());
+	ASSERT_NE((ObisIdentifier*)0, o);
+	EXPECT_TRUE(Obis(1, 0, 1, 8, 0, 255) == o->obis());
+}
+
+TEST(reading, identifier_key)
+{
+	struct timeval t1;
+	t1.tv_sec = 1;
+	t1.tv_usec = 0;
+
+	Reading r1(1.0, t1, ReadingIdentifier::Ptr(new StringIdentifier("Power")));
+	Reading r2;
+	EXPECT_EQ(0u, r2.key());
+	r2.identifier(new StringIdentifier("Power"));
+	EXPECT_NE(0u, r1.key());
+	EXPECT_EQ(r1.key(), r2.key());
+
+	Reading r3(r1);
+	EXPECT_EQ(r1.key(), r3.key());
+	r3.identifier(new StringIdentifier("Impulse"));
+	EXPECT_NE(r1.key(), r3.key());
+
+	char buffer[MAX_IDENTIFIER_LEN];
+	r3.unparse(buffer, MAX_IDENTIFIER_LEN);
+	EXPECT_STREQ("Impulse", buffer);
+
+	// key interned once by a meter:
+	Reading r4;
+	r4.key(r1.key());
+	EXPECT_EQ(r1.key(), r4.key());
+	r4.unparse(buffer, MAX_IDENTIFIER_LEN);
+	EXPECT_STREQ("Power", buffer);
+}
+
+TEST(reading, identifier_keys)
+{
+	ReadingIdentifierRegistry &reg = ReadingIdentifierRegistry::instance();
+	ReadingIdentifierKeys<Obis, ObisIdentifier> obis;
+	ReadingIdentifierKeys<std::string, StringIdentifier> strings;
+
+	// the same keys as interning, looked up once per identifier
+	const uint32_t k = obis.key(Obis(1, 0, 1, 8, 0, 255));
+	EXPECT_EQ(reg.intern(ReadingIdentifier::Ptr(new ObisIdentifier(Obis(1, 0, 1, 8, 0, 255)))), k);
+	const size_t n = reg.size();
+	EXPECT_EQ(k, obis.key(Obis(1, 0, 1, 8, 0, 255)));
+	EXPECT_NE(k, obis.key(Obis(1, 0, 99, 97, 0, 255)));
+	EXPECT_EQ(obis.key(Obis(1, 0, 99, 97, 0, 255)), obis.key(Obis(1, 0, 99, 97, 0, 255)));
+	EXPECT_EQ(n + 1, reg.size());
+
+	EXPECT_EQ(reg.intern(ReadingIdentifier::Ptr(new StringIdentifier("Power"))), strings.key("Power"));
+	EXPECT_NE(strings.key("Power"), strings.key("Impulse"));
+}
+
+TEST(reading, identifier_registry_concurrent)
+{
+	ReadingIdentifierRegistry &reg = ReadingIdentifierRegistry::instance();
+	const size_t n = reg.size();
+
+	// lookups without lock while the registry grows over several chunks
+	std::atomic<bool> done(false);
+	std::atomic<int> missing(0);
+	std::thread reader([&]() {
+		while (!done) {
+			const uint32_t size = reg.size();
+			for (uint32_t key = 1; key <= size; key++) {
+				if (!reg.lookup(key)) missing++;
+			}
+		}
+	});
+	uint32_t keys[1000];
+	for (int i = 0; i < 1000; i++) {
+		keys[i] = reg.intern(ReadingIdentifier::Ptr(new ChannelIdentifier(100000 + i)));
+	}
+	done = true;
+	reader.join();
+
+	EXPECT_EQ(0, missing);
+	EXPECT_EQ(n + 1000, reg.size());
+	for (int i = 0; i < 1000; i++) {
+		ReadingIdentifier::Ptr rid = reg.lookup(keys[i]);
+		ASSERT_TRUE(rid);
+		EXPECT_TRUE(*rid == ChannelIdentifier(100000 + i));
+	}
+	EXPECT_FALSE(reg.lookup(keys[999] + 1));
+}
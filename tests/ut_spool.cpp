@@ -0,0 +1,102 @@
+/*
+ * unit tests for Spool.cpp
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <list>
+#include <string>
+#include "gtest/gtest.h"
+
+#include "Spool.hpp"
+
+static Reading reading(int t, double v) {
+	struct timeval tv;
+	tv.tv_sec = t;
+	tv.tv_usec = 0;
+	return Reading(v, tv, ReadingIdentifier::Ptr());
+}
+
+static std::string make_tempdir() {
+	char tmpl[] = "/tmp/vzlogger_spool_XXXXXX";
+	char *dir = mkdtemp(tmpl);
+	return dir ? std::string(dir) : std::string();
+}
+
+static void remove_tempdir(const std::string &dir, const std::string &name) {
+	std::string path = dir + "/" + name;
+	DIR *d = opendir(path.c_str());
+	if (d) {
+		struct dirent *de;
+		while ((de = readdir(d)) != NULL) {
+			if (de->d_name[0] != '.') unlink((path + "/" + de->d_name).c_str());
+		}
+		closedir(d);
+	}
+	rmdir(path.c_str());
+	rmdir(dir.c_str());
+}
+
+TEST(spool, replay_after_ack)
+{
+	std::string dir = make_tempdir();
+	ASSERT_FALSE(dir.empty());
+	{
+		Spool s(dir, "ch", 1024 * 1024, 0);
+		for (int i = 1; i <= 10; i++) {
+			ASSERT_EQ(0u, s.append(reading(i, i * 1.5)));
+		}
+		ASSERT_EQ(10u, s.pending());
+		s.ack(4);
+		ASSERT_EQ(6u, s.pending());
+	}
+	{
+		Spool s(dir, "ch", 1024 * 1024, 0);
+		ASSERT_EQ(6u, s.pending());
+		std::list<Reading> out;
+		ASSERT_EQ(6u, s.replay(out));
+		ASSERT_EQ(6u, out.size());
+		int i = 5;
+		for (std::list<Reading>::const_iterator it = out.begin(); it != out.end(); it++, i++) {
+			ASSERT_EQ(i * 1000, it->time_ms());
+			ASSERT_EQ(i * 1.5, it->value());
+		}
+		s.ack(6);
+		ASSERT_EQ(0u, s.pending());
+	}
+	remove_tempdir(dir, "ch");
+}
+
+TEST(spool, size_limit_and_segments)
+{
+	std::string dir = make_tempdir();
+	ASSERT_FALSE(dir.empty());
+	{
+		// 16 byte header + 4 records of 16 bytes per segment, at most 2 segments
+		const size_t segsize = 16 + 4 * 16;
+		Spool s(dir, "ch", 2 * segsize, 0, segsize);
+		size_t dropped = 0;
+		for (int i = 1; i <= 8; i++) {
+			dropped += s.append(reading(i, i));
+		}
+		ASSERT_EQ(0u, dropped);
+		ASSERT_EQ(2u, s.segments());
+
+		// ninth reading needs a third segment, the oldest one gets dropped
+		ASSERT_EQ(4u, s.append(reading(9, 9)));
+		ASSERT_EQ(2u, s.segments());
+		ASSERT_EQ(5u, s.pending());
+
+		// acknowledging a full segment removes it
+		s.ack(4);
+		ASSERT_EQ(1u, s.segments());
+		ASSERT_EQ(1u, s.pending());
+
+		std::list<Reading> out;
+		s.replay(out);
+		ASSERT_EQ(1u, out.size());
+		ASSERT_EQ(9000, out.front().time_ms());
+	}
+	remove_tempdir(dir, "ch");
+}